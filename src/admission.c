@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "include/compat.h"
+#include "include/admission.h"
+#include "include/logger.h"
+#include "include/metrics.h"
+#include "include/probes.h"
+
+static struct
+{
+    int max_queue_depth;
+    uint64_t target_wait_us;
+    uint64_t interval_us;
+    char response[192];
+    int response_len;
+    _Atomic uint64_t first_above_us; /* When waits first exceeded the target (0 = below) */
+    _Atomic uint64_t last_above_us;  /* Last dequeue that waited longer than the target */
+    _Atomic bool overloaded;
+    _Atomic time_t last_logged;
+} admission = {0};
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void admission_init(int max_queue_depth, int target_wait_ms, int interval_ms, int retry_after_seconds)
+{
+    admission.max_queue_depth = max_queue_depth;
+    admission.target_wait_us = target_wait_ms > 0 ? (uint64_t)target_wait_ms * 1000u : 0;
+    admission.interval_us = interval_ms > 0 ? (uint64_t)interval_ms * 1000u : 100000u;
+
+    /* Rendered once so rejecting costs a single send from the accept thread */
+    admission.response_len = snprintf(admission.response, sizeof(admission.response),
+                                      "HTTP/1.1 503 Service Unavailable\r\n"
+                                      "Content-Type: text/plain\r\n"
+                                      "Content-Length: 19\r\n"
+                                      "Retry-After: %d\r\n"
+                                      "Connection: close\r\n"
+                                      "\r\n"
+                                      "Service Unavailable",
+                                      retry_after_seconds > 0 ? retry_after_seconds : 1);
+}
+
+void admission_record_wait(uint64_t wait_us, uint64_t now_us)
+{
+    if (admission.target_wait_us == 0)
+        return;
+
+    if (wait_us < admission.target_wait_us)
+    {
+        /* One fast dequeue ends the overload episode (CoDel-style) */
+        if (atomic_load_explicit(&admission.first_above_us, memory_order_relaxed) != 0)
+            atomic_store_explicit(&admission.first_above_us, 0, memory_order_relaxed);
+        if (atomic_load_explicit(&admission.overloaded, memory_order_relaxed))
+            atomic_store_explicit(&admission.overloaded, false, memory_order_relaxed);
+        return;
+    }
+
+    atomic_store_explicit(&admission.last_above_us, now_us, memory_order_relaxed);
+    uint64_t first = atomic_load_explicit(&admission.first_above_us, memory_order_relaxed);
+    if (first == 0)
+    {
+        atomic_compare_exchange_strong(&admission.first_above_us, &first, now_us);
+        return;
+    }
+
+    /* Workers take now_us themselves, so it may be a little behind first */
+    if (now_us >= first + admission.interval_us)
+        atomic_store_explicit(&admission.overloaded, true, memory_order_relaxed);
+}
+
+bool admission_should_shed(int queue_depth)
+{
+    if (admission.max_queue_depth > 0 && queue_depth >= admission.max_queue_depth)
+        return true;
+
+    if (!atomic_load_explicit(&admission.overloaded, memory_order_relaxed))
+        return false;
+
+    /* Shedding keeps new work out of the queue, so no fast dequeue may ever
+       come to end the episode: let it expire once the queue has drained or
+       no slow dequeue has been seen for a whole interval */
+    uint64_t last = atomic_load_explicit(&admission.last_above_us, memory_order_relaxed);
+    if (queue_depth == 0 || now_us() - last >= admission.interval_us)
+    {
+        atomic_store_explicit(&admission.first_above_us, 0, memory_order_relaxed);
+        atomic_store_explicit(&admission.overloaded, false, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void admission_reject(int client_fd)
+{
+#ifdef _WIN32
+    send(client_fd, admission.response, admission.response_len, 0);
+#else
+    /* Never block the accept thread on a slow client */
+    send(client_fd, admission.response, admission.response_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    /* Drain whatever request bytes already arrived so close() sends a FIN
+       rather than a RST that could discard the 503 before the client reads it */
+    shutdown(client_fd, SHUT_WR);
+    char drain[1024];
+    for (int i = 0; i < 4 && recv(client_fd, drain, sizeof(drain), MSG_DONTWAIT) > 0; i++)
+        ;
+#endif
+    PROBE2(conn__close, client_fd, 0);
+    close(client_fd);
+
+    metrics_record_shed();
+
+    /* Log at most once per second so overload does not also flood the log */
+    time_t now = time(NULL);
+    time_t last = atomic_load_explicit(&admission.last_logged, memory_order_relaxed);
+    if (now != last && atomic_compare_exchange_strong(&admission.last_logged, &last, now))
+        log_error_code(20, "Server overloaded, shedding connections with 503");
+}
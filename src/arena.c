@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "include/arena.h"
+
+#define ARENA_ALIGN 16
+
+typedef struct arena_block
+{
+    struct arena_block *prev; /* Older block; the base block has none */
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+} arena_block_t;
+
+struct arena
+{
+    arena_block_t *current;
+    arena_block_t *base;
+};
+
+static pthread_key_t arena_key;
+static pthread_once_t arena_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local arena_t *thread_arena = NULL;
+
+static arena_block_t *block_new(size_t size, arena_block_t *prev)
+{
+    arena_block_t *block = malloc(sizeof(arena_block_t) + size);
+    if (!block)
+        return NULL;
+    block->prev = prev;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+static void arena_destroy(void *ptr)
+{
+    arena_t *arena = ptr;
+    arena_reset(arena);
+    free(arena->base);
+    free(arena);
+}
+
+static void arena_key_create(void)
+{
+    pthread_key_create(&arena_key, arena_destroy);
+}
+
+arena_t *request_arena(void)
+{
+    if (thread_arena)
+        return thread_arena;
+
+    arena_t *arena = malloc(sizeof(arena_t));
+    arena_block_t *base = block_new(ARENA_BLOCK_SIZE, NULL);
+    if (!arena || !base)
+    {
+        free(arena);
+        free(base);
+        return NULL;
+    }
+    arena->current = arena->base = base;
+
+    /* The key's destructor frees the arena when the thread exits */
+    pthread_once(&arena_key_once, arena_key_create);
+    pthread_setspecific(arena_key, arena);
+    thread_arena = arena;
+    return arena;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    if (!arena || size > SIZE_MAX - ARENA_ALIGN)
+        return NULL;
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    arena_block_t *block = arena->current;
+    if (block->size - block->used < size)
+    {
+        /* Large requests get a block of their own; small ones start a
+           fresh block-sized one */
+        block = block_new(size > ARENA_BLOCK_SIZE / 2 ? size : ARENA_BLOCK_SIZE, block);
+        if (!block)
+            return NULL;
+        arena->current = block;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+arena_mark_t arena_mark(const arena_t *arena)
+{
+    arena_mark_t mark = {NULL, 0};
+    if (arena)
+    {
+        mark.block = arena->current;
+        mark.used = arena->current->used;
+    }
+    return mark;
+}
+
+void arena_rewind(arena_t *arena, arena_mark_t mark)
+{
+    if (!arena || !mark.block)
+        return;
+
+    while (arena->current != mark.block && arena->current != arena->base)
+    {
+        arena_block_t *prev = arena->current->prev;
+        free(arena->current);
+        arena->current = prev;
+    }
+    arena->current->used = mark.used;
+}
+
+void arena_reset(arena_t *arena)
+{
+    if (!arena)
+        return;
+    arena_mark_t start = {arena->base, 0};
+    arena_rewind(arena, start);
+}
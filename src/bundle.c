@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <time.h>
+
+#include "include/compat.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "include/bundle.h"
+#include "include/logger.h"
+#include "include/cache_policy.h"
+
+#define BUNDLE_CHECK_INTERVAL 1 /* Seconds between checks for a swapped file */
+#define BUNDLE_TICK_MS 100      /* Watcher sleep, bounding how long bundle_close() waits */
+
+struct bundle
+{
+    const char *base;
+    size_t size;
+    const bundle_header_t *header;
+    const bundle_entry_t *entries;
+    const char **cache_control; /* Per-entry policy, parallel to entries */
+    dev_t dev;
+    ino_t ino;
+    atomic_int refs;
+};
+
+/* The current bundle is published through an atomic pointer, so requests
+   take it without a lock or a syscall. Only the watcher thread (and
+   bundle_close() after it stops) replaces it. */
+static struct
+{
+    char path[PATH_MAX];
+    bundle_t *_Atomic current;
+    _Atomic int readers; /* bundle_acquire() calls between loading current and taking a ref */
+    _Atomic bool stop;
+    pthread_t watcher;
+    bool watching;
+} bundles;
+
+static void bundle_unmap(bundle_t *bundle)
+{
+#ifndef _WIN32
+    munmap((void *)bundle->base, bundle->size);
+#endif
+    free(bundle->cache_control);
+    free(bundle);
+}
+
+/* Map and validate a bundle file. Returns NULL (after logging) if it is
+   missing or malformed. */
+static bundle_t *bundle_map(const char *path)
+{
+#ifdef _WIN32
+    (void)path;
+    log_error_code(23, "Content bundles are not supported on Windows");
+    return NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        log_error_code(23, "Failed to open content bundle %s", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(bundle_header_t))
+    {
+        close(fd);
+        log_error_code(23, "Content bundle %s is truncated", path);
+        return NULL;
+    }
+
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); /* The mapping keeps the file alive, even after a swap */
+    if (base == MAP_FAILED)
+    {
+        log_error_code(23, "Failed to map content bundle %s", path);
+        return NULL;
+    }
+
+    const bundle_header_t *h = base;
+    size_t size = (size_t)st.st_size;
+    uint64_t index_size = (uint64_t)h->entry_count * sizeof(bundle_entry_t);
+    if (memcmp(h->magic, BUNDLE_MAGIC, sizeof(h->magic)) != 0 || h->version != BUNDLE_VERSION ||
+        h->total_size != size || h->index_offset > size || index_size > size - h->index_offset ||
+        h->strings_offset > size || h->strings_size > size - h->strings_offset)
+    {
+        munmap(base, size);
+        log_error_code(23, "Content bundle %s is invalid", path);
+        return NULL;
+    }
+
+    /* Bounds-check every entry once so lookups can trust the index */
+    const bundle_entry_t *entries = (const bundle_entry_t *)((const char *)base + h->index_offset);
+    for (uint32_t i = 0; i < h->entry_count; i++)
+    {
+        const bundle_entry_t *e = &entries[i];
+        if (e->path >= h->strings_size || e->mime >= h->strings_size || e->etag >= h->strings_size ||
+            e->data_offset > size || e->data_size > size - e->data_offset ||
+            e->gzip_offset > size || e->gzip_size > size - e->gzip_offset)
+        {
+            munmap(base, size);
+            log_error_code(23, "Content bundle %s has a corrupt index", path);
+            return NULL;
+        }
+    }
+    const char *strings = (const char *)base + h->strings_offset;
+    if (h->strings_size == 0 || strings[h->strings_size - 1] != '\0')
+    {
+        munmap(base, size);
+        log_error_code(23, "Content bundle %s has a corrupt string table", path);
+        return NULL;
+    }
+
+    bundle_t *bundle = calloc(1, sizeof(bundle_t));
+    const char **cache_control = calloc(h->entry_count ? h->entry_count : 1, sizeof(char *));
+    if (!bundle || !cache_control)
+    {
+        free(bundle);
+        free(cache_control);
+        munmap(base, size);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < h->entry_count; i++)
+        cache_control[i] = cache_policy_resolve(strings + entries[i].path);
+    bundle->cache_control = cache_control;
+    bundle->base = base;
+    bundle->size = size;
+    bundle->header = h;
+    bundle->entries = entries;
+    bundle->dev = st.st_dev;
+    bundle->ino = st.st_ino;
+    atomic_init(&bundle->refs, 1); /* The reference held as "current" */
+
+    char msg[PATH_MAX + 64];
+    snprintf(msg, sizeof(msg), "Serving %u files from content bundle %s", h->entry_count, path);
+    log_info(msg);
+    return bundle;
+#endif
+}
+
+/* Publish a new current bundle and drop the reference held on the old
+   one. A reader may have loaded the old pointer without having taken its
+   reference yet, so wait for those few instructions to drain first. */
+static void bundle_publish(bundle_t *fresh)
+{
+    bundle_t *old = atomic_exchange(&bundles.current, fresh);
+    while (atomic_load(&bundles.readers) > 0)
+    {
+        struct timespec pause = {0, 100000L};
+        nanosleep(&pause, NULL);
+    }
+    bundle_release(old);
+}
+
+/* Deploys rename a new bundle over the old path; notice the new inode
+   and switch to it. Requests still holding the old mapping finish on it. */
+static void bundle_check_swap(void)
+{
+    bundle_t *current = atomic_load(&bundles.current);
+    struct stat st;
+    if (stat(bundles.path, &st) != 0 || (current && st.st_dev == current->dev && st.st_ino == current->ino))
+        return;
+
+    bundle_t *fresh = bundle_map(bundles.path);
+    if (fresh)
+        bundle_publish(fresh); /* Otherwise keep serving the old one */
+}
+
+/* Watcher thread: checks for a swapped file off the request path */
+static void *bundle_watcher(void *arg)
+{
+    (void)arg;
+    int ticks = 0;
+    while (!atomic_load(&bundles.stop))
+    {
+        struct timespec tick = {0, BUNDLE_TICK_MS * 1000000L};
+        nanosleep(&tick, NULL);
+        if (++ticks < BUNDLE_CHECK_INTERVAL * 1000 / BUNDLE_TICK_MS)
+            continue;
+        ticks = 0;
+        bundle_check_swap();
+    }
+    return NULL;
+}
+
+int bundle_open(const char *path)
+{
+    bundle_t *bundle = bundle_map(path);
+    if (!bundle)
+        return -1;
+
+    strncpy(bundles.path, path, sizeof(bundles.path) - 1);
+    atomic_store(&bundles.current, bundle);
+    atomic_store(&bundles.stop, false);
+    bundles.watching = pthread_create(&bundles.watcher, NULL, bundle_watcher, NULL) == 0;
+    if (!bundles.watching)
+        log_error_code(19, "Failed to start the content bundle watcher; swaps of %s will not be noticed", path);
+    return 0;
+}
+
+bool bundle_enabled(void)
+{
+    return bundles.path[0] != '\0';
+}
+
+bundle_t *bundle_acquire(void)
+{
+    atomic_fetch_add(&bundles.readers, 1);
+    bundle_t *bundle = atomic_load(&bundles.current);
+    if (bundle)
+        atomic_fetch_add(&bundle->refs, 1);
+    atomic_fetch_sub(&bundles.readers, 1);
+    return bundle;
+}
+
+void bundle_release(bundle_t *bundle)
+{
+    if (bundle && atomic_fetch_sub(&bundle->refs, 1) == 1)
+        bundle_unmap(bundle);
+}
+
+const char *bundle_cache_control(const bundle_t *bundle, const bundle_entry_t *entry)
+{
+    return bundle->cache_control[entry - bundle->entries];
+}
+
+const char *bundle_string(const bundle_t *bundle, uint32_t offset)
+{
+    return bundle->base + bundle->header->strings_offset + offset;
+}
+
+const char *bundle_payload(const bundle_t *bundle, uint64_t offset)
+{
+    return bundle->base + offset;
+}
+
+const bundle_entry_t *bundle_find(const bundle_t *bundle, const char *path)
+{
+    uint32_t lo = 0, hi = bundle->header->entry_count;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(path, bundle_string(bundle, bundle->entries[mid].path));
+        if (cmp == 0)
+            return &bundle->entries[mid];
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return NULL;
+}
+
+void bundle_close(void)
+{
+    if (bundles.watching)
+    {
+        atomic_store(&bundles.stop, true);
+        pthread_join(bundles.watcher, NULL);
+        bundles.watching = false;
+    }
+    bundle_publish(NULL);
+}
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include "include/compat.h"
+#include "include/cache_policy.h"
+#include "include/path_match.h"
+#include "include/settings.h"
+#include "include/logger.h"
+
+#define HASH_MIN_LENGTH 8
+
+static struct
+{
+    char root[PATH_MAX]; /* Resolved content directory */
+    size_t root_len;
+    bool hashed_names;   /* Names carrying a content hash are immutable */
+    char **manifest;     /* Sorted content-relative paths that are immutable */
+    int manifest_count;
+    char **patterns;     /* Per-glob policies, first match wins */
+    char **values;
+    int policy_count;
+} policy = {0};
+
+static int compare_strings(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Load the manifest: one content-relative path per line */
+static void load_manifest(const char *manifest_path)
+{
+    FILE *f = fopen(manifest_path, "r");
+    if (!f)
+    {
+        log_info("Immutable cache manifest could not be opened, skipping it");
+        return;
+    }
+
+    int capacity = 0;
+    char line[PATH_MAX];
+    while (fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        const char *rel = line;
+        while (*rel == '/')
+            rel++;
+        if (*rel == '\0' || *rel == '#')
+            continue;
+
+        if (policy.manifest_count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            char **grown = realloc(policy.manifest, capacity * sizeof(char *));
+            if (!grown)
+                break;
+            policy.manifest = grown;
+        }
+        char *copy = strdup(rel);
+        if (copy)
+            policy.manifest[policy.manifest_count++] = copy;
+    }
+    fclose(f);
+
+    qsort(policy.manifest, policy.manifest_count, sizeof(char *), compare_strings);
+}
+
+/* A fingerprint is a dot/dash separated token of the file name (before the
+   extension) of 8+ hex digits with at least one digit and one letter
+   ("app.3f2a9c1b.js"). Mixed-case tokens are not taken as hashes: ordinary
+   names ("iPhone15Pro.png") look the same, and a year of immutable caching
+   is too costly a guess. All-digit tokens are dates and counters
+   ("report-20240101.pdf"). Other fingerprint styles belong in the manifest
+   or a "cache-policies" glob. */
+static bool is_hash_token(const char *token, size_t len)
+{
+    if (len < HASH_MIN_LENGTH)
+        return false;
+
+    bool hex_letter = false, digit = false;
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)token[i];
+        if (!isxdigit(c))
+            return false;
+        hex_letter = hex_letter || isalpha(c);
+        digit = digit || isdigit(c);
+    }
+    return hex_letter && digit;
+}
+
+static bool has_content_hash(const char *rel_path)
+{
+    const char *name = strrchr(rel_path, '/');
+    name = name ? name + 1 : rel_path;
+
+    const char *ext = strrchr(name, '.');
+    const char *end = ext && ext != name ? ext : name + strlen(name);
+
+    const char *token = name;
+    for (const char *p = name; p <= end; p++)
+    {
+        if (p == end || *p == '.' || *p == '-')
+        {
+            if (token != name && is_hash_token(token, (size_t)(p - token)))
+                return true;
+            token = p + 1;
+        }
+    }
+    return false;
+}
+
+void cache_policy_init(const char *content_directory)
+{
+    if (!realpath(content_directory, policy.root))
+        strncpy(policy.root, content_directory, sizeof(policy.root) - 1);
+    policy.root_len = strlen(policy.root);
+
+    policy.hashed_names = get_cache_immutable_hashed();
+
+    const char *manifest = get_cache_immutable_manifest();
+    if (manifest)
+        load_manifest(manifest);
+
+    policy.policy_count = get_cache_policies(&policy.patterns, &policy.values);
+}
+
+const char *cache_policy_resolve(const char *path)
+{
+    /* Work on the content-relative path */
+    const char *rel = path;
+    if (policy.root_len > 0 && strncmp(path, policy.root, policy.root_len) == 0 && path[policy.root_len] == '/')
+        rel = path + policy.root_len;
+    while (*rel == '/')
+        rel++;
+
+    if (policy.manifest_count > 0 &&
+        bsearch(&rel, policy.manifest, policy.manifest_count, sizeof(char *), compare_strings))
+        return CACHE_CONTROL_IMMUTABLE;
+
+    if (policy.hashed_names && has_content_hash(rel))
+        return CACHE_CONTROL_IMMUTABLE;
+
+    for (int i = 0; i < policy.policy_count; i++)
+    {
+        if (path_glob_match(policy.patterns[i], rel))
+            return policy.values[i];
+    }
+    return NULL;
+}
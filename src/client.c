@@ -1,3 +1,4 @@
+#define _GNU_SOURCE /* accept4, strptime */
 #include <stdio.h>    // printf, perror
 #include <stdlib.h>   // exit, EXIT_FAILURE
 #include <string.h>   // strlen, strcpy, memset
@@ -6,9 +7,16 @@
 #include <inttypes.h> // PRIdMAX
 #include <ctype.h>    // isxdigit
 #include <time.h>     // time, strptime, mktime
+#include <stdatomic.h> // atomic_int
 
 #include "include/compat.h"
 #include <limits.h> // PATH_MAX
+#ifndef _WIN32
+#include <poll.h> // poll
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h> // sendfile
+#endif
 
 #include "include/client.h"
 #include "include/logger.h"
@@ -19,9 +27,53 @@
 #include "include/shutdown.h"
 #include "include/access_log.h"
 #include "include/threadpool.h"
+#include "include/admission.h"
+#include "include/socket.h"
+#include "include/io_buffer.h"
+#include "include/probes.h"
+#include "include/topk.h"
 
-static cache_entry_t cache[CACHE_MAX_ENTRIES];
+/* Connections accepted per listener wakeup before going back to poll() */
+#ifdef _WIN32
+#define ACCEPT_BATCH 1
+#else
+#define ACCEPT_BATCH 64
+#endif
+
+static cache_entry_t *cache[CACHE_MAX_ENTRIES];
 static int cache_count = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static _Thread_local response_info_t response;
+
+/* Set by the request currently running on this thread when its
+   connection was handed off, so the keep-alive loop lets go of the fd */
+static _Thread_local bool connection_detached = false;
+
+void response_info_reset(void)
+{
+    response.status = 0;
+    response.bytes = 0;
+    response.path[0] = '\0';
+}
+
+/* Kept decoded and without its query string, so cache-busting parameters
+   do not each take a statistics slot of their own */
+void response_info_set_path(const char *path)
+{
+    snprintf(response.path, sizeof(response.path), "%s", path);
+    if (url_decode(response.path) != 0)
+        snprintf(response.path, sizeof(response.path), "%s", path); /* Undecodable: keep it raw */
+
+    char *query = strchr(response.path, '?');
+    if (query)
+        *query = '\0';
+}
+
+const response_info_t *response_info(void)
+{
+    return &response;
+}
 
 /* Helper function to handle HTTP request with timing */
 static void handle_http_request_with_timing(int client_fd, const char *client_ip, const char *content_directory, bool show_ext)
@@ -29,16 +81,26 @@ static void handle_http_request_with_timing(int client_fd, const char *client_ip
     struct timeval start, end;
     gettimeofday(&start, NULL);
 
+    response_info_reset();
     handle_http_request(client_fd, client_ip, content_directory, show_ext);
 
+    /* Nothing was sent if the connection was handed to the compression pool */
+    if (response.status != 0)
+        PROBE3(response__body, client_fd, response.status, (long)response.bytes);
+
     gettimeofday(&end, NULL);
     long seconds = end.tv_sec - start.tv_sec;
     long microseconds = end.tv_usec - start.tv_usec;
     double elapsed = seconds + microseconds * 1e-6;
     double elapsed_ms = elapsed * 1000.0;
 
-    /* Record metrics (estimate 1KB per request as baseline) */
-    metrics_record_request(1024, elapsed_ms);
+    /* Record metrics with the bytes this thread wrote for the response */
+    metrics_record_request((size_t)response.bytes, elapsed_ms);
+
+    /* A handed-off response is a 200 whose body the compression pool sends */
+    int status = connection_detached ? 200 : response.status;
+    if (status != 0 && response.path[0])
+        topk_record(response.path, client_ip, status, response.bytes, elapsed_ms);
 
     char timing_msg[128];
     snprintf(timing_msg, sizeof(timing_msg), "Request handled in %.3f ms", elapsed_ms);
@@ -48,74 +110,151 @@ static void handle_http_request_with_timing(int client_fd, const char *client_ip
 /* Initialize cache */
 void cache_init(void)
 {
+    pthread_mutex_lock(&cache_lock);
     memset(cache, 0, sizeof(cache));
+    cache_count = 0;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+static void cache_entry_free(cache_entry_t *entry)
+{
+    free(entry->data);
+    free(entry->gzip_data);
+    free(entry);
 }
 
-/* Get cached file data */
-cache_entry_t *cache_get(const char *path)
+/* Drop a reference taken by cache_get/cache_put; the last one frees the entry */
+void cache_release(cache_entry_t *entry)
 {
+    if (entry && atomic_fetch_sub(&entry->refs, 1) == 1)
+        cache_entry_free(entry);
+}
+
+/* Remove slot i from the table (caller holds cache_lock) */
+static void cache_remove_locked(int i)
+{
+    cache_release(cache[i]);
+    memmove(&cache[i], &cache[i + 1], (cache_count - i - 1) * sizeof(cache_entry_t *));
+    cache_count--;
+}
+
+/* Get cached file data. Returns a referenced entry that the caller must
+   hand back with cache_release(), so eviction by another worker can never
+   free data that is still being sent. The caller passes the file's current
+   mtime (from the path cache) so a stale entry is dropped without a stat. */
+cache_entry_t *cache_get(const char *path, time_t mtime)
+{
+    pthread_mutex_lock(&cache_lock);
     for (int i = 0; i < cache_count; i++)
     {
-        if (strcmp(cache[i].path, path) == 0)
+        if (strcmp(cache[i]->path, path) == 0)
         {
-            struct stat st;
-            if (stat(path, &st) == 0 && st.st_mtime == cache[i].mtime)
-            {
-                cache[i].cached_at = time(NULL); // Update access time
-                return &cache[i];
-            }
-            else
+            if (mtime == cache[i]->mtime)
             {
-                // File changed, remove from cache
-                free(cache[i].data);
-                memmove(&cache[i], &cache[i + 1], (cache_count - i - 1) * sizeof(cache_entry_t));
-                cache_count--;
-                i--; // Recheck this position
+                cache_entry_t *entry = cache[i];
+                entry->cached_at = time(NULL); // Update access time
+                atomic_fetch_add(&entry->refs, 1);
+                pthread_mutex_unlock(&cache_lock);
+                return entry;
             }
+
+            // File changed, remove from cache
+            cache_remove_locked(i);
+            break;
         }
     }
+    pthread_mutex_unlock(&cache_lock);
     return NULL;
 }
 
-/* Add file to cache (LRU eviction) */
-void cache_put(const char *path, const char *data, size_t size, const char *mime_type, time_t mtime)
+/* Add file (and its gzip variant, if any) to cache (LRU eviction).
+   Returns a referenced entry holding the copied data (the one already
+   cached, if another worker got there first) for the caller to serve and
+   cache_release(), or NULL if it could not be stored. */
+cache_entry_t *cache_put(const char *path, const char *data, size_t size, const char *gzip_data,
+                         size_t gzip_size, const char *mime_type, time_t mtime)
 {
-    // Don't cache if too big or already cached
-    if (size > CACHE_MAX_FILE_SIZE || cache_get(path) != NULL)
-        return;
+    // Don't cache if too big
+    if (size > CACHE_MAX_FILE_SIZE)
+        return NULL;
+
+    cache_entry_t *entry = calloc(1, sizeof(cache_entry_t));
+    if (!entry)
+        return NULL;
+
+    strncpy(entry->path, path, sizeof(entry->path) - 1);
+    entry->data = malloc(size);
+    entry->gzip_data = gzip_data ? malloc(gzip_size) : NULL;
+    if (!entry->data || (gzip_data && !entry->gzip_data))
+    {
+        cache_entry_free(entry);
+        return NULL;
+    }
+    memcpy(entry->data, data, size);
+    entry->size = size;
+    if (gzip_data)
+    {
+        memcpy(entry->gzip_data, gzip_data, gzip_size);
+        entry->gzip_size = gzip_size;
+    }
+    entry->mime_type = mime_type;
+    entry->mtime = mtime;
+    entry->cached_at = time(NULL);
+    atomic_init(&entry->refs, 2); /* The table's reference and the caller's */
 
-    // Find LRU entry or add new one
-    int replace_idx = -1;
-    time_t oldest = time(NULL);
+    pthread_mutex_lock(&cache_lock);
 
+    // Already cached (another worker got here first), or cached stale
+    int replace_idx = -1;
     for (int i = 0; i < cache_count; i++)
     {
-        if (cache[i].cached_at < oldest)
+        if (strcmp(cache[i]->path, path) == 0)
         {
-            oldest = cache[i].cached_at;
+            if (cache[i]->mtime == mtime)
+            {
+                cache_entry_t *existing = cache[i];
+                atomic_fetch_add(&existing->refs, 1);
+                pthread_mutex_unlock(&cache_lock);
+                cache_entry_free(entry);
+                return existing;
+            }
             replace_idx = i;
+            break;
         }
     }
 
-    if (cache_count < CACHE_MAX_ENTRIES)
+    // Find LRU entry or add new one
+    if (replace_idx < 0)
     {
-        replace_idx = cache_count++;
+        time_t oldest = time(NULL);
+        for (int i = 0; i < cache_count; i++)
+        {
+            if (cache[i]->cached_at < oldest)
+            {
+                oldest = cache[i]->cached_at;
+                replace_idx = i;
+            }
+        }
+
+        if (cache_count < CACHE_MAX_ENTRIES)
+        {
+            replace_idx = cache_count++;
+            cache[replace_idx] = NULL;
+        }
     }
 
     if (replace_idx >= 0)
     {
-        free(cache[replace_idx].data);
-        strncpy(cache[replace_idx].path, path, sizeof(cache[replace_idx].path) - 1);
-        cache[replace_idx].data = malloc(size);
-        if (cache[replace_idx].data)
-        {
-            memcpy(cache[replace_idx].data, data, size);
-            cache[replace_idx].size = size;
-            cache[replace_idx].mime_type = mime_type;
-            cache[replace_idx].mtime = mtime;
-            cache[replace_idx].cached_at = time(NULL);
-        }
+        cache_release(cache[replace_idx]);
+        cache[replace_idx] = entry;
     }
+    else
+    {
+        atomic_store(&entry->refs, 1); /* No slot free this second: caller's only */
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    return entry;
 }
 
 int url_decode(char *s)
@@ -152,7 +291,75 @@ static time_t parse_http_date(const char *date_str)
     char *result = strptime(date_str, "%a, %d %b %Y %H:%M:%S GMT", &tm);
     if (!result)
         return -1;
-    return mktime(&tm);
+    /* The date is GMT, not local time */
+#ifdef _WIN32
+    return _mkgmtime(&tm);
+#else
+    return timegm(&tm);
+#endif
+}
+
+/* Format a time as an HTTP date (for Last-Modified) */
+void format_http_date(time_t t, char *out, size_t len)
+{
+    struct tm tm;
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    strftime(out, len, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+/* Derive the entity tag of the gzip representation: "tag" -> "tag-gz" */
+void make_gzip_etag(const char *etag, char *out, size_t len)
+{
+    size_t etag_len = strlen(etag);
+    if (etag_len < 2 || etag_len + 3 >= len)
+    {
+        out[0] = '\0';
+        return;
+    }
+    snprintf(out, len, "%.*s-gz\"", (int)(etag_len - 1), etag);
+}
+
+/* Evaluate If-None-Match against a resource's entity tags, identity and
+   gzip; a tag for either matches. Returns -1 if the header is absent, 0 if
+   nothing matched, 1 for a match on the identity tag (or "*"), 2 for a
+   match on the gzip tag. */
+int check_if_none_match(const char *request_buf, const char *etag, const char *gzip_etag)
+{
+    const char *header = strcasestr(request_buf, "\nIf-None-Match:");
+    if (!header)
+        return -1;
+    header += strlen("\nIf-None-Match:");
+
+    const char *end = strpbrk(header, "\r\n");
+    if (!end)
+        end = header + strlen(header);
+
+    size_t etag_len = strlen(etag), gzip_etag_len = strlen(gzip_etag);
+    const char *p = header;
+    while (p < end)
+    {
+        while (p < end && (*p == ' ' || *p == ','))
+            p++;
+        /* Weak comparison: a W/ prefix does not prevent a match */
+        if (end - p >= 2 && p[0] == 'W' && p[1] == '/')
+            p += 2;
+        const char *token = p;
+        while (p < end && *p != ',' && *p != ' ')
+            p++;
+        size_t token_len = (size_t)(p - token);
+
+        if (token_len == 1 && token[0] == '*')
+            return 1;
+        if (token_len == etag_len && strncmp(token, etag, etag_len) == 0)
+            return 1;
+        if (gzip_etag_len > 0 && token_len == gzip_etag_len && strncmp(token, gzip_etag, gzip_etag_len) == 0)
+            return 2;
+    }
+    return 0;
 }
 
 /* Extract If-Modified-Since header value from request buffer */
@@ -184,47 +391,169 @@ int get_if_modified_since(const char *request_buf, time_t *out_time)
     return (*out_time > 0) ? 1 : 0;
 }
 
-/* Parse Range header: "bytes=0-100" or "bytes=100-" */
-int parse_range_header(const char *request_buf, off_t file_size, off_t *out_start, off_t *out_end)
+/* Check whether the Accept-Encoding header allows gzip (and not with q=0).
+   An explicit gzip entry takes precedence over "*" (RFC 9110 12.5.3). */
+int get_accepts_gzip(const char *request_buf)
+{
+    const char *header = strcasestr(request_buf, "\nAccept-Encoding:");
+    if (!header)
+        return 0;
+    header += strlen("\nAccept-Encoding:");
+
+    const char *end = strpbrk(header, "\r\n");
+    if (!end)
+        end = header + strlen(header);
+
+    /* Walk the comma-separated codings looking for gzip and * */
+    int wildcard = -1;
+    const char *p = header;
+    while (p < end)
+    {
+        while (p < end && (*p == ' ' || *p == ','))
+            p++;
+        const char *token = p;
+        while (p < end && *p != ',' && *p != ';' && *p != ' ')
+            p++;
+        size_t token_len = (size_t)(p - token);
+
+        bool is_gzip = token_len == 4 && strncasecmp(token, "gzip", 4) == 0;
+        bool is_wildcard = token_len == 1 && token[0] == '*';
+
+        /* Parameters: only q=0 (or 0.0...) disables the coding */
+        bool rejected = false;
+        while (p < end && *p != ',')
+        {
+            if ((*p == 'q' || *p == 'Q') && p + 1 < end && p[1] == '=')
+            {
+                double q = strtod(p + 2, NULL);
+                rejected = q <= 0.0;
+            }
+            p++;
+        }
+
+        if (is_gzip)
+            return rejected ? 0 : 1;
+        if (is_wildcard)
+            wildcard = rejected ? 0 : 1;
+    }
+    return wildcard > 0;
+}
+
+/* Parse a Range header into byte ranges, clamped to the file: "a-b",
+   open-ended "a-", suffix "-n", comma-separated. Returns the number of
+   ranges, 0 if there is no usable Range header (serve the whole file),
+   or -1 if it is well-formed but no range is satisfiable (416). More than
+   max_ranges ranges are treated as no Range header at all. */
+int parse_range_header(const char *request_buf, off_t file_size, byte_range_t *ranges, int max_ranges)
 {
-    const char *range = strstr(request_buf, "Range:");
+    const char *range = strcasestr(request_buf, "\nRange:");
     if (!range)
         return 0;
 
-    range += strlen("Range:");
+    range += strlen("\nRange:");
     while (*range == ' ')
         range++;
 
-    if (strncmp(range, "bytes=", 6) != 0)
+    if (strncasecmp(range, "bytes=", 6) != 0)
         return 0;
-
     range += 6;
 
-    char *end_ptr;
-    off_t start = strtoll(range, &end_ptr, 10);
-
-    if (*end_ptr != '-')
-        return 0;
-
-    off_t end;
-    if (*(end_ptr + 1) == '\r' || *(end_ptr + 1) == '\n')
+    int count = 0;
+    bool any_valid = false;
+    const char *p = range;
+    while (*p && *p != '\r' && *p != '\n')
     {
-        /* "bytes=100-" means from 100 to end of file */
-        end = file_size - 1;
-    }
-    else
-    {
-        end = strtoll(end_ptr + 1, NULL, 10);
+        while (*p == ' ' || *p == ',')
+            p++;
+        if (!*p || *p == '\r' || *p == '\n')
+            break;
+
+        char *end_ptr;
+        off_t start, end;
+        if (*p == '-')
+        {
+            /* "-500": the last 500 bytes */
+            off_t suffix = strtoll(p + 1, &end_ptr, 10);
+            if (end_ptr == p + 1 || suffix < 0)
+                return 0;
+            start = suffix >= file_size ? 0 : file_size - suffix;
+            end = file_size - 1;
+            if (suffix == 0)
+                start = file_size; /* Unsatisfiable */
+        }
+        else
+        {
+            start = strtoll(p, &end_ptr, 10);
+            if (end_ptr == p || *end_ptr != '-' || start < 0)
+                return 0;
+            const char *end_str = end_ptr + 1;
+            if (*end_str >= '0' && *end_str <= '9')
+            {
+                end = strtoll(end_str, &end_ptr, 10);
+                if (end < start)
+                    return 0; /* Syntactically invalid: ignore the header */
+            }
+            else
+            {
+                end = file_size - 1; /* "100-": to the end of the file */
+                end_ptr = (char *)end_str;
+            }
+            if (end >= file_size)
+                end = file_size - 1;
+        }
+        p = end_ptr;
+        while (*p == ' ')
+            p++;
+        if (*p && *p != ',' && *p != '\r' && *p != '\n')
+            return 0;
+
+        any_valid = true;
+        if (start >= file_size || start > end)
+            continue; /* Unsatisfiable range; others may still apply */
+
+        if (count == max_ranges)
+            return 0;
+        ranges[count].start = start;
+        ranges[count].end = end;
+        count++;
     }
 
-    /* Validate range */
-    if (start < 0 || start >= file_size || end < start || end >= file_size)
-        return 0;
+    if (count == 0)
+        return any_valid ? -1 : 0;
+    return count;
+}
 
-    *out_start = start;
-    *out_end = end;
-    return 1;
+/* Check If-Range: a range request only applies if the client's validator
+   still matches. An entity tag must match the current (identity) tag
+   exactly; a date must equal Last-Modified. Returns true if the header is
+   absent or matches. */
+bool if_range_matches(const char *request_buf, const char *etag, time_t mtime)
+{
+    const char *header = strcasestr(request_buf, "\nIf-Range:");
+    if (!header)
+        return true;
+    header += strlen("\nIf-Range:");
+    while (*header == ' ')
+        header++;
+
+    const char *end = strpbrk(header, "\r\n");
+    size_t len = end ? (size_t)(end - header) : strlen(header);
+    while (len > 0 && header[len - 1] == ' ')
+        len--;
+
+    if (len > 0 && header[0] == '"')
+        return etag && strlen(etag) == len && strncmp(header, etag, len) == 0;
+    if (len >= 2 && header[0] == 'W' && header[1] == '/')
+        return false; /* Weak tags never match for If-Range */
+
+    char date_str[100];
+    if (len >= sizeof(date_str))
+        return false;
+    memcpy(date_str, header, len);
+    date_str[len] = '\0';
+    return parse_http_date(date_str) == mtime;
 }
+
 void send_404(int client_fd)
 {
     const char *not_found =
@@ -233,7 +562,7 @@ void send_404(int client_fd)
         "Content-Length: 13\r\n"
         "\r\n"
         "404 Not Found";
-    write(client_fd, not_found, strlen(not_found));
+    send_response_header(client_fd, 404, not_found, strlen(not_found));
 }
 
 void send_403(int client_fd)
@@ -244,32 +573,89 @@ void send_403(int client_fd)
         "Content-Length: 9\r\n"
         "\r\n"
         "Forbidden";
-    write(client_fd, forbidden, strlen(forbidden));
+    send_response_header(client_fd, 403, forbidden, strlen(forbidden));
 }
 
-void send_304(int client_fd)
+/* 304 with the validators and caching policy of the current
+   representation (etag and cache_control may be NULL) */
+void send_304(int client_fd, const char *etag, time_t last_modified, const char *cache_control)
 {
-    const char *not_modified =
-        "HTTP/1.1 304 Not Modified\r\n"
-        "Content-Length: 0\r\n"
-        "\r\n";
-    write(client_fd, not_modified, strlen(not_modified));
+    char date[64] = "";
+    if (last_modified > 0)
+        format_http_date(last_modified, date, sizeof(date));
+
+    char header[384];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 304 Not Modified\r\n"
+                              "%s%s%s"
+                              "%s%s%s"
+                              "%s%s%s"
+                              "Content-Length: 0\r\n"
+                              "\r\n",
+                              etag ? "ETag: " : "", etag ? etag : "", etag ? "\r\n" : "",
+                              date[0] ? "Last-Modified: " : "", date, date[0] ? "\r\n" : "",
+                              cache_control ? "Cache-Control: " : "", cache_control ? cache_control : "",
+                              cache_control ? "\r\n" : "");
+    if (header_len > 0 && header_len < (int)sizeof(header))
+        send_response_header(client_fd, 304, header, header_len);
 }
 
-void send_206_header(int client_fd, const char *mime, off_t range_start, off_t range_end, off_t total_size)
+/* 206 headers for a single range (boundary NULL) or for a
+   multipart/byteranges body; h->length is the body length */
+void send_206_header(int client_fd, const response_headers_t *h, const byte_range_t *range,
+                     off_t total_size, const char *boundary)
 {
-    char header[512];
+    char content_type[160];
+    char content_range[96] = "";
+    if (boundary)
+    {
+        snprintf(content_type, sizeof(content_type), "multipart/byteranges; boundary=%s", boundary);
+    }
+    else
+    {
+        snprintf(content_type, sizeof(content_type), "%s", h->mime);
+        snprintf(content_range, sizeof(content_range), "Content-Range: bytes %jd-%jd/%jd\r\n",
+                 (intmax_t)range->start, (intmax_t)range->end, (intmax_t)total_size);
+    }
+
+    char date[64] = "";
+    if (h->last_modified > 0)
+        format_http_date(h->last_modified, date, sizeof(date));
+
+    char header[768];
     int header_len = snprintf(header, sizeof(header),
                               "HTTP/1.1 206 Partial Content\r\n"
                               "Content-Type: %s\r\n"
-                              "Content-Range: bytes %jd-%jd/%jd\r\n"
+                              "%s"
                               "Content-Length: %jd\r\n"
                               "Accept-Ranges: bytes\r\n"
+                              "%s%s%s"
+                              "%s%s%s"
+                              "%s%s%s"
+                              "%s"
+                              "\r\n",
+                              content_type, content_range, (intmax_t)h->length,
+                              h->etag ? "ETag: " : "", h->etag ? h->etag : "", h->etag ? "\r\n" : "",
+                              date[0] ? "Last-Modified: " : "", date, date[0] ? "\r\n" : "",
+                              h->cache_control ? "Cache-Control: " : "",
+                              h->cache_control ? h->cache_control : "",
+                              h->cache_control ? "\r\n" : "",
+                              h->keep_alive ? "Connection: keep-alive\r\n" : "");
+    if (header_len > 0 && header_len < (int)sizeof(header))
+        send_response_header(client_fd, 206, header, header_len);
+}
+
+void send_416(int client_fd, off_t total_size)
+{
+    char header[160];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                              "Content-Range: bytes */%jd\r\n"
+                              "Content-Length: 0\r\n"
                               "\r\n",
-                              mime, (intmax_t)range_start, (intmax_t)range_end,
-                              (intmax_t)total_size, (intmax_t)(range_end - range_start + 1));
+                              (intmax_t)total_size);
     if (header_len > 0)
-        write(client_fd, header, header_len);
+        send_response_header(client_fd, 416, header, header_len);
 }
 
 void send_301_location(int client_fd, const char *location)
@@ -282,7 +668,7 @@ void send_301_location(int client_fd, const char *location)
                      "\r\n",
                      location);
     if (n > 0)
-        write(client_fd, hdr, n);
+        send_response_header(client_fd, 301, hdr, n);
 }
 
 /* small helper to write a 200 header */
@@ -296,7 +682,7 @@ void send_200_header(int client_fd, const char *mime, off_t len)
                               "\r\n",
                               mime, (intmax_t)len);
     if (header_len > 0)
-        write(client_fd, header, header_len);
+        send_response_header(client_fd, 200, header, header_len);
 }
 
 /* small helper to write a 200 header with keep-alive */
@@ -311,60 +697,60 @@ void send_200_header_keepalive(int client_fd, const char *mime, off_t len)
                               "\r\n",
                               mime, (intmax_t)len);
     if (header_len > 0)
-        write(client_fd, header, header_len);
+        send_response_header(client_fd, 200, header, header_len);
 }
 
-const char *get_mime_type(const char *path)
+/* Format a 200 header with optional Content-Encoding and Vary headers.
+   Returns its length, or -1 if it does not fit. */
+int format_200_headers(char *buf, size_t size, const response_headers_t *h)
 {
-    const char *ext = strrchr(path, '.');
-    if (!ext)
-        return "application/octet-stream";
+    char date[64] = "";
+    if (h->last_modified > 0)
+        format_http_date(h->last_modified, date, sizeof(date));
 
-    /* Use faster hash-like approach based on extension length and first char */
-    size_t ext_len = strlen(ext);
-    char first = ext[0];
-    char second = ext_len > 1 ? ext[1] : '\0';
+    int header_len = snprintf(buf, size,
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Type: %s\r\n"
+                              "Content-Length: %jd\r\n"
+                              "Accept-Ranges: bytes\r\n"
+                              "%s%s%s"
+                              "%s"
+                              "%s%s%s"
+                              "%s%s%s"
+                              "%s%s%s"
+                              "%s"
+                              "\r\n",
+                              h->mime, (intmax_t)h->length,
+                              h->content_encoding ? "Content-Encoding: " : "",
+                              h->content_encoding ? h->content_encoding : "",
+                              h->content_encoding ? "\r\n" : "",
+                              h->vary_encoding ? "Vary: Accept-Encoding\r\n" : "",
+                              h->etag ? "ETag: " : "",
+                              h->etag ? h->etag : "",
+                              h->etag ? "\r\n" : "",
+                              date[0] ? "Last-Modified: " : "",
+                              date,
+                              date[0] ? "\r\n" : "",
+                              h->cache_control ? "Cache-Control: " : "",
+                              h->cache_control ? h->cache_control : "",
+                              h->cache_control ? "\r\n" : "",
+                              h->keep_alive ? "Connection: keep-alive\r\n" : "");
+    return header_len > 0 && (size_t)header_len < size ? header_len : -1;
+}
 
-    /* Quick pre-filter by length and common patterns */
-    if (ext_len == 5) /* .html, .jpeg */
-    {
-        if (strcmp(ext, ".html") == 0)
-            return "text/html";
-        if (strcmp(ext, ".jpeg") == 0)
-            return "image/jpeg";
-    }
-    else if (ext_len == 4)
-    {
-        if (strcmp(ext, ".css") == 0)
-            return "text/css";
-        if (strcmp(ext, ".json") == 0)
-            return "application/json";
-        if (strcmp(ext, ".html") == 0)
-            return "text/html";
-        if (strcmp(ext, ".jpeg") == 0)
-            return "image/jpeg";
-    }
-    else if (ext_len == 3)
-    {
-        if (strcmp(ext, ".js") == 0)
-            return "application/javascript";
-        if (strcmp(ext, ".png") == 0)
-            return "image/png";
-        if (strcmp(ext, ".jpg") == 0)
-            return "image/jpeg";
-        if (strcmp(ext, ".gif") == 0)
-            return "image/gif";
-        if (strcmp(ext, ".svg") == 0)
-            return "image/svg+xml";
-        if (strcmp(ext, ".ico") == 0)
-            return "image/x-icon";
-        if (strcmp(ext, ".xml") == 0)
-            return "application/xml";
-        if (strcmp(ext, ".pdf") == 0)
-            return "application/pdf";
-    }
+void send_200_headers(int client_fd, const response_headers_t *h)
+{
+    char header[768];
+    int header_len = format_200_headers(header, sizeof(header), h);
+    if (header_len > 0)
+        send_response_header(client_fd, 200, header, header_len);
+}
 
-    return "application/octet-stream";
+int send_response_header(int client_fd, int status, const char *buf, size_t len)
+{
+    response.status = status;
+    PROBE3(response__header, client_fd, status, (long)len);
+    return write_buffer_fully(client_fd, buf, (ssize_t)len);
 }
 
 /* Write buffer to socket, handling partial writes */
@@ -376,30 +762,72 @@ int write_buffer_fully(int client_fd, const char *buf, ssize_t size)
         ssize_t wn = write(client_fd, p, (unsigned int)size);
         if (wn <= 0)
             return -1;
+        response.bytes += wn;
         size -= wn;
         p += wn;
     }
     return 0;
 }
 
-/* Stream file using optimized buffer size for better performance */
-int stream_file_fd(int client_fd, int fd, off_t filesize)
+/* Stream file using optimized buffer size for better performance. Reads
+   at explicit offsets and never moves the file position, so requests can
+   share one descriptor. */
+int stream_file_fd(int client_fd, int fd, off_t offset, off_t filesize)
 {
-    static char buf[131072]; /* Increased to 128KB for better performance */
-    ssize_t r;
     off_t remaining = filesize;
 
+#ifdef __linux__
+    /* Zero-copy from the given offset; fall back to read/write only if the
+       kernel refuses this fd pair */
     while (remaining > 0)
     {
-        size_t toread = remaining > (off_t)sizeof(buf) ? sizeof(buf) : (size_t)remaining;
-        r = read(fd, buf, toread);
-        if (r <= 0)
-            return -1;
-        if (write_buffer_fully(client_fd, buf, r) != 0)
-            return -1;
+        size_t chunk = remaining > (off_t)0x7ffff000 ? 0x7ffff000 : (size_t)remaining;
+        ssize_t sent = sendfile(client_fd, fd, &offset, chunk);
+        if (sent > 0)
+        {
+            response.bytes += sent;
+            remaining -= (off_t)sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent < 0 && errno == EAGAIN)
+        {
+            struct pollfd pfd = {.fd = client_fd, .events = POLLOUT};
+            if (poll(&pfd, 1, 5000) <= 0)
+                return -1;
+            continue;
+        }
+        if (sent < 0 && (errno == EINVAL || errno == ENOSYS))
+            break;
+        return -1; /* Error or file shrank underneath us */
+    }
+#endif
+
+    if (remaining <= 0)
+        return 0;
+
+    /* Each caller copies through its own pooled buffer */
+    char *buf = io_buffer_acquire();
+    if (!buf)
+        return -1;
+    size_t buf_size = io_buffer_size();
+
+    int ret = 0;
+    while (remaining > 0)
+    {
+        size_t toread = remaining > (off_t)buf_size ? buf_size : (size_t)remaining;
+        ssize_t r = pread(fd, buf, toread, offset);
+        if (r <= 0 || write_buffer_fully(client_fd, buf, r) != 0)
+        {
+            ret = -1;
+            break;
+        }
+        offset += (off_t)r;
         remaining -= (off_t)r;
     }
-    return 0;
+    io_buffer_release(buf);
+    return ret;
 }
 
 #define TYPE_HTML 0
@@ -537,14 +965,22 @@ int join_path(const char *dir, const char *req, char *out, size_t outlen)
     return 0;
 }
 
-/* Handle a single accepted client connection with keep-alive support */
-void handle_accepted_client(int client_fd, struct sockaddr_in client_addr,
-                            const char *content_directory, const bool show_ext)
+void client_detach_connection(void)
 {
-    char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
-    int client_port = ntohs(client_addr.sin_port);
+    connection_detached = true;
+}
 
+static bool connection_was_detached(void)
+{
+    bool detached = connection_detached;
+    connection_detached = false;
+    return detached;
+}
+
+/* Log a new connection and apply the IP whitelist.
+   Returns false (after sending 403) if the client is not allowed */
+static bool admit_client(int client_fd, const char *client_ip, int client_port)
+{
     char log_msg[128];
     snprintf(log_msg, sizeof(log_msg), "Accepted connection from %s:%d", client_ip, client_port);
     log_info(log_msg);
@@ -552,28 +988,121 @@ void handle_accepted_client(int client_fd, struct sockaddr_in client_addr,
     /* Check whitelist if enabled */
     if (get_whitelist_enabled())
     {
+        arena_t *arena = request_arena();
+        arena_mark_t mark = arena_mark(arena);
         int whitelist_count = 0;
-        char **whitelist_entries = get_whitelist_ips(&whitelist_count);
+        const char **whitelist_entries = get_whitelist_ips(arena, &whitelist_count);
+        bool allowed = whitelist_count == 0 || is_ip_whitelisted(client_ip, whitelist_entries, whitelist_count);
+        arena_rewind(arena, mark);
 
-        if (whitelist_count > 0 && !is_ip_whitelisted(client_ip, whitelist_entries, whitelist_count))
+        if (!allowed)
         {
             char blocked_msg[128];
             snprintf(blocked_msg, sizeof(blocked_msg), "Connection from %s blocked by whitelist", client_ip);
             log_info(blocked_msg);
             send_403(client_fd);
-            free_whitelist_entries(whitelist_entries, whitelist_count);
-            close(client_fd);
-            return;
+            return false;
         }
+    }
 
-        if (whitelist_entries)
-            free_whitelist_entries(whitelist_entries, whitelist_count);
+    return true;
+}
+
+#ifndef _WIN32
+/* Check without blocking whether the next request has started to arrive */
+static int peek_connection(int client_fd)
+{
+    char peek_buf[1];
+    ssize_t peek_result = recv(client_fd, peek_buf, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (peek_result > 0)
+        return CLIENT_CONN_READY;
+    if (peek_result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return CLIENT_CONN_IDLE;
+    return CLIENT_CONN_CLOSE; /* Closed by peer or socket error */
+}
+
+bool client_connection_open(work_item_t *work)
+{
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &work->client_addr.sin_addr, client_ip, sizeof(client_ip));
+
+    work->start_time = time(NULL);
+    work->request_count = 0;
+    socket_apply_client_options(work->client_fd);
+
+    if (!admit_client(work->client_fd, client_ip, ntohs(work->client_addr.sin_port)))
+    {
+        PROBE2(conn__close, work->client_fd, 0);
+        close(work->client_fd);
+        return false;
+    }
+    return true;
+}
+
+/* Serve one request on a pooled connection and report what the scheduler
+   should do with it next. Never blocks waiting for a request to arrive. */
+int client_serve_next_request(work_item_t *work)
+{
+    /* Keep-alive limits: 30 second lifetime, 100 requests per connection */
+    if (work->request_count >= 100 ||
+        (work->request_count > 0 && time(NULL) - work->start_time > 30))
+        return CLIENT_CONN_CLOSE;
+
+    int state = peek_connection(work->client_fd);
+    if (state != CLIENT_CONN_READY)
+        return state;
+
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &work->client_addr.sin_addr, client_ip, sizeof(client_ip));
+
+    handle_http_request_with_timing(work->client_fd, client_ip, work->content_directory, work->show_ext);
+    work->request_count++;
+
+    if (connection_was_detached())
+        return CLIENT_CONN_DETACHED;
+
+    if (work->request_count >= 100)
+        return CLIENT_CONN_CLOSE;
+
+    return peek_connection(work->client_fd);
+}
+
+void client_connection_close(work_item_t *work)
+{
+    if (work->request_count > 1)
+    {
+        char perf_msg[128];
+        snprintf(perf_msg, sizeof(perf_msg), "Connection served %d requests", work->request_count);
+        log_info(perf_msg);
+    }
+    PROBE2(conn__close, work->client_fd, work->request_count);
+    close(work->client_fd);
+}
+#endif
+
+/* Handle a single accepted client connection with keep-alive support */
+void handle_accepted_client(int client_fd, struct sockaddr_in client_addr,
+                            const char *content_directory, const bool show_ext)
+{
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
+    int client_port = ntohs(client_addr.sin_port);
+
+    if (!admit_client(client_fd, client_ip, client_port))
+    {
+        PROBE2(conn__close, client_fd, 0);
+        close(client_fd);
+        return;
     }
+    socket_apply_client_options(client_fd);
 
 #ifdef _WIN32
     /* Windows MSYS: Simplified keep-alive - just handle one request per connection */
     /* Windows socket timeout handling is complex in MSYS, so keep it simple */
     handle_http_request_with_timing(client_fd, client_ip, content_directory, show_ext);
+    if (connection_was_detached())
+        return;
+    PROBE2(conn__close, client_fd, 1);
 #else
     /* POSIX: Full keep-alive support with multiple requests per connection */
     time_t start_time = time(NULL);
@@ -603,6 +1132,9 @@ void handle_accepted_client(int client_fd, struct sockaddr_in client_addr,
         handle_http_request_with_timing(client_fd, client_ip, content_directory, show_ext);
         request_count++;
 
+        if (connection_was_detached())
+            return;
+
         /* Limit requests per connection to prevent abuse */
         if (request_count >= 100)
             break;
@@ -614,11 +1146,51 @@ void handle_accepted_client(int client_fd, struct sockaddr_in client_addr,
         snprintf(perf_msg, sizeof(perf_msg), "Connection served %d requests", request_count);
         log_info(perf_msg);
     }
+    PROBE2(conn__close, client_fd, request_count);
 #endif
 
     close(client_fd);
 }
 
+/* Wait up to a second for pending connections, so shutdown is noticed
+   even when the signal was delivered to another thread */
+static bool wait_for_listener(int server_fd)
+{
+#ifdef _WIN32
+    (void)server_fd;
+    return true; /* Listener stays blocking on Windows */
+#else
+    struct pollfd pfd = {.fd = server_fd, .events = POLLIN};
+    return poll(&pfd, 1, 1000) > 0;
+#endif
+}
+
+/* Accept one pending connection. Returns -1 once the (non-blocking)
+   listener has nothing left to accept, or on error */
+static int accept_next_client(int server_fd, struct sockaddr_in *client_addr)
+{
+    socklen_t addr_len = sizeof(*client_addr);
+#ifdef __linux__
+    /* Accepted sockets stay blocking: workers use blocking reads and sends */
+    int client_fd = accept4(server_fd, (struct sockaddr *)client_addr, &addr_len, SOCK_CLOEXEC);
+#else
+    int client_fd = accept(server_fd, (struct sockaddr *)client_addr, &addr_len);
+#endif
+    if (client_fd < 0)
+    {
+        /* Drained the queue, or interrupted by a signal - the loop re-checks shutdown */
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return -1;
+
+        char err_msg[256];
+        snprintf(err_msg, sizeof(err_msg), "accept() failed: %s", strerror(errno));
+        log_error_code(15, "%s", err_msg);
+        return -1;
+    }
+    PROBE3(conn__accept, client_fd, client_addr->sin_addr.s_addr, ntohs(client_addr->sin_port));
+    return client_fd;
+}
+
 void run_server_loop(int server_fd, const char *content_directory, const bool show_ext)
 {
 #ifdef _WIN32
@@ -633,27 +1205,19 @@ void run_server_loop(int server_fd, const char *content_directory, const bool sh
     /* Main server loop with graceful shutdown support */
     while (!is_shutdown_requested())
     {
-        struct sockaddr_in client_addr;
-        socklen_t addr_len = sizeof(client_addr);
+        if (!wait_for_listener(server_fd))
+            continue;
 
-        int client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &addr_len);
-        if (client_fd < 0)
+        /* Drain the accept queue in one batch per wakeup */
+        for (int i = 0; i < ACCEPT_BATCH; i++)
         {
-            /* EINTR means accept was interrupted by a signal - check if shutdown was requested */
-            if (errno == EINTR)
-            {
-                if (is_shutdown_requested())
-                    break;
-                continue;
-            }
+            struct sockaddr_in client_addr;
+            int client_fd = accept_next_client(server_fd, &client_addr);
+            if (client_fd < 0)
+                break;
 
-            char err_msg[256];
-            snprintf(err_msg, sizeof(err_msg), "accept() failed: %s", strerror(errno));
-            log_error_code(15, "%s", err_msg);
-            continue;
+            handle_accepted_client(client_fd, client_addr, content_directory, show_ext);
         }
-
-        handle_accepted_client(client_fd, client_addr, content_directory, show_ext);
     }
 
     log_info("Graceful shutdown initiated");
@@ -677,34 +1241,34 @@ void run_server_loop_with_threadpool(int server_fd, const char *content_director
     /* Main server loop with thread pool - accepts connections and queues them */
     while (!is_shutdown_requested())
     {
-        struct sockaddr_in client_addr;
-        socklen_t addr_len = sizeof(client_addr);
+        if (!wait_for_listener(server_fd))
+            continue;
 
-        int client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &addr_len);
-        if (client_fd < 0)
+        /* Drain the accept queue in one batch per wakeup */
+        for (int i = 0; i < ACCEPT_BATCH; i++)
         {
-            /* EINTR means accept was interrupted by a signal - check if shutdown was requested */
-            if (errno == EINTR)
+            struct sockaddr_in client_addr;
+            int client_fd = accept_next_client(server_fd, &client_addr);
+            if (client_fd < 0)
+                break;
+
+            /* Shed load with a fast 503 instead of queueing work we cannot serve in time */
+            if (admission_should_shed(threadpool_queue_size(pool)))
             {
-                if (is_shutdown_requested())
-                    break;
+                admission_reject(client_fd);
                 continue;
             }
 
-            char err_msg[256];
-            snprintf(err_msg, sizeof(err_msg), "accept() failed: %s", strerror(errno));
-            log_error_code(15, "%s", err_msg);
-            continue;
-        }
+            /* Submit work to thread pool instead of handling directly */
+            work_item_t work;
+            work.client_fd = client_fd;
+            work.client_addr = client_addr;
+            work.content_directory = content_directory;
+            work.show_ext = show_ext;
 
-        /* Submit work to thread pool instead of handling directly */
-        work_item_t work;
-        work.client_fd = client_fd;
-        work.client_addr = client_addr;
-        work.content_directory = content_directory;
-        work.show_ext = show_ext;
-
-        threadpool_submit(pool, work);
+            if (!threadpool_submit(pool, work))
+                admission_reject(client_fd);
+        }
     }
 
     log_info("Graceful shutdown initiated");
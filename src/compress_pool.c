@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "include/compat.h"
+#include "include/compress_pool.h"
+#include "include/client.h"
+#include "include/logger.h"
+#include "include/io_buffer.h"
+#include "include/probes.h"
+
+#define COMPRESS_LEVEL 6 /* Per-request CPU, unlike the cached level 9 variants */
+
+static struct
+{
+    pthread_t *threads;
+    int num_threads;
+    compress_job_t *jobs; /* Ring of waiting jobs */
+    int capacity;
+    int head;
+    int count;
+    bool shutdown;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} pool = {0};
+
+/* Write one HTTP/1.1 chunk */
+static int write_chunk(int client_fd, const unsigned char *data, size_t len)
+{
+    char size_line[24];
+    int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", len);
+    if (write_buffer_fully(client_fd, size_line, n) != 0 ||
+        write_buffer_fully(client_fd, (const char *)data, (ssize_t)len) != 0 ||
+        write_buffer_fully(client_fd, "\r\n", 2) != 0)
+        return -1;
+    return 0;
+}
+
+/* Headers of a chunked gzip response. A GET is always closed after its
+   body: the connection was handed off, so no worker takes it back for
+   keep-alive. A HEAD has no body and can keep the connection. */
+static int send_chunked_header(const compress_job_t *job, bool keep_alive)
+{
+    char date[64];
+    format_http_date(job->last_modified, date, sizeof(date));
+
+    char header[512];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Type: %s\r\n"
+                              "Content-Encoding: gzip\r\n"
+                              "Vary: Accept-Encoding\r\n"
+                              "ETag: %s\r\n"
+                              "Last-Modified: %s\r\n"
+                              "%s%s%s"
+                              "Transfer-Encoding: chunked\r\n"
+                              "Connection: %s\r\n"
+                              "\r\n",
+                              job->mime, job->etag, date,
+                              job->cache_control ? "Cache-Control: " : "",
+                              job->cache_control ? job->cache_control : "",
+                              job->cache_control ? "\r\n" : "",
+                              keep_alive ? "keep-alive" : "close");
+    if (header_len <= 0 || header_len >= (int)sizeof(header))
+        return -1;
+    return send_response_header(job->client_fd, 200, header, (size_t)header_len);
+}
+
+/* Stream a file through deflate as a chunked gzip body. The z_stream and
+   buffers belong to the calling thread and are reused across jobs. */
+static int stream_gzip_chunked(z_stream *zs, unsigned char *in, unsigned char *out,
+                               const compress_job_t *job)
+{
+    const size_t chunk = io_buffer_size();
+
+    if (send_chunked_header(job, false) != 0)
+        return -1;
+
+    deflateReset(zs);
+    off_t remaining = job->size;
+    int flush = Z_NO_FLUSH;
+
+    do
+    {
+        ssize_t r = 0;
+        if (remaining > 0)
+        {
+            size_t want = remaining > (off_t)chunk ? chunk : (size_t)remaining;
+            r = pread(job->file_fd, in, want, job->size - remaining);
+            if (r < 0)
+                return -1;
+            remaining -= r;
+        }
+        /* A short file (or one truncated under us) ends the stream early */
+        flush = (remaining <= 0 || r == 0) ? Z_FINISH : Z_NO_FLUSH;
+
+        zs->next_in = in;
+        zs->avail_in = (uInt)r;
+        do
+        {
+            zs->next_out = out;
+            zs->avail_out = (uInt)chunk;
+            if (deflate(zs, flush) == Z_STREAM_ERROR)
+                return -1;
+            size_t produced = chunk - zs->avail_out;
+            if (produced > 0 && write_chunk(job->client_fd, out, produced) != 0)
+                return -1;
+        } while (zs->avail_out == 0);
+    } while (flush != Z_FINISH);
+
+    return write_buffer_fully(job->client_fd, "0\r\n\r\n", 5);
+}
+
+/* Finish a response: the body is delimited by the chunked encoding, so
+   half-close and let the client read it all before the socket goes away */
+static void finish_job(const compress_job_t *job)
+{
+    PROBE3(response__body, job->client_fd, response_info()->status, (long)response_info()->bytes);
+#ifndef _WIN32
+    shutdown(job->client_fd, SHUT_WR);
+#endif
+    close(job->file_fd);
+    PROBE2(conn__close, job->client_fd, -1);
+    close(job->client_fd);
+}
+
+static void *compress_thread(void *arg)
+{
+    (void)arg;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    unsigned char *in = io_buffer_acquire();
+    unsigned char *out = io_buffer_acquire();
+    bool ready = in && out &&
+                 deflateInit2(&zs, COMPRESS_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+
+    while (1)
+    {
+        pthread_mutex_lock(&pool.lock);
+        while (pool.count == 0 && !pool.shutdown)
+            pthread_cond_wait(&pool.cond, &pool.lock);
+        if (pool.count == 0)
+        {
+            pthread_mutex_unlock(&pool.lock);
+            break;
+        }
+        compress_job_t job = pool.jobs[pool.head];
+        pool.head = (pool.head + 1) % pool.capacity;
+        pool.count--;
+        pthread_mutex_unlock(&pool.lock);
+
+        response_info_reset();
+        if (ready)
+            stream_gzip_chunked(&zs, in, out, &job);
+        finish_job(&job);
+    }
+
+    if (ready)
+        deflateEnd(&zs);
+    io_buffer_release(in);
+    io_buffer_release(out);
+    return NULL;
+}
+
+void compress_pool_init(int num_threads, int queue_size)
+{
+    if (num_threads <= 0)
+        return;
+
+    pool.capacity = queue_size > 0 ? queue_size : num_threads;
+    pool.jobs = calloc(pool.capacity, sizeof(compress_job_t));
+    pool.threads = calloc(num_threads, sizeof(pthread_t));
+    if (!pool.jobs || !pool.threads)
+    {
+        free(pool.jobs);
+        free(pool.threads);
+        pool.jobs = NULL;
+        pool.threads = NULL;
+        return;
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        if (pthread_create(&pool.threads[i], NULL, compress_thread, NULL) != 0)
+        {
+            log_error_code(19, "Failed to create compression thread");
+            break;
+        }
+        pool.num_threads++;
+    }
+}
+
+bool compress_pool_enabled(void)
+{
+    return pool.num_threads > 0;
+}
+
+int compress_pool_send_head(const compress_job_t *job, bool keep_alive)
+{
+    return send_chunked_header(job, keep_alive);
+}
+
+bool compress_pool_submit(const compress_job_t *job)
+{
+    if (pool.num_threads == 0)
+        return false;
+
+    pthread_mutex_lock(&pool.lock);
+    /* Saturated: every thread is busy and the waiting room is full */
+    if (pool.shutdown || pool.count == pool.capacity)
+    {
+        pthread_mutex_unlock(&pool.lock);
+        return false;
+    }
+    pool.jobs[(pool.head + pool.count) % pool.capacity] = *job;
+    pool.count++;
+    pthread_cond_signal(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+    return true;
+}
+
+void compress_pool_shutdown(void)
+{
+    if (pool.num_threads == 0)
+        return;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.shutdown = true;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 0; i < pool.num_threads; i++)
+        pthread_join(pool.threads[i], NULL);
+
+    free(pool.threads);
+    free(pool.jobs);
+    pool.threads = NULL;
+    pool.jobs = NULL;
+    pool.num_threads = 0;
+}
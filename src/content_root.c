@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+#include "include/compat.h"
+#include "include/content_root.h"
+#include "include/logger.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/openat2.h>)
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+#ifdef SYS_openat2
+#define HAVE_OPENAT2 1
+#endif
+#endif
+#endif
+
+static struct
+{
+    int fd;
+    char path[PATH_MAX];
+    size_t path_len;
+#ifdef HAVE_OPENAT2
+    _Atomic bool openat2_unavailable; /* Old kernel, or filtered by a seccomp policy */
+#endif
+} root = {.fd = -1};
+
+int content_root_open(const char *directory)
+{
+    if (!realpath(directory, root.path))
+    {
+        log_error_code(24, "Failed to resolve content directory %s", directory);
+        return -1;
+    }
+    root.path_len = strlen(root.path);
+    while (root.path_len > 1 && root.path[root.path_len - 1] == '/')
+        root.path[--root.path_len] = '\0';
+
+#ifndef _WIN32
+    root.fd = open(root.path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root.fd < 0)
+    {
+        log_error_code(24, "Failed to open content directory %s", root.path);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+const char *content_root_path(void)
+{
+    return root.path;
+}
+
+/* Keep fd only if it is a regular file or directory, filling *st */
+static int check_file_type(int fd, struct stat *st)
+{
+    if (fd < 0)
+        return -1;
+    int err = 0;
+    if (fstat(fd, st) != 0)
+        err = errno;
+    else if (!S_ISREG(st->st_mode) && !S_ISDIR(st->st_mode))
+        err = EACCES;
+    if (err)
+    {
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+#ifndef _WIN32
+/* Open flags for a content path. O_NONBLOCK keeps a FIFO from blocking the
+   open; it has no effect on the regular files and directories kept. */
+#define CONTENT_OPEN_FLAGS (O_RDONLY | O_NONBLOCK | O_CLOEXEC)
+
+/* Resolve one component at a time from the root, refusing symlinks and
+   ".." so nothing can step outside it */
+static int open_by_walk(const char *rel_path)
+{
+    char buf[PATH_MAX];
+    if (strlen(rel_path) >= sizeof(buf))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(buf, rel_path);
+
+    int dir_fd = root.fd;
+    char *save = NULL;
+    char *component = strtok_r(buf, "/", &save);
+    if (!component)
+        return openat(root.fd, ".", CONTENT_OPEN_FLAGS);
+
+    while (component)
+    {
+        char *next = strtok_r(NULL, "/", &save);
+        if (strcmp(component, "..") == 0)
+        {
+            if (dir_fd != root.fd)
+                close(dir_fd);
+            errno = EXDEV;
+            return -1;
+        }
+        if (strcmp(component, ".") == 0 && next)
+        {
+            component = next;
+            continue;
+        }
+
+        int flags = CONTENT_OPEN_FLAGS | O_NOFOLLOW | (next ? O_DIRECTORY : 0);
+        int fd = openat(dir_fd, component, flags);
+        int saved = errno;
+        /* O_NOFOLLOW | O_DIRECTORY fails a symlinked directory with
+           ENOTDIR; report it as the symlink it is, like the last component */
+        struct stat link_st;
+        if (fd < 0 && saved == ENOTDIR && next &&
+            fstatat(dir_fd, component, &link_st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(link_st.st_mode))
+            saved = ELOOP;
+        if (dir_fd != root.fd)
+            close(dir_fd);
+        if (fd < 0)
+        {
+            errno = saved;
+            return -1;
+        }
+        dir_fd = fd;
+        component = next;
+    }
+    return dir_fd;
+}
+#endif
+
+static int open_beneath(const char *rel_path)
+{
+    while (*rel_path == '/')
+        rel_path++;
+
+#ifdef _WIN32
+    /* No openat(): resolve and check the prefix, as before */
+    char joined[PATH_MAX], resolved[PATH_MAX];
+    if (snprintf(joined, sizeof(joined), "%s/%s", root.path, rel_path) >= (int)sizeof(joined))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (!realpath(joined, resolved))
+        return -1;
+    if (strncmp(resolved, root.path, root.path_len) != 0 ||
+        (resolved[root.path_len] != '/' && resolved[root.path_len] != '\\' && resolved[root.path_len] != '\0'))
+    {
+        errno = EXDEV;
+        return -1;
+    }
+    return open(resolved, O_RDONLY | O_BINARY);
+#else
+    if (root.fd < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+#ifdef HAVE_OPENAT2
+    if (!atomic_load_explicit(&root.openat2_unavailable, memory_order_relaxed))
+    {
+        struct open_how how;
+        memset(&how, 0, sizeof(how));
+        how.flags = CONTENT_OPEN_FLAGS;
+        how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+
+        int fd;
+        do
+            fd = (int)syscall(SYS_openat2, root.fd, rel_path[0] ? rel_path : ".", &how, sizeof(how));
+        while (fd < 0 && (errno == EINTR || errno == EAGAIN));
+        if (fd >= 0 || (errno != ENOSYS && errno != EPERM))
+            return fd;
+
+        if (!atomic_exchange(&root.openat2_unavailable, true))
+            log_info("openat2 unavailable, resolving content paths component by component");
+    }
+#endif
+
+    return open_by_walk(rel_path);
+#endif
+}
+
+int content_open(const char *rel_path, struct stat *st)
+{
+    return check_file_type(open_beneath(rel_path), st);
+}
+
+int content_open_path(const char *path, struct stat *st)
+{
+    if (root.path_len > 0 && strncmp(path, root.path, root.path_len) == 0 &&
+        (path[root.path_len] == '/' || root.path[root.path_len - 1] == '/'))
+        return content_open(path + root.path_len, st);
+#ifdef _WIN32
+    return check_file_type(open(path, O_RDONLY | O_BINARY), st);
+#else
+    return check_file_type(open(path, CONTENT_OPEN_FLAGS), st);
+#endif
+}
+
+void content_root_close(void)
+{
+    if (root.fd >= 0)
+        close(root.fd);
+    root.fd = -1;
+}
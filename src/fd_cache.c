@@ -0,0 +1,129 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "include/compat.h"
+#include "include/fd_cache.h"
+#include "include/content_root.h"
+#include "include/metrics.h"
+#include "include/path_cache.h"
+
+/* Direct-mapped by path hash, like the path cache: a collision evicts.
+   Each slot holds one reference to its handle. */
+static fd_handle_t **slots;
+static int slot_count;
+static pthread_mutex_t fd_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t hash_path(const char *path)
+{
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void fd_cache_init(int entries)
+{
+#ifdef _WIN32
+    /* pread there is seek-then-read, so descriptors cannot be shared */
+    entries = 0;
+#endif
+    if (entries <= 0)
+        return;
+
+    slots = calloc((size_t)entries, sizeof(*slots));
+    if (slots)
+        slot_count = entries;
+}
+
+void fd_cache_release(fd_handle_t *handle)
+{
+    if (handle && atomic_fetch_sub(&handle->refs, 1) == 1)
+    {
+        close(handle->fd);
+        free(handle);
+    }
+}
+
+fd_handle_t *fd_cache_open(const char *rel_path)
+{
+    while (*rel_path == '/')
+        rel_path++;
+
+    fd_handle_t **slot = slots ? &slots[hash_path(rel_path) % (uint32_t)slot_count] : NULL;
+    time_t now = time(NULL);
+
+    if (slot)
+    {
+        pthread_mutex_lock(&fd_cache_lock);
+        fd_handle_t *handle = *slot;
+        if (handle && now - handle->opened_at < FD_CACHE_TTL && strcmp(handle->path, rel_path) == 0)
+        {
+            atomic_fetch_add(&handle->refs, 1);
+            pthread_mutex_unlock(&fd_cache_lock);
+
+            /* One fstat, no path walk: the cached stat is only trusted
+               while the file has not been rewritten since */
+            struct stat current;
+            if (fstat(handle->fd, &current) == 0 && current.st_size == handle->st.st_size &&
+                stat_mtime_ns(&current) == stat_mtime_ns(&handle->st))
+            {
+                metrics_record_fd_cache(true);
+                return handle;
+            }
+            fd_cache_release(handle);
+        }
+        else
+            pthread_mutex_unlock(&fd_cache_lock);
+    }
+
+    /* Miss or stale: open outside the lock, then publish */
+    struct stat st;
+    int fd = content_open(rel_path, &st);
+    if (fd < 0)
+        return NULL;
+
+    size_t len = strlen(rel_path);
+    fd_handle_t *handle = malloc(sizeof(*handle) + len + 1);
+    if (!handle)
+    {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    handle->st = st;
+    handle->fd = fd;
+    handle->opened_at = now;
+    memcpy(handle->path, rel_path, len + 1);
+    atomic_init(&handle->refs, 1);
+    if (slot)
+        metrics_record_fd_cache(false);
+
+    /* Directories and the like are answered once and closed */
+    if (!slot || !S_ISREG(handle->st.st_mode))
+        return handle;
+
+    atomic_fetch_add(&handle->refs, 1);
+    pthread_mutex_lock(&fd_cache_lock);
+    fd_handle_t *evicted = *slot;
+    *slot = handle;
+    pthread_mutex_unlock(&fd_cache_lock);
+
+    fd_cache_release(evicted);
+    return handle;
+}
+
+void fd_cache_shutdown(void)
+{
+    pthread_mutex_lock(&fd_cache_lock);
+    for (int i = 0; i < slot_count; i++)
+    {
+        fd_cache_release(slots[i]);
+        slots[i] = NULL;
+    }
+    pthread_mutex_unlock(&fd_cache_lock);
+}
@@ -5,7 +5,8 @@
 
 #include "include/gzip.h"
 
-/* Compress data using gzip
+/* Compress data into the gzip format (RFC 1952) browsers expect for
+   Content-Encoding: gzip
    Returns malloc'd compressed buffer on success, NULL on failure
    *out_size is set to compressed size */
 char *gzip_compress(const char *data, size_t data_size, size_t *out_size)
@@ -13,23 +14,39 @@ char *gzip_compress(const char *data, size_t data_size, size_t *out_size)
     if (!data || data_size == 0 || !out_size)
         return NULL;
 
-    /* Estimate compressed size (worst case: input size + some overhead) */
-    uLongf compressed_size = compressBound(data_size);
-    char *compressed = malloc(compressed_size);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+
+    /* windowBits 15 + 16 selects a gzip header and trailer instead of zlib's.
+       Variants are compressed once and cached, so spend the CPU on level 9. */
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return NULL;
+
+    /* Worst case output size for this stream */
+    uLong bound = deflateBound(&zs, (uLong)data_size);
+    char *compressed = malloc(bound);
     if (!compressed)
+    {
+        deflateEnd(&zs);
         return NULL;
+    }
+
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = (uInt)data_size;
+    zs.next_out = (Bytef *)compressed;
+    zs.avail_out = (uInt)bound;
 
-    /* Compress using zlib with gzip format */
-    int ret = compress2((unsigned char *)compressed, &compressed_size,
-                        (const unsigned char *)data, data_size, Z_DEFAULT_COMPRESSION);
+    int ret = deflate(&zs, Z_FINISH);
+    size_t produced = zs.total_out;
+    deflateEnd(&zs);
 
-    if (ret != Z_OK)
+    if (ret != Z_STREAM_END)
     {
         free(compressed);
         return NULL;
     }
 
-    *out_size = compressed_size;
+    *out_size = produced;
     return compressed;
 }
 
@@ -1,4 +1,5 @@
 #include <stdio.h>    // snprintf
+#include <stdlib.h>   // free
 #include <string.h>   // strcmp
 #include <unistd.h>   // write
 
@@ -6,11 +7,14 @@
 #include "include/health.h"
 #include "include/metrics.h"
 #include "include/access_log.h"
+#include "include/client.h"
+#include "include/topk.h"
 
 void handle_health(int client_fd, const char *client_ip, const char *method, const char *path){
     metrics_update_memory(); /* Update memory stats */
+    metrics_update_listen_queue();
         metrics_t m = metrics_get();
-        char json_response[768];
+        char json_response[1024];
         int len = snprintf(json_response, sizeof(json_response),
                            "{"
                            "\"status\":\"ok\","
@@ -19,14 +23,40 @@ void handle_health(int client_fd, const char *client_ip, const char *method, con
                            "\"bytes_served\":%lu,"
                            "\"avg_response_time_ms\":%.2f,"
                            "\"peak_memory_kb\":%lu,"
-                           "\"cpu_time_ms\":%.2f"
+                           "\"cpu_time_ms\":%.2f,"
+                           "\"queue_depth\":%d,"
+                           "\"peak_queue_depth\":%d,"
+                           "\"steals\":%lu,"
+                           "\"workers\":%d,"
+                           "\"pool_resizes\":%lu,"
+                           "\"shed_connections\":%lu,"
+                           "\"listen_overflows\":%lu,"
+                           "\"listen_drops\":%lu,"
+                           "\"slab_allocs\":%lu,"
+                           "\"slab_recycles\":%lu,"
+                           "\"slab_chunks\":%lu,"
+                           "\"fd_cache_hits\":%lu,"
+                           "\"fd_cache_misses\":%lu"
                            "}",
                            metrics_get_uptime(),
                            m.total_requests,
                            m.total_bytes,
                            m.avg_response_time,
                            m.peak_memory_bytes / 1024,
-                           m.total_cpu_time_ms);
+                           m.total_cpu_time_ms,
+                           m.queue_depth,
+                           m.peak_queue_depth,
+                           m.total_steals,
+                           m.workers,
+                           m.pool_resizes,
+                           m.shed_connections,
+                           m.listen_overflows,
+                           m.listen_drops,
+                           m.slab_allocs,
+                           m.slab_recycles,
+                           m.slab_chunks,
+                           m.fd_cache_hits,
+                           m.fd_cache_misses);
 
         char header[256];
         int header_len = snprintf(header, sizeof(header),
@@ -37,9 +67,39 @@ void handle_health(int client_fd, const char *client_ip, const char *method, con
                                   len);
 
         if (header_len > 0)
-            write(client_fd, header, header_len);
+            send_response_header(client_fd, 200, header, header_len);
         if (len > 0)
-            write(client_fd, json_response, len);
+            write_buffer_fully(client_fd, json_response, len);
 
         access_log_request(client_ip, method, path, "HTTP/1.1", 200, len, NULL, NULL);
+}
+
+/* Busiest paths, clients and status codes (see topk.h). Client addresses
+   are not for everyone, so like /admin/warmup it answers loopback only. */
+void handle_status_top(int client_fd, const char *client_ip, const char *method, const char *path)
+{
+    if (strcmp(client_ip, "127.0.0.1") != 0)
+    {
+        send_403(client_fd);
+        access_log_request(client_ip, method, path, "HTTP/1.1", 403, 9, NULL, NULL);
+        return;
+    }
+
+    char *json = topk_json();
+    if (!json)
+        return;
+    size_t len = strlen(json);
+
+    char header[256];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Type: application/json\r\n"
+                              "Content-Length: %zu\r\n"
+                              "\r\n",
+                              len);
+    if (header_len > 0 && send_response_header(client_fd, 200, header, header_len) == 0)
+        write_buffer_fully(client_fd, json, (ssize_t)len);
+
+    access_log_request(client_ip, method, path, "HTTP/1.1", 200, (long)len, NULL, NULL);
+    free(json);
 }
\ No newline at end of file
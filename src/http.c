@@ -7,6 +7,7 @@
 #include <ctype.h>    // isxdigit
 #include <limits.h>   // PATH_MAX
 #include <time.h>     // time
+#include <errno.h>    // errno
 
 #include "include/compat.h"
 
@@ -26,14 +27,49 @@
 #include "include/shutdown.h"
 #include "include/threadpool.h"
 #include "include/health.h"
+#include "include/path_cache.h"
+#include "include/compress_pool.h"
+#include "include/warmup.h"
+#include "include/bundle.h"
+#include "include/arena.h"
+#include "include/content_root.h"
+#include "include/fd_cache.h"
+#include "include/probes.h"
 
 /* Forward declarations */
-static int serve_file_cached(int client_fd, const char *file_path, const char *method,
-                             const char *request_path, bool keep_alive, const char *request_buf);
+static int serve_file_cached(int client_fd, fd_handle_t *file, const char *method, bool keep_alive,
+                             const char *request_buf);
 
-/* Helper: Handle directory in SHOW-EXTENSION mode */
-static int handle_show_ext_directory(int client_fd, const char *content_directory, char *path,
-                                      char *candidate, const char *request_buf)
+/* Helper: A PATH_MAX buffer from the request arena, released when the
+   request ends */
+static char *path_buffer(void)
+{
+    return arena_alloc(request_arena(), PATH_MAX);
+}
+
+/* Helper: Answer a path that could not be opened. Paths that would leave
+   the content root (or that we may not read) are forbidden; anything
+   else simply does not exist. */
+static void send_open_error(int client_fd, int err)
+{
+    if (err == EXDEV || err == ELOOP || err == EACCES || err == EPERM)
+        send_403(client_fd);
+    else
+        send_404(client_fd);
+}
+
+/* Helper: Whether a request path names a regular file beneath the root */
+static bool content_is_file(const char *rel_path)
+{
+    fd_handle_t *file = fd_cache_open(rel_path);
+    bool is_file = file && S_ISREG(file->st.st_mode);
+    fd_cache_release(file);
+    return is_file;
+}
+
+/* Helper: Handle directory in SHOW-EXTENSION mode. Returns its open
+   index.html, or NULL once a response has been sent. */
+static fd_handle_t *handle_show_ext_directory(int client_fd, const char *path)
 {
     size_t plen = strlen(path);
     if (path[plen - 1] != '/')
@@ -41,43 +77,56 @@ static int handle_show_ext_directory(int client_fd, const char *content_director
         char with_slash[1024];
         snprintf(with_slash, sizeof(with_slash), "%s/", path);
         send_301_location(client_fd, with_slash);
-        return 0;
+        return NULL;
     }
-    
-    size_t n = snprintf(candidate, PATH_MAX, "%s%sindex.html",
-                        content_directory,
-                        path[0] == '/' ? path + 1 : path);
-    
-    struct stat st;
-    if (n >= PATH_MAX || stat(candidate, &st) != 0 || !S_ISREG(st.st_mode))
+
+    char *candidate = path_buffer();
+    if (!candidate || snprintf(candidate, PATH_MAX, "%sindex.html", path) >= PATH_MAX)
     {
         send_404(client_fd);
-        return -1;
+        return NULL;
     }
-    return 0;
+
+    fd_handle_t *file = fd_cache_open(candidate);
+    if (!file)
+    {
+        send_open_error(client_fd, errno);
+        return NULL;
+    }
+    if (!S_ISREG(file->st.st_mode))
+    {
+        fd_cache_release(file);
+        send_404(client_fd);
+        return NULL;
+    }
+    return file;
 }
 
-/* Helper: Resolve file with optional .html extension in SHOW-EXTENSION mode */
-static int resolve_show_ext_file(int client_fd, const char *content_directory, char *path, char *candidate)
+/* Helper: Resolve file with optional .html extension in SHOW-EXTENSION mode.
+   Returns it open, or NULL once a response has been sent. */
+static fd_handle_t *resolve_show_ext_file(int client_fd, const char *path)
 {
-    struct stat st;
-    if (strrchr(path, '.') == NULL)
+    char *candidate = path_buffer();
+    if (strrchr(path, '.') == NULL && candidate &&
+        snprintf(candidate, PATH_MAX, "%s.html", path) < PATH_MAX)
     {
-        char alt[PATH_MAX];
-        if (snprintf(alt, sizeof(alt), "%s%s.html", content_directory, path) < (int)sizeof(alt) &&
-            stat(alt, &st) == 0 && S_ISREG(st.st_mode))
+        fd_handle_t *file = fd_cache_open(candidate);
+        if (file && S_ISREG(file->st.st_mode))
+            return file;
+        if (file)
+            fd_cache_release(file);
+        else if (errno != ENOENT && errno != ENOTDIR)
         {
-            strncpy(candidate, alt, PATH_MAX - 1);
-            candidate[PATH_MAX - 1] = '\0';
-            return 0;
+            send_open_error(client_fd, errno);
+            return NULL;
         }
     }
     send_404(client_fd);
-    return -1;
+    return NULL;
 }
 
-static int show_ext_mode(int client_fd, const char *content_directory, const char *method,
-                         char *path, bool keep_alive, const char *request_buf, const char *abs_content)
+static int show_ext_mode(int client_fd, const char *method, char *path, bool keep_alive,
+                         const char *request_buf)
 {
     if (strcmp(path, "/") == 0)
     {
@@ -85,118 +134,92 @@ static int show_ext_mode(int client_fd, const char *content_directory, const cha
         return 0;
     }
 
-    char candidate[PATH_MAX];
-    if (join_path(content_directory, path, candidate, sizeof(candidate)) != 0)
+    fd_handle_t *file = fd_cache_open(path);
+    if (!file && errno != ENOENT && errno != ENOTDIR)
     {
-        send_404(client_fd);
+        send_open_error(client_fd, errno);
         return -1;
     }
 
-    struct stat st;
-    if (stat(candidate, &st) == 0 && S_ISDIR(st.st_mode))
+    if (file && S_ISDIR(file->st.st_mode))
     {
-        if (handle_show_ext_directory(client_fd, content_directory, path, candidate, request_buf) != 0)
-            return -1;
+        fd_cache_release(file);
+        file = handle_show_ext_directory(client_fd, path);
     }
-    else if (stat(candidate, &st) != 0 || !S_ISREG(st.st_mode))
+    else if (!file || !S_ISREG(file->st.st_mode))
     {
-        if (resolve_show_ext_file(client_fd, content_directory, path, candidate) != 0)
-            return -1;
+        fd_cache_release(file);
+        file = resolve_show_ext_file(client_fd, path);
     }
-
-    char abs_candidate[PATH_MAX];
-    if (!realpath(candidate, abs_candidate) ||
-        strncmp(abs_candidate, abs_content, strlen(abs_content)) != 0 ||
-        (abs_candidate[strlen(abs_content)] != '/' && abs_candidate[strlen(abs_content)] != '\0'))
-    {
-        send_403(client_fd);
+    if (!file)
         return -1;
-    }
 
-    return serve_file_cached(client_fd, abs_candidate, method, path, keep_alive, request_buf);
+    return serve_file_cached(client_fd, file, method, keep_alive, request_buf);
 }
 
-/* Helper: Handle root path in HIDE-EXTENSION mode */
-static int handle_hide_ext_root(int client_fd, const char *content_directory, const char *method,
-                                 bool keep_alive, const char *request_buf, const char *abs_content)
+/* Helper: Open a path that must be a regular file in HIDE-EXTENSION mode
+   and serve it */
+static int serve_hide_ext_file(int client_fd, const char *rel_path, const char *method,
+                               bool keep_alive, const char *request_buf)
 {
-    char cand[PATH_MAX];
-    if (join_path(content_directory, "/index.html", cand, sizeof(cand)) != 0)
+    fd_handle_t *file = fd_cache_open(rel_path);
+    if (!file)
     {
-        send_404(client_fd);
+        send_open_error(client_fd, errno);
         return -1;
     }
-    
-    struct stat st;
-    if (stat(cand, &st) != 0 || !S_ISREG(st.st_mode))
+    if (!S_ISREG(file->st.st_mode))
     {
+        fd_cache_release(file);
         send_404(client_fd);
         return -1;
     }
-    
-    char abs_cand[PATH_MAX];
-    if (!realpath(cand, abs_cand) ||
-        strncmp(abs_cand, abs_content, strlen(abs_content)) != 0)
-    {
-        send_403(client_fd);
-        return -1;
-    }
-    
-    return serve_file_cached(client_fd, abs_cand, method, "/index.html", keep_alive, request_buf);
+
+    return serve_file_cached(client_fd, file, method, keep_alive, request_buf);
 }
 
 /* Helper: Check for .html redirect in HIDE-EXTENSION mode */
-static int check_html_redirect(int client_fd, const char *content_directory, const char *path)
+static int check_html_redirect(int client_fd, const char *path)
 {
     const char *ext = strrchr(path, '.');
-    if (ext && strcmp(ext, ".html") == 0)
+    if (ext && strcmp(ext, ".html") == 0 && content_is_file(path))
     {
-        char requested_fs[PATH_MAX];
-        if (join_path(content_directory, path, requested_fs, sizeof(requested_fs)) == 0)
+        size_t base_len = (size_t)(ext - path);
+        char clean_path[1024];
+
+        if (base_len == 0)
+            strcpy(clean_path, "/");
+        else
         {
-            struct stat rst;
-            if (stat(requested_fs, &rst) == 0 && S_ISREG(rst.st_mode))
-            {
-                size_t base_len = (size_t)(ext - path);
-                char clean_path[1024];
-                
-                if (base_len == 0)
-                    strcpy(clean_path, "/");
-                else
-                {
-                    size_t copy_len = base_len < sizeof(clean_path) - 2 ? base_len : sizeof(clean_path) - 2;
-                    memcpy(clean_path, path, copy_len);
-                    clean_path[copy_len] = '\0';
-                    size_t rl = strlen(clean_path);
-                    if (rl > 0 && clean_path[rl - 1] != '/')
-                        strcat(clean_path, "/");
-                }
-
-                char candidate_fs[PATH_MAX];
-                if (snprintf(candidate_fs, sizeof(candidate_fs), "%s%sindex.html", content_directory,
-                             clean_path[0] == '/' ? clean_path + 1 : clean_path) < (int)sizeof(candidate_fs))
-                {
-                    struct stat cst;
-                    if (stat(candidate_fs, &cst) == 0 && S_ISREG(cst.st_mode))
-                    {
-                        send_301_location(client_fd, clean_path);
-                        return 1;
-                    }
-                }
-            }
+            size_t copy_len = base_len < sizeof(clean_path) - 2 ? base_len : sizeof(clean_path) - 2;
+            memcpy(clean_path, path, copy_len);
+            clean_path[copy_len] = '\0';
+            size_t rl = strlen(clean_path);
+            if (rl > 0 && clean_path[rl - 1] != '/')
+                strcat(clean_path, "/");
+        }
+
+        char *index = path_buffer();
+        if (index && snprintf(index, PATH_MAX, "%sindex.html", clean_path) < PATH_MAX &&
+            content_is_file(index))
+        {
+            send_301_location(client_fd, clean_path);
+            return 1;
         }
     }
     return 0;
 }
 
 /* Helper: Resolve final path in HIDE-EXTENSION mode */
-static int resolve_hide_ext_path(int client_fd, const char *content_directory, const char *method,
-                                  char *path, bool keep_alive, const char *request_buf, const char *abs_content)
+static int resolve_hide_ext_path(int client_fd, const char *method, char *path, bool keep_alive,
+                                  const char *request_buf)
 {
-    char resolved_req[PATH_MAX];
+    char *resolved_req = path_buffer();
+    if (!resolved_req)
+        return -1;
     if (strrchr(path, '.') == NULL)
     {
-        if (snprintf(resolved_req, sizeof(resolved_req), "%s.html", path) >= (int)sizeof(resolved_req))
+        if (snprintf(resolved_req, PATH_MAX, "%s.html", path) >= PATH_MAX)
         {
             send_404(client_fd);
             return -1;
@@ -204,183 +227,563 @@ static int resolve_hide_ext_path(int client_fd, const char *content_directory, c
     }
     else
     {
-        strncpy(resolved_req, path, sizeof(resolved_req) - 1);
-        resolved_req[sizeof(resolved_req) - 1] = '\0';
+        strncpy(resolved_req, path, PATH_MAX - 1);
+        resolved_req[PATH_MAX - 1] = '\0';
+    }
+
+    return serve_hide_ext_file(client_fd, resolved_req, method, keep_alive, request_buf);
+}
+
+static int hide_ext_mode(int client_fd, const char *method, char *path, bool keep_alive,
+                         const char *request_buf)
+{
+    if (strcmp(path, "/") == 0)
+        return serve_hide_ext_file(client_fd, "index.html", method, keep_alive, request_buf);
+
+    size_t plen = strlen(path);
+    if (plen > 1 && path[plen - 1] == '/')
+        path[plen - 1] = '\0';
+
+    if (check_html_redirect(client_fd, path))
+        return 0;
+
+    return resolve_hide_ext_path(client_fd, method, path, keep_alive, request_buf);
+}
+
+/* Helper: Answer a conditional request. If-None-Match takes precedence over
+   If-Modified-Since; returns true if a 304 was sent. */
+static bool answer_not_modified(int client_fd, const char *request_buf, const char *etag,
+                                const char *gzip_etag, time_t mtime, const char *cache_control)
+{
+    int match = check_if_none_match(request_buf, etag, gzip_etag);
+    if (match > 0)
+    {
+        send_304(client_fd, match == 2 ? gzip_etag : etag, mtime, cache_control);
+        return true;
     }
 
-    char candidate_fs[PATH_MAX];
-    if (join_path(content_directory, resolved_req, candidate_fs, sizeof(candidate_fs)) != 0)
+    time_t if_modified_since = 0;
+    if (match < 0 && get_if_modified_since(request_buf, &if_modified_since) && if_modified_since >= mtime)
     {
-        send_404(client_fd);
-        return -1;
+        send_304(client_fd, etag, mtime, cache_control);
+        return true;
     }
+    return false;
+}
 
-    char abs_candidate[PATH_MAX];
-    if (!realpath(candidate_fs, abs_candidate) ||
-        strncmp(abs_candidate, abs_content, strlen(abs_content)) != 0 ||
-        (abs_candidate[strlen(abs_content)] != '/' && abs_candidate[strlen(abs_content)] != '\0'))
+/* Helper: Send a 200 header plus body, choosing the gzip variant when allowed.
+   Validators (ETag, Last-Modified) come from the file's metadata. */
+static int send_variant(int client_fd, const cache_entry_t *entry, const path_meta_t *meta,
+                        bool use_gzip, bool keep_alive, bool head_only)
+{
+    const char *data = entry->data, *gzip_data = entry->gzip_data;
+    size_t size = entry->size, gzip_size = entry->gzip_size;
+
+    response_headers_t h = {0};
+    h.mime = entry->mime_type;
+    h.keep_alive = keep_alive;
+    h.vary_encoding = gzip_data != NULL || is_compressible_mime(entry->mime_type);
+    h.etag = meta->etag;
+    h.last_modified = meta->mtime;
+    h.cache_control = meta->cache_control;
+
+    if (use_gzip && gzip_data)
     {
-        send_403(client_fd);
-        return -1;
+        h.content_encoding = "gzip";
+        h.etag = meta->gzip_etag;
+        h.length = (off_t)gzip_size;
+        send_200_headers(client_fd, &h);
+        return head_only ? 0 : write_buffer_fully(client_fd, gzip_data, gzip_size);
     }
 
+    h.length = (off_t)size;
+    send_200_headers(client_fd, &h);
+    return head_only ? 0 : write_buffer_fully(client_fd, data, size);
+}
+
+/* Helper: Open the .gz sidecar of a file, built in buf. Files under the
+   content root resolve it beneath the root like the file itself. */
+static int open_sidecar(char *buf, const char *file_path)
+{
     struct stat st;
-    if (stat(abs_candidate, &st) != 0 || !S_ISREG(st.st_mode))
+    if (snprintf(buf, PATH_MAX, "%s.gz", file_path) >= PATH_MAX)
+        return -1;
+    int fd = content_open_path(buf, &st);
+    if (fd >= 0 && !S_ISREG(st.st_mode))
     {
-        send_404(client_fd);
+        close(fd);
         return -1;
     }
-
-    return serve_file_cached(client_fd, abs_candidate, method, resolved_req, keep_alive, request_buf);
+    return fd;
 }
 
-static int hide_ext_mode(int client_fd, const char *content_directory, const char *method,
-                         char *path, bool keep_alive, const char *request_buf, const char *abs_content)
+/* Helper: Load a precompressed .gz sidecar into the arena. Returns NULL if
+   it cannot be read in full. */
+static char *read_gzip_sidecar(arena_t *arena, const char *file_path, off_t gz_size)
 {
-    if (strcmp(path, "/") == 0)
-        return handle_hide_ext_root(client_fd, content_directory, method, keep_alive, request_buf, abs_content);
-
-    size_t plen = strlen(path);
-    if (plen > 1 && path[plen - 1] == '/')
-        path[plen - 1] = '\0';
+    char *sidecar = arena_alloc(arena, PATH_MAX);
+    if (!sidecar || gz_size <= 0)
+        return NULL;
 
-    if (check_html_redirect(client_fd, content_directory, path))
-        return 0;
+    int fd = open_sidecar(sidecar, file_path);
+    if (fd < 0)
+        return NULL;
 
-    return resolve_hide_ext_path(client_fd, content_directory, method, path, keep_alive, request_buf, abs_content);
+    char *data = arena_alloc(arena, gz_size);
+    if (data && read(fd, data, gz_size) != gz_size)
+        data = NULL;
+    close(fd);
+    return data;
 }
 
-/* Helper: Check cache or serve from file */
-static int serve_or_cache_file(int client_fd, int fd, const char *file_path, const char *mime,
-                                off_t file_size, bool keep_alive)
+/* Read a small file (and its gzip variant) into the file cache. The reads
+   go through the calling thread's arena, since cache_put() keeps its own
+   copy; they are released as soon as the entry exists. */
+cache_entry_t *http_cache_file(int fd, const char *file_path, const char *mime, const path_meta_t *meta)
 {
-    if (file_size <= CACHE_MAX_FILE_SIZE && file_size > 0)
+    off_t file_size = meta->size;
+    if (file_size > CACHE_MAX_FILE_SIZE || file_size <= 0)
+        return NULL;
+
+    arena_t *arena = request_arena();
+    arena_mark_t mark = arena_mark(arena);
+    char *buffer = arena_alloc(arena, file_size);
+    if (!buffer)
+        return NULL;
+
+    if (pread(fd, buffer, file_size, 0) != file_size)
+    {
+        arena_rewind(arena, mark);
+        return NULL;
+    }
+
+    /* Prefer the operator's precompressed sidecar; otherwise compress once
+       here. Every later hit reuses the cached variant. */
+    char *gz = NULL;
+    size_t gz_size = 0;
+    bool compressed = false;
+    if (meta->has_gzip_sidecar && (gz = read_gzip_sidecar(arena, file_path, meta->gzip_size)) != NULL)
+    {
+        gz_size = (size_t)meta->gzip_size;
+    }
+    else if (is_compressible_mime(mime))
     {
-        char *buffer = malloc(file_size);
-        if (buffer)
+        gz = gzip_compress(buffer, file_size, &gz_size);
+        compressed = gz != NULL;
+        if (gz && gz_size >= (size_t)file_size)
         {
-            ssize_t bytes_read = read(fd, buffer, file_size);
-            if (bytes_read == file_size)
-            {
-                struct stat st;
-                stat(file_path, &st);
-                cache_put(file_path, buffer, file_size, mime, st.st_mtime);
-                
-                if (write_buffer_fully(client_fd, buffer, file_size) == 0)
-                {
-                    free(buffer);
-                    return 0;
-                }
-            }
-            free(buffer);
+            gzip_free(gz); /* Not worth it */
+            gz = NULL;
+            compressed = false;
         }
-        lseek(fd, 0, SEEK_SET);
     }
-    
-    return stream_file_fd(client_fd, fd, file_size);
+
+    cache_entry_t *entry = cache_put(file_path, buffer, file_size, gz, gz_size, mime, meta->cache_mtime);
+    if (compressed)
+        gzip_free(gz);
+    arena_rewind(arena, mark);
+    return entry;
 }
 
-/* Helper: Handle range requests */
-static int handle_range_request(int client_fd, int fd, const char *mime, off_t range_start,
-                                 off_t range_end, off_t file_size, const char *method)
+/* Helper: Read a small file into the cache (with its gzip variant) and serve it.
+   Returns -2 if the file could not be cached, so the caller streams it instead. */
+static int serve_or_cache_file(int client_fd, int fd, const char *file_path, const char *mime,
+                                const path_meta_t *meta, bool use_gzip, bool keep_alive)
 {
-    send_206_header(client_fd, mime, range_start, range_end, file_size);
-    if (strcmp(method, "HEAD") == 0)
+    cache_entry_t *entry = http_cache_file(fd, file_path, mime, meta);
+    if (!entry)
+        return -2;
+
+    int ret = send_variant(client_fd, entry, meta, use_gzip, keep_alive, false);
+    cache_release(entry);
+    return ret;
+}
+
+/* Helper: Send one segment of a representation, from memory when it is
+   cached, otherwise zero-copy from the file at the segment's offset */
+static int send_range_segment(int client_fd, const char *data, int fd, const byte_range_t *range)
+{
+    off_t length = range->end - range->start + 1;
+    if (data)
+        return write_buffer_fully(client_fd, data + range->start, (size_t)length);
+    return stream_file_fd(client_fd, fd, range->start, length);
+}
+
+/* Helper: Format the part header that precedes a range in a
+   multipart/byteranges body */
+static int format_part_header(char *buf, size_t size, const char *boundary, const char *mime,
+                              const byte_range_t *range, off_t total_size)
+{
+    return snprintf(buf, size,
+                    "\r\n--%s\r\n"
+                    "Content-Type: %s\r\n"
+                    "Content-Range: bytes %jd-%jd/%jd\r\n"
+                    "\r\n",
+                    boundary, mime, (intmax_t)range->start, (intmax_t)range->end, (intmax_t)total_size);
+}
+
+/* Helper: Answer a range request with a 206. A single range is sent as-is;
+   several become a multipart/byteranges body. The body comes from data
+   when non-NULL, otherwise from fd. h carries the identity validators. */
+static int send_ranges(int client_fd, response_headers_t *h, const byte_range_t *ranges, int count,
+                       off_t total_size, const char *data, int fd, bool head_only)
+{
+    if (count == 1)
     {
-        close(fd);
+        h->length = ranges[0].end - ranges[0].start + 1;
+        send_206_header(client_fd, h, &ranges[0], total_size, NULL);
+        return head_only ? 0 : send_range_segment(client_fd, data, fd, &ranges[0]);
+    }
+
+    static atomic_uint boundary_counter;
+    char boundary[40];
+    snprintf(boundary, sizeof(boundary), "%08lx%08x",
+             (unsigned long)time(NULL), atomic_fetch_add(&boundary_counter, 1));
+
+    /* Content-Length covers every part header, segment and the closing
+       delimiter, so the connection can stay alive */
+    static const char closing_fmt[] = "\r\n--%s--\r\n";
+    char part[512];
+    off_t body_length = snprintf(part, sizeof(part), closing_fmt, boundary);
+    for (int i = 0; i < count; i++)
+        body_length += format_part_header(part, sizeof(part), boundary, h->mime, &ranges[i], total_size) +
+                       (ranges[i].end - ranges[i].start + 1);
+
+    h->length = body_length;
+    send_206_header(client_fd, h, NULL, total_size, boundary);
+    if (head_only)
         return 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        int part_len = format_part_header(part, sizeof(part), boundary, h->mime, &ranges[i], total_size);
+        if (write_buffer_fully(client_fd, part, part_len) != 0 ||
+            send_range_segment(client_fd, data, fd, &ranges[i]) != 0)
+            return -1;
+    }
+    int closing_len = snprintf(part, sizeof(part), closing_fmt, boundary);
+    return write_buffer_fully(client_fd, part, closing_len);
+}
+
+/* Helper: Handle range requests. A cached entry serves the segments
+   without reopening the file. */
+static int handle_range_request(int client_fd, int fd, const char *file_path, const char *method,
+                                const char *mime, const path_meta_t *meta,
+                                const byte_range_t *ranges, int count, bool keep_alive)
+{
+    response_headers_t h = {0};
+    h.mime = mime;
+    h.keep_alive = keep_alive;
+    h.etag = meta->etag;
+    h.last_modified = meta->mtime;
+    h.cache_control = meta->cache_control;
+    bool head_only = strcmp(method, "HEAD") == 0;
+
+    /* Ranges were clamped to the metadata size, so only an entry of the
+       same size may serve them */
+    cache_entry_t *cached = cache_get(file_path, meta->cache_mtime);
+    if (cached && (off_t)cached->size == meta->size)
+    {
+        int ret = send_ranges(client_fd, &h, ranges, count, meta->size, cached->data, -1, head_only);
+        cache_release(cached);
+        return ret;
     }
-    
-    lseek(fd, range_start, SEEK_SET);
-    off_t range_size = range_end - range_start + 1;
-    return stream_file_fd(client_fd, fd, range_size);
+    if (cached)
+        cache_release(cached);
+
+    return send_ranges(client_fd, &h, ranges, count, meta->size, NULL, fd, head_only);
 }
 
 /* Helper: Check cache and serve */
 static int check_and_serve_cache(int client_fd, const char *file_path, const char *method,
-                                  const char *mime, bool keep_alive)
+                                  const path_meta_t *meta, bool use_gzip, bool keep_alive)
 {
-    cache_entry_t *cached = cache_get(file_path);
-    if (!cached || strcmp(method, "HEAD") == 0)
+    cache_entry_t *cached = cache_get(file_path, meta->cache_mtime);
+    if (!cached)
+    {
+        PROBE2(cache__miss, client_fd, file_path);
         return -1;
+    }
+    PROBE2(cache__hit, client_fd, file_path);
 
-    if (keep_alive)
-        send_200_header_keepalive(client_fd, cached->mime_type, cached->size);
-    else
-        send_200_header(client_fd, cached->mime_type, cached->size);
+    /* HEAD gets the same headers the cached GET would */
+    int ret = send_variant(client_fd, cached, meta, use_gzip, keep_alive, strcmp(method, "HEAD") == 0);
+    cache_release(cached);
+    return ret == 0 ? 0 : -1;
+}
 
-    if (write_buffer_fully(client_fd, cached->data, cached->size) != 0)
-        return -1;
-    
-    return 0;
+/* Helper: Stream the .gz sidecar of a file too large for the cache.
+   Returns -2 if the sidecar could not be opened, so the caller serves identity. */
+static int serve_gzip_sidecar(int client_fd, const char *file_path, const char *method,
+                              const char *mime, const path_meta_t *meta, bool keep_alive)
+{
+    char *sidecar = path_buffer();
+    if (!sidecar)
+        return -2;
+
+    int fd = open_sidecar(sidecar, file_path);
+    if (fd < 0)
+        return -2;
+
+    response_headers_t h = {0};
+    h.mime = mime;
+    h.length = meta->gzip_size;
+    h.keep_alive = keep_alive;
+    h.content_encoding = "gzip";
+    h.vary_encoding = true;
+    h.etag = meta->gzip_etag;
+    h.last_modified = meta->mtime;
+    h.cache_control = meta->cache_control;
+    send_200_headers(client_fd, &h);
+
+    int ret = strcmp(method, "HEAD") == 0 ? 0 : stream_file_fd(client_fd, fd, 0, meta->gzip_size);
+    close(fd);
+    return ret;
 }
 
-/* Serve file with caching support, conditional requests, range requests, and gzip */
-static int serve_file_cached(int client_fd, const char *file_path, const char *method,
-                             const char *request_path, bool keep_alive, const char *request_buf)
+/* Serve an open file with caching support, conditional requests, range
+   requests, and gzip. fd may be shared with other requests, so it is
+   only read at explicit offsets. */
+static int serve_open_file(int client_fd, int fd, const struct stat *st, const char *file_path,
+                           const char *method, bool keep_alive, const char *request_buf)
 {
-    struct stat st;
-    if (stat(file_path, &st) != 0 || !S_ISREG(st.st_mode))
+    /* The fstat of the open file validates the cached metadata, so a
+       revalidation costs one open and no path walk */
+    path_meta_t meta;
+    if (path_cache_lookup_stat(file_path, st, &meta) != 0)
         return -1;
 
-    time_t if_modified_since = 0;
-    if (get_if_modified_since(request_buf, &if_modified_since))
+    if (answer_not_modified(client_fd, request_buf, meta.etag, meta.gzip_etag, meta.mtime,
+                            meta.cache_control))
+        return 0;
+
+    off_t file_size = meta.size;
+    const char *mime = meta.mime;
+
+    /* Ranges always address the identity representation, and only apply
+       while the client's If-Range validator is current */
+    byte_range_t ranges[MAX_BYTE_RANGES];
+    int range_count = 0;
+    if (if_range_matches(request_buf, meta.etag, meta.mtime))
+        range_count = parse_range_header(request_buf, file_size, ranges, MAX_BYTE_RANGES);
+    if (range_count < 0)
+    {
+        send_416(client_fd, file_size);
+        return 0;
+    }
+    if (range_count > 0)
+        return handle_range_request(client_fd, fd, file_path, method, mime, &meta, ranges, range_count,
+                                    keep_alive);
+
+    /* A sidecar is an explicit opt-in by the operator, so it is honoured
+       for any type */
+    bool accepts_gzip = get_accepts_gzip(request_buf);
+    bool use_gzip = accepts_gzip && (meta.has_gzip_sidecar || is_compressible_mime(mime));
+
+    if (check_and_serve_cache(client_fd, file_path, method, &meta, use_gzip, keep_alive) == 0)
+        return 0;
+
+    /* Large files with a sidecar: stream the precompressed bytes as-is */
+    if (use_gzip && meta.has_gzip_sidecar && file_size > CACHE_MAX_FILE_SIZE)
+    {
+        int ret = serve_gzip_sidecar(client_fd, file_path, method, mime, &meta, keep_alive);
+        if (ret != -2)
+            return ret;
+    }
+
+    if (strcmp(method, "GET") == 0)
     {
-        if (if_modified_since >= st.st_mtime)
+        int ret = serve_or_cache_file(client_fd, fd, file_path, mime, &meta, use_gzip, keep_alive);
+        if (ret != -2)
+            return ret;
+
+        /* Too large to cache: deflate it on the compression pool as a
+           chunked response, or send identity if that pool is saturated.
+           Small files that could not be cached (empty, or a short read)
+           go out as identity, as HEAD describes them. */
+        if (use_gzip && is_compressible_mime(mime) && file_size > CACHE_MAX_FILE_SIZE)
         {
-            send_304(client_fd);
-            return 0;
+            /* The pool closes its descriptor when done, so it gets its own */
+            int job_fd = dup(fd);
+            compress_job_t job = {client_fd, job_fd, file_size, mime, "", meta.mtime, meta.cache_control};
+            strncpy(job.etag, meta.gzip_etag, sizeof(job.etag) - 1);
+            if (job_fd >= 0 && compress_pool_submit(&job))
+            {
+                client_detach_connection();
+                return 0;
+            }
+            if (job_fd >= 0)
+                close(job_fd);
         }
     }
+    else if (use_gzip && is_compressible_mime(mime) && file_size > CACHE_MAX_FILE_SIZE &&
+             compress_pool_enabled())
+    {
+        /* HEAD: the headers the GET above would get from the pool */
+        compress_job_t job = {client_fd, -1, file_size, mime, "", meta.mtime, meta.cache_control};
+        strncpy(job.etag, meta.gzip_etag, sizeof(job.etag) - 1);
+        return compress_pool_send_head(&job, keep_alive);
+    }
+
+    /* HEAD, or too large to cache: identity headers and streamed body */
+    response_headers_t h = {0};
+    h.mime = mime;
+    h.length = file_size;
+    h.keep_alive = keep_alive;
+    h.vary_encoding = meta.has_gzip_sidecar || is_compressible_mime(mime);
+    h.etag = meta.etag;
+    h.last_modified = meta.mtime;
+    h.cache_control = meta.cache_control;
+    send_200_headers(client_fd, &h);
 
-    off_t file_size = st.st_size;
-    const char *mime = get_mime_type(request_path);
+    if (strcmp(method, "HEAD") == 0)
+        return 0;
+
+    return stream_file_fd(client_fd, fd, 0, file_size);
+}
+
+/* Serve a file opened beneath the content root, keyed in the caches by
+   its absolute path. Takes over the caller's reference to file. */
+static int serve_file_cached(int client_fd, fd_handle_t *file, const char *method, bool keep_alive,
+                             const char *request_buf)
+{
+    const char *root = content_root_path();
+    size_t root_len = strlen(root);
+
+    int ret = -1;
+    char *file_path = path_buffer();
+    if (file_path &&
+        snprintf(file_path, PATH_MAX, "%s%s%s", root, root_len > 0 && root[root_len - 1] == '/' ? "" : "/",
+                 file->path) < PATH_MAX)
+        ret = serve_open_file(client_fd, file->fd, &file->st, file_path, method, keep_alive, request_buf);
+    else
+        send_404(client_fd);
 
-    off_t range_start = 0, range_end = file_size - 1;
-    int has_range = parse_range_header(request_buf, file_size, &range_start, &range_end);
+    fd_cache_release(file);
+    return ret;
+}
 
-    if (!has_range)
+/* Helper: Find the bundle entry for a request path, applying the same
+   fallbacks as the filesystem modes: "dir/" -> "dir/index.html" and
+   "/page" -> "/page.html" */
+static const bundle_entry_t *find_bundle_entry(const bundle_t *bundle, const char *path)
+{
+    const bundle_entry_t *entry = bundle_find(bundle, path);
+    if (entry)
+        return entry;
+
+    char *alt = path_buffer();
+    if (!alt)
+        return NULL;
+
+    size_t plen = strlen(path);
+    const char *last = strrchr(path, '/');
+    if (plen > 0 && path[plen - 1] == '/')
     {
-        if (check_and_serve_cache(client_fd, file_path, method, mime, keep_alive) == 0)
-            return 0;
+        if (snprintf(alt, PATH_MAX, "%sindex.html", path) < PATH_MAX)
+            return bundle_find(bundle, alt);
     }
+    else if (!strchr(last ? last : path, '.'))
+    {
+        if (snprintf(alt, PATH_MAX, "%s.html", path) < PATH_MAX)
+            return bundle_find(bundle, alt);
+    }
+    return NULL;
+}
 
-    int fd = open(file_path, O_RDONLY);
-    if (fd < 0)
-        return -1;
+/* Serve a request from the mmapped content bundle: an index lookup and a
+   send, with no filesystem access */
+static void serve_from_bundle(int client_fd, const char *method, const char *path, bool show_ext,
+                              bool keep_alive, const char *request_buf)
+{
+    if (show_ext && strcmp(path, "/") == 0)
+    {
+        send_301_location(client_fd, "/index.html");
+        return;
+    }
+
+    bundle_t *bundle = bundle_acquire();
+    const bundle_entry_t *entry = bundle ? find_bundle_entry(bundle, path) : NULL;
+    if (!entry)
+    {
+        send_404(client_fd);
+        bundle_release(bundle);
+        return;
+    }
 
-    if (has_range)
-        return handle_range_request(client_fd, fd, mime, range_start, range_end, file_size, method);
+    const char *etag = bundle_string(bundle, entry->etag);
+    char gzip_etag[72];
+    make_gzip_etag(etag, gzip_etag, sizeof(gzip_etag));
+    const char *cache_control = bundle_cache_control(bundle, entry);
+    if (answer_not_modified(client_fd, request_buf, etag, gzip_etag, (time_t)entry->mtime, cache_control))
+    {
+        bundle_release(bundle);
+        return;
+    }
 
-    if (keep_alive)
-        send_200_header_keepalive(client_fd, mime, file_size);
-    else
-        send_200_header(client_fd, mime, file_size);
+    response_headers_t h = {0};
+    h.mime = bundle_string(bundle, entry->mime);
+    h.keep_alive = keep_alive;
+    h.etag = etag;
+    h.last_modified = (time_t)entry->mtime;
+    h.cache_control = cache_control;
+    h.vary_encoding = entry->gzip_size > 0 || is_compressible_mime(h.mime);
+
+    const char *payload = bundle_payload(bundle, entry->data_offset);
+    off_t data_size = (off_t)entry->data_size;
+    byte_range_t ranges[MAX_BYTE_RANGES];
+    int range_count = 0;
+    if (if_range_matches(request_buf, etag, (time_t)entry->mtime))
+        range_count = parse_range_header(request_buf, data_size, ranges, MAX_BYTE_RANGES);
+    if (range_count != 0)
+    {
+        if (range_count < 0)
+            send_416(client_fd, data_size);
+        else
+            send_ranges(client_fd, &h, ranges, range_count, data_size, payload, -1,
+                        strcmp(method, "HEAD") == 0);
+        bundle_release(bundle);
+        return;
+    }
 
-    if (strcmp(method, "HEAD") == 0)
+    h.length = (off_t)entry->data_size;
+    if (entry->gzip_size > 0 && get_accepts_gzip(request_buf))
     {
-        close(fd);
-        return 0;
+        payload = bundle_payload(bundle, entry->gzip_offset);
+        h.length = (off_t)entry->gzip_size;
+        h.content_encoding = "gzip";
+        h.etag = gzip_etag;
     }
 
-    int ret = serve_or_cache_file(client_fd, fd, file_path, mime, file_size, keep_alive);
-    close(fd);
-    return ret;
+    send_200_headers(client_fd, &h);
+    if (strcmp(method, "HEAD") != 0)
+        write_buffer_fully(client_fd, payload, h.length);
+    bundle_release(bundle);
+}
+
+/* Helper: Whether a decoded path has a ".." segment. Names that merely
+   contain two dots ("a..b.txt") are fine; the root fd catches the rest. */
+static bool has_parent_segment(const char *path)
+{
+    for (const char *p = strstr(path, ".."); p; p = strstr(p + 1, ".."))
+    {
+        bool starts = p == path || p[-1] == '/';
+        bool ends = p[2] == '\0' || p[2] == '/';
+        if (starts && ends)
+            return true;
+    }
+    return false;
 }
 
-/* Helper: Validate initial request */
 static int validate_request(char *method, char *path)
 {
     if (strcmp(method, "GET") != 0 && strcmp(method, "HEAD") != 0)
         return 1;
 
-    if (strstr(path, ".."))
-        return 1;
-
     if (url_decode(path) != 0)
         return 1;
 
-    if (path[0] != '/')
+    if (path[0] != '/' || has_parent_segment(path))
         return 1;
 
     return 0;
@@ -394,14 +797,19 @@ static void handle_invalid_method(int client_fd, const char *client_ip, const ch
         "Allow: GET, HEAD\r\n"
         "Content-Length: 0\r\n"
         "\r\n";
-    write(client_fd, not_impl, strlen(not_impl));
+    send_response_header(client_fd, 405, not_impl, strlen(not_impl));
     access_log_request(client_ip, method, path, "HTTP/1.1", 405, 0, NULL, NULL);
 }
 
-void handle_http_request(int client_fd, const char *client_ip, const char *content_directory, bool show_ext)
+/* Route one request. Request-scoped memory comes from the thread's
+   arena, which the caller resets once the response is sent. */
+static void route_request(int client_fd, const char *client_ip, const char *content_directory, bool show_ext,
+                          arena_t *arena)
 {
-    char buffer[16384];
-    ssize_t bytes_read = read(client_fd, buffer, sizeof(buffer) - 1);
+    char *buffer = arena_alloc(arena, REQUEST_BUFFER_SIZE);
+    if (!buffer)
+        return;
+    ssize_t bytes_read = read(client_fd, buffer, REQUEST_BUFFER_SIZE - 1);
     if (bytes_read <= 0)
         return;
     buffer[bytes_read] = '\0';
@@ -409,9 +817,11 @@ void handle_http_request(int client_fd, const char *client_ip, const char *conte
     char method[16] = {0}, path[1024] = {0};
     if (sscanf(buffer, "%15s %1023s", method, path) != 2)
         return;
+    PROBE3(request__parsed, client_fd, method, path);
+    response_info_set_path(path);
 
-    if (get_whitelist_enabled())
-        handle_whitelist(client_fd, client_ip, method, path);
+    if (get_whitelist_enabled() && !handle_whitelist(client_fd, client_ip, method, path))
+        return;
 
     if (strcmp(path, "/health") == 0 || strcmp(path, "/status") == 0)
     {
@@ -419,6 +829,18 @@ void handle_http_request(int client_fd, const char *client_ip, const char *conte
         return;
     }
 
+    if (strcmp(path, "/status/top") == 0)
+    {
+        handle_status_top(client_fd, client_ip, method, path);
+        return;
+    }
+
+    if (strcmp(path, "/admin/warmup") == 0)
+    {
+        handle_warmup_request(client_fd, client_ip, method, path, content_directory);
+        return;
+    }
+
     if (strcmp(method, "GET") != 0 && strcmp(method, "HEAD") != 0)
     {
         handle_invalid_method(client_fd, client_ip, method, path);
@@ -430,19 +852,31 @@ void handle_http_request(int client_fd, const char *client_ip, const char *conte
 
     if (validate_request(method, path) != 0)
     {
-        if (strstr(path, "..") || path[0] != '/')
+        if (path[0] != '/' || has_parent_segment(path))
             send_403(client_fd);
         else
             send_404(client_fd);
         return;
     }
 
-    char abs_content[PATH_MAX];
-    if (!realpath(content_directory, abs_content))
+    if (bundle_enabled())
+    {
+        serve_from_bundle(client_fd, method, path, show_ext, keep_alive, buffer);
         return;
+    }
 
     if (show_ext)
-        show_ext_mode(client_fd, content_directory, method, path, keep_alive, buffer, abs_content);
+        show_ext_mode(client_fd, method, path, keep_alive, buffer);
     else
-        hide_ext_mode(client_fd, content_directory, method, path, keep_alive, buffer, abs_content);
-}
\ No newline at end of file
+        hide_ext_mode(client_fd, method, path, keep_alive, buffer);
+}
+
+void handle_http_request(int client_fd, const char *client_ip, const char *content_directory, bool show_ext)
+{
+    arena_t *arena = request_arena();
+    if (!arena)
+        return;
+
+    route_request(client_fd, client_ip, content_directory, show_ext, arena);
+    arena_reset(arena);
+}
@@ -0,0 +1,24 @@
+/* Admission control: shed load with a fast 503 before work is queued */
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Configure shedding thresholds. max_queue_depth <= 0 sheds only when the
+   queue is full; target_wait_ms <= 0 disables the queue wait check. */
+void admission_init(int max_queue_depth, int target_wait_ms, int interval_ms, int retry_after_seconds);
+
+/* Feed the time a work item spent queued (called by workers on dequeue).
+   Once every dequeue for a whole interval waited longer than the target,
+   the server is considered overloaded until a dequeue comes in under it,
+   the queue drains, or an interval passes without a slow dequeue. */
+void admission_record_wait(uint64_t wait_us, uint64_t now_us);
+
+/* Decide whether a new connection should be shed given the current queue depth */
+bool admission_should_shed(int queue_depth);
+
+/* Answer with the pre-rendered 503 + Retry-After and close the connection */
+void admission_reject(int client_fd);
+
+#endif
@@ -0,0 +1,34 @@
+/* Bump arena for request-scoped memory */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (128 * 1024) /* Base block: a whole request fits without malloc */
+
+typedef struct arena arena_t;
+
+/* A position to rewind to; everything allocated after it is released */
+typedef struct
+{
+    void *block;
+    size_t used;
+} arena_mark_t;
+
+/* The calling thread's arena, created on first use and freed when the
+   thread exits. NULL only if it could not be allocated. */
+arena_t *request_arena(void);
+
+/* 16-byte aligned memory that lives until the arena is rewound or reset.
+   Requests that do not fit the current block get an overflow block from
+   malloc, released again on rewind/reset. Returns NULL (also for a NULL
+   arena) when out of memory. */
+void *arena_alloc(arena_t *arena, size_t size);
+
+arena_mark_t arena_mark(const arena_t *arena);
+void arena_rewind(arena_t *arena, arena_mark_t mark);
+
+/* Release everything: the base block is kept, overflow blocks are freed */
+void arena_reset(arena_t *arena);
+
+#endif
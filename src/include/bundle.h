@@ -0,0 +1,67 @@
+/* Content bundle: a whole content directory packed into one indexed file
+   that the server mmaps and serves from without touching the filesystem.
+   Built by the mkbundle tool (tools/mkbundle.c). */
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BUNDLE_MAGIC "HSBUNDL1"
+#define BUNDLE_VERSION 1
+#define BUNDLE_ALIGN 4096 /* Payloads start on page boundaries */
+
+/* On-disk layout, host byte order:
+   header | entry index (sorted by path) | string table | payloads */
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t index_offset;   /* bundle_entry_t[entry_count] */
+    uint64_t strings_offset; /* NUL-terminated strings referenced by entries */
+    uint64_t strings_size;
+    uint64_t total_size;
+} bundle_header_t;
+
+typedef struct
+{
+    uint32_t path; /* String table offsets: request path ("/css/site.css"), */
+    uint32_t mime; /* Content-Type, */
+    uint32_t etag; /* and quoted strong ETag */
+    uint32_t reserved;
+    int64_t mtime;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint64_t gzip_offset;
+    uint64_t gzip_size; /* 0 = no gzip variant */
+} bundle_entry_t;
+
+typedef struct bundle bundle_t;
+
+/* Map the bundle at path. Returns 0 on success. Once open, a watcher
+   thread checks path every second and switches to a file renamed over it. */
+int bundle_open(const char *path);
+
+/* True when the server is serving from a bundle */
+bool bundle_enabled(void);
+
+/* Take a reference to the current bundle, without a lock or a syscall.
+   Release with bundle_release(). */
+bundle_t *bundle_acquire(void);
+void bundle_release(bundle_t *bundle);
+
+/* Binary search the index for a request path. Returns NULL if absent. */
+const bundle_entry_t *bundle_find(const bundle_t *bundle, const char *path);
+
+/* Cache-Control policy for an entry, resolved once when the bundle was mapped */
+const char *bundle_cache_control(const bundle_t *bundle, const bundle_entry_t *entry);
+
+/* Resolve an entry's string or payload within the mapping */
+const char *bundle_string(const bundle_t *bundle, uint32_t offset);
+const char *bundle_payload(const bundle_t *bundle, uint64_t offset);
+
+/* Stop the watcher and unmap the bundle (at shutdown) */
+void bundle_close(void);
+
+#endif
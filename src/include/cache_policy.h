@@ -0,0 +1,18 @@
+/* Cache-Control policies: immutable caching for fingerprinted assets and
+   per-glob policies for everything else */
+#ifndef CACHE_POLICY_H
+#define CACHE_POLICY_H
+
+#define CACHE_CONTROL_IMMUTABLE "public, max-age=31536000, immutable"
+
+/* Load the policy configuration. content_directory anchors the
+   content-relative paths that manifests and globs refer to. */
+void cache_policy_init(const char *content_directory);
+
+/* Resolve the Cache-Control value for a file (an absolute path under the
+   content directory, or a request path starting with '/'). Returns NULL
+   when no policy applies. The string lives for the life of the server,
+   so callers resolve once and keep the pointer. */
+const char *cache_policy_resolve(const char *path);
+
+#endif
@@ -4,7 +4,11 @@
 
 #include <time.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include "compat.h"
+#include "threadpool.h"
+#include "mime.h"
+#include "topk.h"
 
 #define CACHE_MAX_ENTRIES 32
 #define CACHE_MAX_FILE_SIZE (64 * 1024) // 64KB max cached file size
@@ -14,40 +18,101 @@ typedef struct
     char path[PATH_MAX];
     char *data;
     size_t size;
+    char *gzip_data; /* gzip-encoded variant, NULL if not compressible */
+    size_t gzip_size;
     const char *mime_type;
     time_t mtime;
     time_t cached_at;
+    atomic_int refs;
 } cache_entry_t;
 
+/* An inclusive byte range of a representation */
+typedef struct
+{
+    off_t start;
+    off_t end;
+} byte_range_t;
+
+#define MAX_BYTE_RANGES 16 /* More ranges than this and the whole file is sent */
+
+/* Headers for a 200 (or 206) response */
+typedef struct
+{
+    const char *mime;
+    off_t length;
+    bool keep_alive;
+    const char *content_encoding; /* e.g. "gzip"; NULL for identity */
+    bool vary_encoding;           /* Add Vary: Accept-Encoding (compressible types) */
+    const char *etag;             /* Quoted entity tag, or NULL */
+    time_t last_modified;         /* Last-Modified; 0 to omit */
+    const char *cache_control;    /* Cache-Control value, or NULL */
+} response_headers_t;
+
+/* What has been sent for the request this thread is serving */
+typedef struct
+{
+    int status;  /* Status of the response, 0 until its header is sent */
+    off_t bytes; /* Header and body bytes written so far */
+    char path[TOPK_KEY_MAX]; /* Decoded request path minus query, "" until parsed */
+} response_info_t;
+
+void response_info_reset(void);
+void response_info_set_path(const char *path);
+const response_info_t *response_info(void);
+
 void run_server_loop(int server_fd, const char *content_directory, const bool show_ext);
 
 /* Handle an accepted client connection */
 void handle_accepted_client(int client_fd, struct sockaddr_in client_addr,
                             const char *content_directory, const bool show_ext);
 
-/* Forward declaration for thread pool */
-typedef struct threadpool threadpool_t;
+/* Result of serving one request on a pooled connection */
+#define CLIENT_CONN_CLOSE 0 /* Connection finished, close it */
+#define CLIENT_CONN_READY 1 /* Next request already buffered, run again */
+#define CLIENT_CONN_IDLE 2  /* Keep-alive, wait for the socket to become readable */
+#define CLIENT_CONN_DETACHED 3 /* Another thread took over the fd; do not touch it */
+
+/* Per-request connection handling used by the thread pool scheduler */
+bool client_connection_open(work_item_t *work);
+int client_serve_next_request(work_item_t *work);
+void client_connection_close(work_item_t *work);
+
+/* Called while handling a request whose connection was handed to another
+   thread (the compression pool), which will finish and close it */
+void client_detach_connection(void);
 
 /* Run server loop with thread pool */
 void run_server_loop_with_threadpool(int server_fd, const char *content_directory, const bool show_ext, threadpool_t *pool);
 int url_decode(char *s);
+/* Write a response header (or a whole small response) and note its status */
+int send_response_header(int client_fd, int status, const char *buf, size_t len);
 void send_404(int client_fd);
 void send_403(int client_fd);
-void send_304(int client_fd);
-void send_206_header(int client_fd, const char *mime, off_t range_start, off_t range_end, off_t total_size);
+void send_304(int client_fd, const char *etag, time_t last_modified, const char *cache_control);
+void send_206_header(int client_fd, const response_headers_t *h, const byte_range_t *range,
+                     off_t total_size, const char *boundary);
+void send_416(int client_fd, off_t total_size);
 void send_301_location(int client_fd, const char *location);
 void send_200_header(int client_fd, const char *mime, off_t len);
 void send_200_header_keepalive(int client_fd, const char *mime, off_t len);
-const char *get_mime_type(const char *path);
-int stream_file_fd(int client_fd, int fd, off_t filesize);
+int format_200_headers(char *buf, size_t size, const response_headers_t *headers);
+void send_200_headers(int client_fd, const response_headers_t *headers);
+int stream_file_fd(int client_fd, int fd, off_t offset, off_t filesize);
 int join_path(const char *dir, const char *req, char *out, size_t outlen);
 int write_buffer_fully(int client_fd, const char *buf, ssize_t size);
-cache_entry_t *cache_get(const char *path);
-void cache_put(const char *path, const char *data, size_t size, const char *mime_type, time_t mtime);
+cache_entry_t *cache_get(const char *path, time_t mtime);
+void cache_release(cache_entry_t *entry);
+cache_entry_t *cache_put(const char *path, const char *data, size_t size, const char *gzip_data,
+                         size_t gzip_size, const char *mime_type, time_t mtime);
 void cache_init(void);
 
 /* HTTP header parsing helpers */
 int get_if_modified_since(const char *request_buf, time_t *out_time);
-int parse_range_header(const char *request_buf, off_t file_size, off_t *out_start, off_t *out_end);
+int check_if_none_match(const char *request_buf, const char *etag, const char *gzip_etag);
+void format_http_date(time_t t, char *out, size_t len);
+void make_gzip_etag(const char *etag, char *out, size_t len);
+int get_accepts_gzip(const char *request_buf);
+int parse_range_header(const char *request_buf, off_t file_size, byte_range_t *ranges, int max_ranges);
+bool if_range_matches(const char *request_buf, const char *etag, time_t mtime);
 
 #endif // CLIENT_H
\ No newline at end of file
@@ -34,8 +34,10 @@ typedef intptr_t ssize_t;
 #define write _write
 #define close _close
 #define open _open
+#define dup _dup
 #define O_RDONLY _O_RDONLY
 #define strcasecmp _stricmp
+#define strncasecmp _strnicmp
 
 /* realpath -> _fullpath on Windows */
 #ifndef realpath
@@ -154,9 +156,28 @@ static inline char *strptime(const char *buf, const char *fmt, struct tm *tm) {
     return (char *)buf + strlen(buf);
 }
 
+/* pread by seek-then-read: not atomic, so a descriptor read this way
+   must not be shared between threads */
+static inline ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+    if (_lseeki64(fd, offset, SEEK_SET) < 0)
+        return -1;
+    return _read(fd, buf, (unsigned int)count);
+}
+
+/* strcasestr is a GNU extension; provide it for header lookups */
+static inline char *strcasestr(const char *haystack, const char *needle) {
+    size_t n = strlen(needle);
+    for (; *haystack; haystack++) {
+        if (_strnicmp(haystack, needle, n) == 0)
+            return (char *)haystack;
+    }
+    return NULL;
+}
+
 /* Signal handling stubs for Windows (signals work differently) */
 #define SIGTERM 15
 #define SIGINT 2
+#define SIGPIPE 13 /* No such signal on Windows; sigaction() ignores it */
 
 struct sigaction {
     void (*sa_handler)(int);
@@ -239,6 +260,7 @@ static inline int getrusage(int who, struct rusage *usage) {
 /* sockets for POSIX */
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 
 #ifdef __APPLE__
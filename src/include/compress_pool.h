@@ -0,0 +1,40 @@
+/* Compression pool: streams large compressible files as chunked gzip on
+   dedicated threads so deflate cannot starve the request workers */
+#ifndef COMPRESS_POOL_H
+#define COMPRESS_POOL_H
+
+#include <stdbool.h>
+#include <time.h>
+#include "compat.h"
+
+/* One response to compress. The pool takes ownership of both fds and
+   closes them when the response is finished. */
+typedef struct
+{
+    int client_fd;
+    int file_fd;
+    off_t size;
+    const char *mime; /* Static string from get_mime_type() */
+    char etag[112];   /* ETag of the gzip representation */
+    time_t last_modified;
+    const char *cache_control; /* Resolved policy (lives for the server's life), or NULL */
+} compress_job_t;
+
+/* Start num_threads compression threads with room for queue_size waiting
+   jobs. num_threads <= 0 disables streaming compression. */
+void compress_pool_init(int num_threads, int queue_size);
+
+bool compress_pool_enabled(void);
+
+/* Answer a HEAD with the headers the same GET gets from the pool (the
+   job's file_fd is not used) */
+int compress_pool_send_head(const compress_job_t *job, bool keep_alive);
+
+/* Hand a job to the pool. Returns false if the pool is disabled or
+   saturated; the caller still owns the fds and should serve identity. */
+bool compress_pool_submit(const compress_job_t *job);
+
+/* Stop the threads after the jobs already queued are sent */
+void compress_pool_shutdown(void);
+
+#endif
@@ -0,0 +1,31 @@
+/* Content root: request paths are opened beneath one directory fd, so a
+   path can never resolve outside it, with no check-then-open gap */
+#ifndef CONTENT_ROOT_H
+#define CONTENT_ROOT_H
+
+#include "compat.h"
+
+/* Open the content directory once at startup. Returns 0, or -1 after
+   logging if it cannot be opened. */
+int content_root_open(const char *directory);
+
+/* Absolute path of the root (no trailing '/'), for building cache keys */
+const char *content_root_path(void);
+
+/* Open rel_path (relative to the root, no leading '/') read-only and
+   fstat it into *st. Uses openat2(RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS)
+   where the kernel has it; elsewhere each component is opened with
+   O_NOFOLLOW, so symlinks are refused rather than followed. Only regular
+   files and directories are opened; a FIFO or device cannot block the
+   caller. Returns an fd, or -1 with errno set: EXDEV or ELOOP when the
+   path would leave the root, ENOENT/ENOTDIR when it does not exist,
+   EACCES for other file types. */
+int content_open(const char *rel_path, struct stat *st);
+
+/* Open an absolute path with content_open() when it lies under the root,
+   otherwise directly (with the same file type check) */
+int content_open_path(const char *path, struct stat *st);
+
+void content_root_close(void);
+
+#endif
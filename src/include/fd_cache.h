@@ -0,0 +1,40 @@
+/* Open file cache: descriptors of served files (with their fstat), shared
+   by concurrent requests so a hot file is not reopened for every request */
+#ifndef FD_CACHE_H
+#define FD_CACHE_H
+
+#include <time.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "compat.h"
+
+#define FD_CACHE_TTL 1 /* Seconds before an entry is reopened, catching replaced files */
+
+typedef struct
+{
+    int fd;         /* Shared: read it only at explicit offsets (pread, sendfile) */
+    struct stat st; /* fstat of fd, current as of the fd_cache_open() that returned it */
+    time_t opened_at;
+    atomic_int refs;
+    char path[];    /* Request path relative to the content root (key) */
+} fd_handle_t;
+
+/* Size the cache; 0 disables it, so every open gets a private handle */
+void fd_cache_init(int entries);
+
+/* Open a request path beneath the content root. Returns a referenced
+   handle for fd_cache_release(), or NULL with errno set as content_open()
+   does. Regular files are kept open for later requests; a cached one is
+   fstat'ed on every use and reopened if its size or mtime has changed
+   (a rewrite in place), so st matches the bytes about to be sent. A
+   file replaced by rename is picked up within FD_CACHE_TTL. */
+fd_handle_t *fd_cache_open(const char *rel_path);
+
+/* Drop a reference; the last one (after eviction) closes the fd */
+void fd_cache_release(fd_handle_t *handle);
+
+/* Close every cached descriptor no request is still using */
+void fd_cache_shutdown(void);
+
+#endif
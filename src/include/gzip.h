@@ -3,7 +3,7 @@
 
 #include <stddef.h>
 
-/* Compress data using gzip
+/* Compress data into the gzip format (RFC 1952) for Content-Encoding: gzip
    Returns malloc'd compressed buffer on success, NULL on failure
    *out_size is set to compressed size */
 char *gzip_compress(const char *data, size_t data_size, size_t *out_size);
@@ -3,5 +3,6 @@
 #define HEALTH_H
 
 void handle_health(int client_fd, const char *client_ip, const char *method, const char *path);
+void handle_status_top(int client_fd, const char *client_ip, const char *method, const char *path);
 
 #endif
\ No newline at end of file
@@ -2,7 +2,16 @@
 #define HTTP_H
 
 #include <stdbool.h>
+#include "client.h"
+#include "path_cache.h"
+
+#define REQUEST_BUFFER_SIZE 16384 /* Request line and headers */
 
 void handle_http_request(int client_fd, const char *client_ip, const char *content_directory, bool show_ext);
 
+/* Read a small file (and its gzip variant: a fresh .gz sidecar, or one
+   compressed here) from fd into the file cache. Returns a referenced entry
+   for cache_release(), or NULL if the file is not cacheable. */
+cache_entry_t *http_cache_file(int fd, const char *file_path, const char *mime, const path_meta_t *meta);
+
 #endif
\ No newline at end of file
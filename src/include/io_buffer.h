@@ -0,0 +1,26 @@
+/* Pool of page-aligned buffers for streaming file and socket I/O */
+#ifndef IO_BUFFER_H
+#define IO_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define IO_BUFFER_DEFAULT_SIZE (128 * 1024)
+#define IO_BUFFER_THREAD_CACHE 4 /* Buffers each thread keeps for itself */
+
+/* Set the buffer size (rounded up to whole pages) and how many free
+   buffers the shared overflow pool keeps; beyond that, released buffers
+   are unmapped. With hugepages, buffers are backed by huge pages where
+   the kernel allows it. Call once, before any buffer is acquired. */
+void io_buffer_pool_init(size_t buffer_size, int pool_size, bool hugepages);
+
+/* A buffer of io_buffer_size() bytes: from the calling thread's free
+   list, then the shared pool, then freshly mapped. NULL if out of memory. */
+void *io_buffer_acquire(void);
+void io_buffer_release(void *buffer);
+size_t io_buffer_size(void);
+
+/* Unmap the shared pool's free buffers (at shutdown) */
+void io_buffer_pool_shutdown(void);
+
+#endif
@@ -2,6 +2,7 @@
 #define METRICS_H
 
 #include <time.h>
+#include <stdbool.h>
 
 typedef struct
 {
@@ -14,6 +15,19 @@ typedef struct
     unsigned long current_memory_bytes;
     unsigned long peak_memory_bytes;
     double total_cpu_time_ms;
+    int queue_depth;
+    int peak_queue_depth;
+    unsigned long total_steals;
+    int workers;
+    unsigned long pool_resizes;
+    unsigned long shed_connections;
+    unsigned long listen_overflows;
+    unsigned long listen_drops;
+    unsigned long slab_allocs;
+    unsigned long slab_recycles;
+    unsigned long slab_chunks;
+    unsigned long fd_cache_hits;
+    unsigned long fd_cache_misses;
 } metrics_t;
 
 /* Initialize metrics */
@@ -31,4 +45,26 @@ unsigned long metrics_get_uptime(void);
 /* Update memory usage stats (called during request processing) */
 void metrics_update_memory(void);
 
+/* Scheduler statistics (lock-free, called from the thread pool hot path) */
+void metrics_record_queue_depth(int depth);
+void metrics_record_steal(void);
+
+/* Record the current worker count; resized is true for adaptive resize events */
+void metrics_record_pool_size(int workers, bool resized);
+
+/* Count a connection rejected with 503 by admission control */
+void metrics_record_shed(void);
+
+/* Slab allocator activity: objects handed out, objects returned for
+   reuse, and chunks taken from malloc */
+void metrics_record_slab_alloc(void);
+void metrics_record_slab_recycle(void);
+void metrics_record_slab_chunk(void);
+
+/* Count an open-file cache lookup that reused (hit) or opened a descriptor */
+void metrics_record_fd_cache(bool hit);
+
+/* Update listen queue overflow/drop counts since startup (Linux, system-wide) */
+void metrics_update_listen_queue(void);
+
 #endif
@@ -0,0 +1,22 @@
+/* MIME type lookup by file extension */
+#ifndef MIME_H
+#define MIME_H
+
+#include <stdbool.h>
+
+#define MIME_EXT_MAX 16 /* Longest extension looked up, plus the terminator */
+
+/* Compile the built-in types plus the configured ones (extension, with or
+   without the dot -> type; these win over built-ins) into a perfect hash.
+   Call once before serving. Returns the number of types, or -1 if the
+   table could not be built (the previous one stays in use). */
+int mime_init(char **extensions, char **types, int count);
+
+/* Content-Type for a path by its extension, case-insensitively
+   (application/octet-stream if unknown) */
+const char *get_mime_type(const char *path);
+
+/* MIME types worth gzipping: text and text-like formats */
+bool is_compressible_mime(const char *mime);
+
+#endif
@@ -0,0 +1,53 @@
+/* Path metadata cache: stat results for served files, revalidated at most
+   once per PATH_CACHE_TTL seconds instead of on every request */
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <stdbool.h>
+#include <time.h>
+#include <limits.h>
+#include <stdint.h>
+#include "compat.h"
+
+#define PATH_CACHE_ENTRIES 512
+#define PATH_CACHE_TTL 1 /* Seconds before an entry is re-stat'ed */
+
+/* Small enough to copy out per request: the path it is keyed by stays
+   in the cache */
+typedef struct
+{
+    off_t size;
+    time_t mtime;
+    ino_t ino;
+    uint64_t mtime_ns;
+    char etag[64];      /* Strong validator from inode, size and mtime (ns) */
+    char gzip_etag[112]; /* Tag of the gzip representation: the file's tag, plus the
+                            sidecar's inode, size and mtime when it has one */
+    const char *cache_control; /* Resolved Cache-Control policy, or NULL */
+    const char *mime;          /* Content-Type by the file's extension */
+    bool has_gzip_sidecar; /* path.gz exists and is at least as new as path */
+    off_t gzip_size;
+    time_t cache_mtime; /* Validates file cache entries: the newer of the file's
+                           and the sidecar's mtime */
+    time_t checked_at;
+} path_meta_t;
+
+/* Look up metadata for a regular file, stat'ing it (and its .gz sidecar,
+   opened beneath the content root like the file)
+   only when the cached entry is missing or older than PATH_CACHE_TTL.
+   Returns 0 and fills *out on success, -1 if it is not a regular file. */
+int path_cache_lookup(const char *path, path_meta_t *out);
+
+/* The same, for a file the caller already has open: st (from fstat)
+   replaces the stat, and a cached entry is only used while it still
+   describes that inode, size and mtime */
+int path_cache_lookup_stat(const char *path, const struct stat *st, path_meta_t *out);
+
+/* A stat's mtime in nanoseconds (whole seconds where that is all the
+   platform keeps) */
+uint64_t stat_mtime_ns(const struct stat *st);
+
+/* Drop all cached metadata */
+void path_cache_clear(void);
+
+#endif
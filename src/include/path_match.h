@@ -0,0 +1,13 @@
+/* Glob matching for content paths (warm-up lists, cache policies) */
+#ifndef PATH_MATCH_H
+#define PATH_MATCH_H
+
+#include <stdbool.h>
+
+/* Match '*' (any run of characters except '/') and '?'. A pattern that
+   contains a '/' is matched against the whole content-relative path
+   (e.g. assets/ followed by *.js); otherwise it is matched against the
+   file name alone. */
+bool path_glob_match(const char *pattern, const char *rel_path);
+
+#endif
@@ -0,0 +1,35 @@
+// probes.h
+#ifndef PROBES_H
+#define PROBES_H
+
+/* USDT (SystemTap/bpftrace) probes on the request lifecycle, provider
+   "httpserver". Built in only with -DENABLE_PROBES=ON, which needs
+   <sys/sdt.h> (systemtap-sdt-dev / systemtap-sdt-devel); each site is
+   then a single nop until a tracer attaches. Otherwise the macros expand
+   to nothing and their arguments are never evaluated.
+
+     conn__accept      fd, client IPv4 address (network order), client port
+     request__parsed   fd, method, path as received
+     cache__hit        fd, file path
+     cache__miss       fd, file path
+     response__header  fd, status, header bytes
+     response__body    fd, status, bytes sent for the whole response
+     conn__close       fd, requests served (-1 if closed by the compression pool)
+
+   For example, a latency histogram per status code. It is keyed by fd,
+   not thread: responses handed to the compression pool finish on one of
+   its threads.
+     bpftrace -e 'usdt:./httpserver:request__parsed { @t[arg0] = nsecs; }
+                  usdt:./httpserver:response__body /@t[arg0]/ {
+                      @us[arg1] = hist((nsecs - @t[arg0]) / 1000); delete(@t[arg0]); }' */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define PROBE2(name, a, b) DTRACE_PROBE2(httpserver, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(httpserver, name, a, b, c)
+#else
+#define PROBE2(name, a, b) ((void)0)
+#define PROBE3(name, a, b, c) ((void)0)
+#endif
+
+#endif // PROBES_H
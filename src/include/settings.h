@@ -3,6 +3,8 @@
 #define SETTINGS_H
 
 #include <stdbool.h>
+#include "socket.h"
+#include "arena.h"
 
 /* Set custom config file path (must be called before any get_* functions) */
 void set_config_path(const char *path);
@@ -14,11 +16,14 @@ const bool get_show_file_extension(); // ✅ correct declaration
 
 /* Whitelist configuration accessors */
 const bool get_whitelist_enabled(void);
-/* Returns a malloc'd array of malloc'd strings. Caller must free via free_whitelist_entries().
-   On return, *out_count is set to the number of entries (may be 0). */
-char **get_whitelist_ips(int *out_count);
-char **get_whitelist_files(int *out_count);
+/* Returns an array allocated from the arena whose strings belong to the
+   loaded config; nothing needs freeing. On return, *out_count is set to the
+   number of entries (may be 0). */
+const char **get_whitelist_ips(arena_t *arena, int *out_count);
+const char **get_whitelist_files(arena_t *arena, int *out_count);
+/* Frees the malloc'd string arrays returned by the other list getters */
 void free_whitelist_entries(char **entries, int count);
+void free_string_array(char **entries, int count);
 
 /* Access logging configuration accessors */
 const char *get_access_log_file(void);
@@ -26,5 +31,58 @@ const bool get_enable_access_logging(void);
 
 /* Thread pool configuration */
 int get_thread_pool_size(void);
+int get_thread_pool_queue_size(void);
+const bool get_thread_pool_adaptive(void);
+int get_thread_pool_min_size(void);
+int get_thread_pool_max_size(void);
+int get_thread_pool_grow_wait_ms(void);
+int get_thread_pool_shrink_idle_seconds(void);
+
+/* Listen backlog (0 or missing = SOMAXCONN) */
+int get_listen_backlog(void);
+
+/* TCP tuning profile from the "socket-options" object */
+void get_socket_options(socket_options_t *out);
+
+/* Load shedding (admission control) configuration */
+int get_load_shed_queue_depth(void);
+int get_load_shed_target_wait_ms(void);
+int get_load_shed_interval_ms(void);
+int get_load_shed_retry_after(void);
+
+/* Pooled I/O buffers for streaming (size in bytes, spare buffers kept) */
+int get_io_buffer_size(void);
+int get_io_buffer_pool_size(void);
+const bool get_io_buffer_hugepages(void);
+
+/* Open file descriptors kept for served files (0 disables the cache) */
+int get_fd_cache_size(void);
+
+/* Busiest paths and clients tracked for /status/top (0 disables it) */
+int get_top_k_size(void);
+
+/* Streaming compression pool (0 threads disables it) */
+int get_compression_threads(void);
+int get_compression_queue_size(void);
+
+/* Packed content bundle to serve instead of the content directory (NULL = none) */
+const char *get_content_bundle(void);
+
+/* Cache-Control policies. get_cache_policies() returns the number of
+   "cache-policies" entries as parallel malloc'd arrays (or 0). */
+const bool get_cache_immutable_hashed(void);
+const char *get_cache_immutable_manifest(void);
+int get_cache_policies(char ***out_patterns, char ***out_values);
+
+/* Extra or overriding MIME types: "mime-types" as parallel malloc'd arrays
+   of extensions and types (or 0), freed via free_string_array() */
+int get_mime_types(char ***out_extensions, char ***out_types);
+
+/* Content warm-up. Patterns are freed via free_string_array();
+   the manifest is NULL when not configured. */
+const bool get_warmup_on_start(void);
+char **get_warmup_patterns(int *out_count);
+const char *get_warmup_manifest(void);
+int get_warmup_threads(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+/* Slab allocator for fixed-size objects (connection state) */
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+#define SLAB_THREAD_CACHE 64 /* Free objects a thread keeps before returning a batch */
+#define SLAB_BATCH 32        /* Objects moved between a thread and the shared list at once */
+#define SLAB_MAX_CACHES 8    /* Slabs that can have per-thread caches at the same time */
+
+typedef struct slab slab_t;
+
+/* Create a slab of object_size objects, carved objects_per_chunk at a time
+   from one malloc. Returns NULL if out of memory. */
+slab_t *slab_create(size_t object_size, int objects_per_chunk);
+
+/* Take an object from the calling thread's free list, refilling it in a
+   batch from the shared list (or a new chunk) when empty. Contents are
+   undefined. Returns NULL only when a new chunk cannot be allocated. */
+void *slab_alloc(slab_t *slab);
+
+/* Return an object; any thread may free an object another allocated */
+void slab_free(slab_t *slab, void *object);
+
+/* Free every chunk. Objects still in use or cached by other threads
+   become invalid, so call this only after those threads are gone. */
+void slab_destroy(slab_t *slab);
+
+#endif
@@ -2,6 +2,25 @@
 #ifndef SOCKET_H
 #define SOCKET_H
 
-int start_server(const char *host, int port);
+#include <stdbool.h>
 
-#endif
\ No newline at end of file
+/* TCP tuning profile from the "socket-options" object in config.json.
+   Zero values leave the system default in place. */
+typedef struct
+{
+    int defer_accept_seconds; /* TCP_DEFER_ACCEPT: wake accept only once data arrives */
+    int fastopen_queue;       /* TCP_FASTOPEN: pending TFO request queue length */
+    bool nodelay;             /* TCP_NODELAY on accepted sockets */
+    int send_buffer;          /* SO_SNDBUF in bytes */
+    int receive_buffer;       /* SO_RCVBUF in bytes */
+    int busy_poll_usec;       /* SO_BUSY_POLL in microseconds */
+} socket_options_t;
+
+/* Create the listening socket. backlog <= 0 means SOMAXCONN.
+   opts may be NULL to keep system defaults. */
+int start_server(const char *host, int port, int backlog, const socket_options_t *opts);
+
+/* Apply the per-connection part of the profile to an accepted socket */
+void socket_apply_client_options(int client_fd);
+
+#endif
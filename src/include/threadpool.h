@@ -2,24 +2,44 @@
 #define THREADPOOL_H
 
 #include <stdbool.h>
+#include <time.h>
 #include "compat.h"
 
 typedef struct threadpool threadpool_t;
 
-/* Work item: a client connection to be handled */
+/* Work item: a client connection with a request ready to be handled.
+   Keep-alive connections are rescheduled once per request. */
 typedef struct
 {
     int client_fd;
     struct sockaddr_in client_addr;
     const char *content_directory;
     bool show_ext;
+    int request_count; /* Requests served so far on this connection */
+    time_t start_time; /* When the connection was first picked up (0 = not yet) */
+    int worker;        /* Worker that last queued/served it, for cache affinity */
+    uint64_t enqueued_at; /* Monotonic microseconds when it was queued */
 } work_item_t;
 
-/* Create a thread pool with num_threads worker threads */
-threadpool_t *threadpool_create(int num_threads);
-
-/* Submit work to the thread pool (enqueue a client connection) */
-void threadpool_submit(threadpool_t *pool, work_item_t work);
+/* Adaptive sizing bounds. The pool grows by one worker when queued work
+   waits longer than grow_wait_ms, and shrinks by one after
+   shrink_idle_seconds with idle workers and an empty queue. */
+typedef struct
+{
+    int min_threads;
+    int max_threads;
+    int grow_wait_ms;
+    int shrink_idle_seconds;
+} threadpool_sizing_t;
+
+/* Create a thread pool with num_threads worker threads and bounded work
+   queues holding queue_size connections in total. Pass sizing (with
+   max_threads > min_threads) to let the pool resize itself, or NULL. */
+threadpool_t *threadpool_create(int num_threads, int queue_size, const threadpool_sizing_t *sizing);
+
+/* Submit work to the thread pool (enqueue a client connection).
+   Returns false if every queue is full; the caller still owns the fd. */
+bool threadpool_submit(threadpool_t *pool, work_item_t work);
 
 /* Shutdown the thread pool and wait for all workers to finish */
 void threadpool_shutdown(threadpool_t *pool);
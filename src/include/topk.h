@@ -0,0 +1,24 @@
+/* Heavy-hitter traffic statistics: the busiest request paths and client
+   IPs, tracked in bounded space with the Space-Saving algorithm, and
+   exact per-status totals. Served as JSON at /status/top, to loopback
+   clients only. */
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <stddef.h>
+#include "compat.h"
+
+#define TOPK_KEY_MAX 256 /* Longer paths are truncated (and share a slot) */
+
+/* Size each table; 0 disables the statistics */
+void topk_init(int entries);
+
+/* Account one finished request */
+void topk_record(const char *path, const char *client_ip, int status, off_t bytes, double latency_ms);
+
+/* The tables as a malloc'd JSON document, busiest first, or NULL */
+char *topk_json(void);
+
+void topk_shutdown(void);
+
+#endif
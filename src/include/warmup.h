@@ -0,0 +1,22 @@
+/* Content warm-up: preload the caches before traffic arrives */
+#ifndef WARMUP_H
+#define WARMUP_H
+
+#include <stdbool.h>
+
+/* Walk content_directory and preload every file named by the manifest or
+   matching the configured globs: path metadata, the file cache (with gzip
+   variants) for small files, and the OS page cache for large ones.
+   Runs on num_threads threads and blocks until done. Returns the number
+   of files warmed, or -1 if a warm-up is already running. */
+int warmup_run(const char *content_directory, int num_threads);
+
+/* Start warmup_run() on a background thread. Returns false if one is
+   already running or the thread could not be created. */
+bool warmup_start_async(const char *content_directory, int num_threads);
+
+/* Admin trigger: POST /admin/warmup from a loopback client */
+void handle_warmup_request(int client_fd, const char *client_ip, const char *method,
+                           const char *path, const char *content_directory);
+
+#endif
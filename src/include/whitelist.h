@@ -5,13 +5,14 @@
 
 /* Check if IP address is in whitelist
    Returns 1 if IP is allowed, 0 if not allowed */
-int is_ip_whitelisted(const char *client_ip, char **whitelist_ips, int count);
+int is_ip_whitelisted(const char *client_ip, const char **whitelist_ips, int count);
 
 /* Check if file path is whitelisted
    Returns 1 if file is allowed, 0 if not allowed */
-int is_file_whitelisted(const char *request_path, char **whitelist_files, int count);
+int is_file_whitelisted(const char *request_path, const char **whitelist_files, int count);
 
-/* Handle whitelist check */
-void handle_whitelist(int client_fd, const char *client_ip, const char *method, const char *path);
+/* Handle whitelist check
+   Returns true if the request may proceed, false after sending a 403 */
+bool handle_whitelist(int client_fd, const char *client_ip, const char *method, const char *path);
 
 #endif
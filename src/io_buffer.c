@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/compat.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "include/io_buffer.h"
+#include "include/logger.h"
+
+#define IO_BUFFER_PAGE 4096
+#define IO_BUFFER_HUGEPAGE (2 * 1024 * 1024)
+#define IO_BUFFER_MAX_SIZE (16 * 1024 * 1024)
+
+static struct
+{
+    size_t buffer_size;
+    bool hugepages;
+    void **free_list; /* Shared overflow pool (a stack) */
+    int capacity;
+    int count;
+    pthread_mutex_t lock;
+} pool = {IO_BUFFER_DEFAULT_SIZE, false, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+
+/* Per-thread free list; drained to the shared pool when the thread exits */
+typedef struct
+{
+    void *buffers[IO_BUFFER_THREAD_CACHE];
+    int count;
+} thread_cache_t;
+
+static _Thread_local thread_cache_t thread_cache;
+static _Thread_local bool thread_cache_registered = false;
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+static void *buffer_map(void)
+{
+#ifdef _WIN32
+    return _aligned_malloc(pool.buffer_size, IO_BUFFER_PAGE);
+#else
+    void *buffer = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    /* Explicit huge pages only fit whole multiples; fall back quietly if
+       none are reserved */
+    if (pool.hugepages && pool.buffer_size % IO_BUFFER_HUGEPAGE == 0)
+        buffer = mmap(NULL, pool.buffer_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (buffer == MAP_FAILED)
+        buffer = mmap(NULL, pool.buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    if (pool.hugepages)
+        madvise(buffer, pool.buffer_size, MADV_HUGEPAGE);
+#endif
+    return buffer;
+#endif
+}
+
+static void buffer_unmap(void *buffer)
+{
+#ifdef _WIN32
+    _aligned_free(buffer);
+#else
+    munmap(buffer, pool.buffer_size);
+#endif
+}
+
+/* Hand a buffer to the shared pool, or unmap it if the pool is full */
+static void pool_put(void *buffer)
+{
+    pthread_mutex_lock(&pool.lock);
+    if (pool.count < pool.capacity)
+    {
+        pool.free_list[pool.count++] = buffer;
+        buffer = NULL;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    if (buffer)
+        buffer_unmap(buffer);
+}
+
+static void thread_cache_drain(void *arg)
+{
+    (void)arg;
+    while (thread_cache.count > 0)
+        pool_put(thread_cache.buffers[--thread_cache.count]);
+}
+
+static void cache_key_create(void)
+{
+    pthread_key_create(&cache_key, thread_cache_drain);
+}
+
+void io_buffer_pool_init(size_t buffer_size, int pool_size, bool hugepages)
+{
+    if (buffer_size < IO_BUFFER_PAGE)
+        buffer_size = IO_BUFFER_PAGE;
+    if (buffer_size > IO_BUFFER_MAX_SIZE)
+        buffer_size = IO_BUFFER_MAX_SIZE;
+    pool.buffer_size = (buffer_size + IO_BUFFER_PAGE - 1) & ~(size_t)(IO_BUFFER_PAGE - 1);
+    pool.hugepages = hugepages;
+
+    pool.capacity = pool_size > 0 ? pool_size : 0;
+    pool.free_list = pool.capacity > 0 ? calloc(pool.capacity, sizeof(void *)) : NULL;
+    if (!pool.free_list)
+        pool.capacity = 0;
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "I/O buffers: %zu KB, %d pooled%s", pool.buffer_size / 1024, pool.capacity,
+             hugepages ? ", huge pages" : "");
+    log_info(msg);
+}
+
+void *io_buffer_acquire(void)
+{
+    if (thread_cache.count > 0)
+        return thread_cache.buffers[--thread_cache.count];
+
+    void *buffer = NULL;
+    pthread_mutex_lock(&pool.lock);
+    if (pool.count > 0)
+        buffer = pool.free_list[--pool.count];
+    pthread_mutex_unlock(&pool.lock);
+
+    return buffer ? buffer : buffer_map();
+}
+
+void io_buffer_release(void *buffer)
+{
+    if (!buffer)
+        return;
+
+    if (thread_cache.count < IO_BUFFER_THREAD_CACHE)
+    {
+        /* The key's destructor returns this thread's buffers when it exits */
+        if (!thread_cache_registered)
+        {
+            pthread_once(&cache_key_once, cache_key_create);
+            pthread_setspecific(cache_key, &thread_cache);
+            thread_cache_registered = true;
+        }
+        thread_cache.buffers[thread_cache.count++] = buffer;
+        return;
+    }
+    pool_put(buffer);
+}
+
+size_t io_buffer_size(void)
+{
+    return pool.buffer_size;
+}
+
+void io_buffer_pool_shutdown(void)
+{
+    pthread_mutex_lock(&pool.lock);
+    while (pool.count > 0)
+        buffer_unmap(pool.free_list[--pool.count]);
+    free(pool.free_list);
+    pool.free_list = NULL;
+    pool.capacity = 0;
+    pthread_mutex_unlock(&pool.lock);
+}
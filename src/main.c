@@ -16,8 +16,18 @@
 #include "include/validator.h"
 #include "include/metrics.h"
 #include "include/shutdown.h"
+#include "include/compress_pool.h"
+#include "include/warmup.h"
+#include "include/bundle.h"
+#include "include/cache_policy.h"
 #include "include/access_log.h"
 #include "include/threadpool.h"
+#include "include/admission.h"
+#include "include/io_buffer.h"
+#include "include/mime.h"
+#include "include/content_root.h"
+#include "include/fd_cache.h"
+#include "include/topk.h"
 
 /* Helper: Process command-line arguments */
 static int process_arguments(int argc, char *argv[])
@@ -78,11 +88,22 @@ int main(int argc, char *argv[])
     /* Initialize file cache */
     cache_init();
 
+    /* Initialize admission control (load shedding) */
+    admission_init(get_load_shed_queue_depth(), get_load_shed_target_wait_ms(),
+                   get_load_shed_interval_ms(), get_load_shed_retry_after());
+
+    /* Size the streaming buffers before anything can use them */
+    io_buffer_pool_init(get_io_buffer_size(), get_io_buffer_pool_size(), get_io_buffer_hugepages());
+
+    /* Start the streaming compression threads */
+    compress_pool_init(get_compression_threads(), get_compression_queue_size());
+
     const char *server_content_directory = get_server_directory();
     int server_port = get_server_port();
     const char *server_host = get_server_host();
     const bool show_file_ext = get_show_file_extension();
     int thread_pool_size = get_thread_pool_size();
+    int thread_pool_queue_size = get_thread_pool_queue_size();
 
     log_info("Server Directory: ");
     log_info(server_content_directory);
@@ -100,12 +121,79 @@ int main(int argc, char *argv[])
     snprintf(thread_msg, sizeof(thread_msg), "Thread Pool Size: %d", thread_pool_size);
     log_info(thread_msg);
 
+    threadpool_sizing_t sizing;
+    const threadpool_sizing_t *pool_sizing = NULL;
+    if (get_thread_pool_adaptive())
+    {
+        sizing.min_threads = get_thread_pool_min_size();
+        sizing.max_threads = get_thread_pool_max_size();
+        if (sizing.min_threads > sizing.max_threads)
+        {
+            char clamp_msg[160];
+            snprintf(clamp_msg, sizeof(clamp_msg),
+                     "thread-pool-min-size %d exceeds thread-pool-max-size %d; clamping it to %d",
+                     sizing.min_threads, sizing.max_threads, sizing.max_threads);
+            log_info(clamp_msg);
+            sizing.min_threads = sizing.max_threads;
+        }
+        sizing.grow_wait_ms = get_thread_pool_grow_wait_ms();
+        sizing.shrink_idle_seconds = get_thread_pool_shrink_idle_seconds();
+
+        if (sizing.min_threads == sizing.max_threads)
+        {
+            /* Nothing to adapt: run a fixed pool of that size */
+            thread_pool_size = sizing.max_threads;
+            snprintf(thread_msg, sizeof(thread_msg), "Thread Pool Mode: FIXED (%d workers)", thread_pool_size);
+        }
+        else
+        {
+            pool_sizing = &sizing;
+            snprintf(thread_msg, sizeof(thread_msg), "Thread Pool Mode: ADAPTIVE (%d-%d workers)",
+                     sizing.min_threads, sizing.max_threads);
+        }
+        log_info(thread_msg);
+    }
+
     log_info("Reminder: When changed file extension mode to hide file extensions, files wit extensions will still work, please clear browser history to have the new version as default.");
 
-    int server_fd = start_server(server_host, server_port);
+    /* Content types: built-ins plus "mime-types", compiled into a perfect hash */
+    char **mime_extensions, **mime_types;
+    int mime_count = get_mime_types(&mime_extensions, &mime_types);
+    int mime_total = mime_init(mime_extensions, mime_types, mime_count);
+    if (mime_count > 0)
+    {
+        free_string_array(mime_extensions, mime_count);
+        free_string_array(mime_types, mime_count);
+    }
+    char mime_msg[64];
+    snprintf(mime_msg, sizeof(mime_msg), "MIME types: %d", mime_total);
+    log_info(mime_msg);
+
+    /* Every request path is opened beneath this one directory fd */
+    if (content_root_open(server_content_directory) != 0)
+        return 1;
+    fd_cache_init(get_fd_cache_size());
+    topk_init(get_top_k_size());
+
+    /* Cache-Control policies are resolved per file as the caches fill */
+    cache_policy_init(server_content_directory);
+
+    /* Serve from a packed bundle instead of the content directory, if configured */
+    const char *content_bundle = get_content_bundle();
+    if (content_bundle && bundle_open(content_bundle) != 0)
+        log_info("Falling back to serving the content directory");
+
+    /* Come up hot: preload the caches before the listener exists */
+    if (get_warmup_on_start() && !bundle_enabled())
+        warmup_run(server_content_directory, get_warmup_threads());
+
+    socket_options_t socket_options;
+    get_socket_options(&socket_options);
+
+    int server_fd = start_server(server_host, server_port, get_listen_backlog(), &socket_options);
 
     /* Create thread pool */
-    threadpool_t *pool = threadpool_create(thread_pool_size);
+    threadpool_t *pool = threadpool_create(thread_pool_size, thread_pool_queue_size, pool_sizing);
     if (!pool)
     {
         log_error_code(18, "Failed to create thread pool");
@@ -119,6 +207,12 @@ int main(int argc, char *argv[])
 
     /* Shutdown thread pool */
     threadpool_shutdown(pool);
+    compress_pool_shutdown();
+    bundle_close();
+    fd_cache_shutdown();
+    topk_shutdown();
+    content_root_close();
+    io_buffer_pool_shutdown();
 
 #ifdef _WIN32
     WSACleanup();
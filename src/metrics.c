@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <stdatomic.h>
 
 #include "include/compat.h"
 #include "include/metrics.h"
@@ -16,6 +18,21 @@ static struct
     unsigned long current_memory_bytes;
     unsigned long peak_memory_bytes;
     double total_cpu_time_ms;
+    _Atomic int queue_depth;
+    _Atomic int peak_queue_depth;
+    _Atomic unsigned long total_steals;
+    _Atomic int workers;
+    _Atomic unsigned long pool_resizes;
+    _Atomic unsigned long shed_connections;
+    _Atomic unsigned long slab_allocs;
+    _Atomic unsigned long slab_recycles;
+    _Atomic unsigned long slab_chunks;
+    _Atomic unsigned long fd_cache_hits;
+    _Atomic unsigned long fd_cache_misses;
+    unsigned long listen_overflows;
+    unsigned long listen_drops;
+    unsigned long listen_overflows_base;
+    unsigned long listen_drops_base;
     pthread_mutex_t lock;
 } metrics = {
     .total_requests = 0,
@@ -28,10 +45,55 @@ static struct
     .peak_memory_bytes = 0,
     .total_cpu_time_ms = 0.0};
 
+/* Read the TcpExt ListenOverflows and ListenDrops counters from
+   /proc/net/netstat. Returns 0 on success. */
+static int read_listen_counters(unsigned long *overflows, unsigned long *drops)
+{
+#ifdef __linux__
+    FILE *file = fopen("/proc/net/netstat", "r");
+    if (!file)
+        return -1;
+
+    /* The file has a "TcpExt:" line of names followed by one of values */
+    char names[4096], values[4096];
+    int found = -1;
+    while (fgets(names, sizeof(names), file))
+    {
+        if (strncmp(names, "TcpExt:", 7) != 0)
+            continue;
+        if (!fgets(values, sizeof(values), file))
+            break;
+
+        char *name_save, *value_save;
+        char *name = strtok_r(names, " \n", &name_save);
+        char *value = strtok_r(values, " \n", &value_save);
+        while (name && value)
+        {
+            if (strcmp(name, "ListenOverflows") == 0)
+                *overflows = strtoul(value, NULL, 10);
+            else if (strcmp(name, "ListenDrops") == 0)
+                *drops = strtoul(value, NULL, 10);
+            name = strtok_r(NULL, " \n", &name_save);
+            value = strtok_r(NULL, " \n", &value_save);
+        }
+        found = 0;
+        break;
+    }
+
+    fclose(file);
+    return found;
+#else
+    (void)overflows;
+    (void)drops;
+    return -1;
+#endif
+}
+
 void metrics_init(void)
 {
     pthread_mutex_init(&metrics.lock, NULL);
     metrics.start_time = time(NULL);
+    read_listen_counters(&metrics.listen_overflows_base, &metrics.listen_drops_base);
 }
 
 void metrics_record_request(size_t bytes_sent, double response_time_ms)
@@ -65,6 +127,19 @@ metrics_t metrics_get(void)
     snapshot.current_memory_bytes = metrics.current_memory_bytes;
     snapshot.peak_memory_bytes = metrics.peak_memory_bytes;
     snapshot.total_cpu_time_ms = metrics.total_cpu_time_ms;
+    snapshot.queue_depth = atomic_load(&metrics.queue_depth);
+    snapshot.peak_queue_depth = atomic_load(&metrics.peak_queue_depth);
+    snapshot.total_steals = atomic_load(&metrics.total_steals);
+    snapshot.workers = atomic_load(&metrics.workers);
+    snapshot.pool_resizes = atomic_load(&metrics.pool_resizes);
+    snapshot.shed_connections = atomic_load(&metrics.shed_connections);
+    snapshot.listen_overflows = metrics.listen_overflows;
+    snapshot.listen_drops = metrics.listen_drops;
+    snapshot.slab_allocs = atomic_load(&metrics.slab_allocs);
+    snapshot.slab_recycles = atomic_load(&metrics.slab_recycles);
+    snapshot.slab_chunks = atomic_load(&metrics.slab_chunks);
+    snapshot.fd_cache_hits = atomic_load(&metrics.fd_cache_hits);
+    snapshot.fd_cache_misses = atomic_load(&metrics.fd_cache_misses);
 
     pthread_mutex_unlock(&metrics.lock);
     return snapshot;
@@ -97,3 +172,63 @@ void metrics_update_memory(void)
 
     pthread_mutex_unlock(&metrics.lock);
 }
+
+void metrics_record_queue_depth(int depth)
+{
+    atomic_store_explicit(&metrics.queue_depth, depth, memory_order_relaxed);
+
+    int peak = atomic_load_explicit(&metrics.peak_queue_depth, memory_order_relaxed);
+    while (depth > peak &&
+           !atomic_compare_exchange_weak_explicit(&metrics.peak_queue_depth, &peak, depth,
+                                                  memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+void metrics_record_steal(void)
+{
+    atomic_fetch_add_explicit(&metrics.total_steals, 1, memory_order_relaxed);
+}
+
+void metrics_record_pool_size(int workers, bool resized)
+{
+    atomic_store(&metrics.workers, workers);
+    if (resized)
+        atomic_fetch_add(&metrics.pool_resizes, 1);
+}
+
+void metrics_record_shed(void)
+{
+    atomic_fetch_add_explicit(&metrics.shed_connections, 1, memory_order_relaxed);
+}
+
+void metrics_record_slab_alloc(void)
+{
+    atomic_fetch_add_explicit(&metrics.slab_allocs, 1, memory_order_relaxed);
+}
+
+void metrics_record_slab_recycle(void)
+{
+    atomic_fetch_add_explicit(&metrics.slab_recycles, 1, memory_order_relaxed);
+}
+
+void metrics_record_slab_chunk(void)
+{
+    atomic_fetch_add_explicit(&metrics.slab_chunks, 1, memory_order_relaxed);
+}
+
+void metrics_record_fd_cache(bool hit)
+{
+    atomic_fetch_add_explicit(hit ? &metrics.fd_cache_hits : &metrics.fd_cache_misses, 1, memory_order_relaxed);
+}
+
+void metrics_update_listen_queue(void)
+{
+    unsigned long overflows = 0, drops = 0;
+    if (read_listen_counters(&overflows, &drops) != 0)
+        return;
+
+    pthread_mutex_lock(&metrics.lock);
+    metrics.listen_overflows = overflows - metrics.listen_overflows_base;
+    metrics.listen_drops = drops - metrics.listen_drops_base;
+    pthread_mutex_unlock(&metrics.lock);
+}
@@ -0,0 +1,290 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "include/mime.h"
+
+#define MIME_DEFAULT "application/octet-stream"
+
+typedef struct
+{
+    const char *ext; /* Lowercase, without the dot */
+    const char *type;
+} mime_entry_t;
+
+static const mime_entry_t builtin_types[] = {
+    {"html", "text/html"},
+    {"htm", "text/html"},
+    {"xhtml", "application/xhtml+xml"},
+    {"css", "text/css"},
+    {"js", "application/javascript"},
+    {"mjs", "application/javascript"},
+    {"cjs", "application/javascript"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"jsonld", "application/ld+json"},
+    {"webmanifest", "application/manifest+json"},
+    {"xml", "application/xml"},
+    {"rss", "application/rss+xml"},
+    {"atom", "application/atom+xml"},
+    {"txt", "text/plain"},
+    {"csv", "text/csv"},
+    {"md", "text/markdown"},
+    {"ics", "text/calendar"},
+    {"vtt", "text/vtt"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"zip", "application/zip"},
+    {"gz", "application/gzip"},
+    {"tar", "application/x-tar"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"svg", "image/svg+xml"},
+    {"ico", "image/x-icon"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"bmp", "image/bmp"},
+    {"tif", "image/tiff"},
+    {"tiff", "image/tiff"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"otf", "font/otf"},
+    {"eot", "application/vnd.ms-fontobject"},
+    {"mp4", "video/mp4"},
+    {"m4v", "video/mp4"},
+    {"webm", "video/webm"},
+    {"ogv", "video/ogg"},
+    {"mov", "video/quicktime"},
+    {"ts", "video/mp2t"},
+    {"m3u8", "application/vnd.apple.mpegurl"},
+    {"mpd", "application/dash+xml"},
+    {"mp3", "audio/mpeg"},
+    {"m4a", "audio/mp4"},
+    {"aac", "audio/aac"},
+    {"ogg", "audio/ogg"},
+    {"oga", "audio/ogg"},
+    {"opus", "audio/opus"},
+    {"wav", "audio/wav"},
+    {"flac", "audio/flac"},
+};
+
+/* Perfect hash (hash and displace): an extension picks a bucket with
+   seed 0, and the bucket's displacement is the seed that sends each of
+   its keys to a distinct slot. A lookup is two hashes and one compare. */
+static struct
+{
+    mime_entry_t *slots; /* ext NULL = empty */
+    uint32_t *displacement;
+    uint32_t slot_mask;
+    uint32_t bucket_mask;
+    int count;
+} table;
+
+/* FNV-1a, seeded */
+static uint32_t hash_ext(const char *ext, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (const unsigned char *p = (const unsigned char *)ext; *p; p++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    return h;
+}
+
+static uint32_t round_up_pow2(uint32_t n)
+{
+    uint32_t p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+/* Build the slot table for a set of unique entries. Returns 0 on success. */
+static int build_table(const mime_entry_t *entries, int count)
+{
+    uint32_t bucket_count = round_up_pow2((uint32_t)(count + 1) / 2);
+    uint32_t slot_count = round_up_pow2((uint32_t)count * 2);
+
+    mime_entry_t *slots = calloc(slot_count, sizeof(mime_entry_t));
+    uint32_t *displacement = calloc(bucket_count, sizeof(uint32_t));
+    int *bucket_of = malloc(count * sizeof(int));
+    uint32_t *order = malloc(bucket_count * sizeof(uint32_t));
+    int *bucket_size = calloc(bucket_count, sizeof(int));
+    uint32_t *pending = malloc(count * sizeof(uint32_t));
+    if (!slots || !displacement || !bucket_of || !order || !bucket_size || !pending)
+        goto fail;
+
+    for (int i = 0; i < count; i++)
+    {
+        bucket_of[i] = (int)(hash_ext(entries[i].ext, 0) & (bucket_count - 1));
+        bucket_size[bucket_of[i]]++;
+    }
+
+    /* Place the largest buckets first, while the table is emptiest */
+    for (uint32_t b = 0; b < bucket_count; b++)
+        order[b] = b;
+    for (uint32_t i = 1; i < bucket_count; i++)
+    {
+        uint32_t b = order[i];
+        uint32_t j = i;
+        while (j > 0 && bucket_size[order[j - 1]] < bucket_size[b])
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = b;
+    }
+
+    for (uint32_t i = 0; i < bucket_count && bucket_size[order[i]] > 0; i++)
+    {
+        uint32_t b = order[i];
+        bool placed = false;
+        for (uint32_t d = 1; d < (1u << 20) && !placed; d++)
+        {
+            int n = 0;
+            placed = true;
+            for (int k = 0; k < count && placed; k++)
+            {
+                if (bucket_of[k] != (int)b)
+                    continue;
+                uint32_t slot = hash_ext(entries[k].ext, d) & (slot_count - 1);
+                if (slots[slot].ext)
+                    placed = false;
+                for (int j = 0; j < n && placed; j++)
+                    placed = pending[j] != slot;
+                pending[n++] = slot;
+            }
+            if (!placed)
+                continue;
+
+            n = 0;
+            for (int k = 0; k < count; k++)
+            {
+                if (bucket_of[k] == (int)b)
+                    slots[pending[n++]] = entries[k];
+            }
+            displacement[b] = d;
+        }
+        if (!placed)
+            goto fail;
+    }
+
+    free(table.slots);
+    free(table.displacement);
+    table.slots = slots;
+    table.displacement = displacement;
+    table.slot_mask = slot_count - 1;
+    table.bucket_mask = bucket_count - 1;
+    table.count = count;
+    free(bucket_of);
+    free(order);
+    free(bucket_size);
+    free(pending);
+    return 0;
+
+fail:
+    free(slots);
+    free(displacement);
+    free(bucket_of);
+    free(order);
+    free(bucket_size);
+    free(pending);
+    return -1;
+}
+
+/* Lowercase an extension (without its dot) into buf; false if it is too
+   long to be a known type */
+static bool lower_ext(const char *ext, char *buf, size_t size)
+{
+    size_t len = strlen(ext);
+    if (len == 0 || len >= size)
+        return false;
+    for (size_t i = 0; i <= len; i++)
+        buf[i] = (char)tolower((unsigned char)ext[i]);
+    return true;
+}
+
+int mime_init(char **extensions, char **types, int count)
+{
+    int builtin_count = (int)(sizeof(builtin_types) / sizeof(builtin_types[0]));
+    mime_entry_t *entries = malloc((builtin_count + count) * sizeof(mime_entry_t));
+    if (!entries)
+        return -1;
+    memcpy(entries, builtin_types, sizeof(builtin_types));
+    int total = builtin_count;
+
+    /* Configured types replace a built-in for the same extension */
+    for (int i = 0; i < count; i++)
+    {
+        char ext[MIME_EXT_MAX];
+        const char *name = extensions[i][0] == '.' ? extensions[i] + 1 : extensions[i];
+        if (!types[i] || !types[i][0] || !lower_ext(name, ext, sizeof(ext)))
+            continue;
+
+        /* The table lives for the whole process */
+        char *ext_copy = strdup(ext);
+        char *type_copy = strdup(types[i]);
+        if (!ext_copy || !type_copy)
+        {
+            free(ext_copy);
+            free(type_copy);
+            continue;
+        }
+
+        int j = 0;
+        while (j < total && strcmp(entries[j].ext, ext_copy) != 0)
+            j++;
+        entries[j].ext = ext_copy;
+        entries[j].type = type_copy;
+        if (j == total)
+            total++;
+    }
+
+    int ret = build_table(entries, total);
+    free(entries);
+    return ret == 0 ? total : -1;
+}
+
+const char *get_mime_type(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    const char *slash = strrchr(path, '/');
+    if (!ext || (slash && slash > ext))
+        return MIME_DEFAULT;
+
+    char key[MIME_EXT_MAX];
+    if (!lower_ext(ext + 1, key, sizeof(key)))
+        return MIME_DEFAULT;
+
+    /* Built-in types until mime_init() has run (tools that never call it) */
+    if (!table.slots && mime_init(NULL, NULL, 0) < 0)
+        return MIME_DEFAULT;
+
+    uint32_t d = table.displacement[hash_ext(key, 0) & table.bucket_mask];
+    const mime_entry_t *slot = &table.slots[hash_ext(key, d) & table.slot_mask];
+    return slot->ext && strcmp(slot->ext, key) == 0 ? slot->type : MIME_DEFAULT;
+}
+
+/* MIME types worth gzipping: text and text-like formats */
+bool is_compressible_mime(const char *mime)
+{
+    if (strncmp(mime, "text/", 5) == 0)
+        return true;
+
+    /* Structured syntax suffixes: image/svg+xml, application/ld+json, ... */
+    const char *plus = strchr(mime, '+');
+    if (plus && (strcmp(plus, "+xml") == 0 || strcmp(plus, "+json") == 0))
+        return true;
+
+    return strcmp(mime, "application/javascript") == 0 ||
+           strcmp(mime, "application/json") == 0 ||
+           strcmp(mime, "application/xml") == 0 ||
+           strcmp(mime, "application/wasm") == 0 ||
+           strcmp(mime, "application/vnd.apple.mpegurl") == 0;
+}
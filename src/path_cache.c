@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "include/compat.h"
+#include "include/path_cache.h"
+#include "include/client.h"
+#include "include/cache_policy.h"
+#include "include/mime.h"
+#include "include/content_root.h"
+
+/* Direct-mapped table: a path hashes to one slot and replaces whatever
+   was there, which keeps lookups O(1) and memory bounded */
+typedef struct
+{
+    char path[PATH_MAX]; /* Resolved file path (key) */
+    path_meta_t meta;
+} path_slot_t;
+
+static path_slot_t entries[PATH_CACHE_ENTRIES];
+static pthread_mutex_t path_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* FNV-1a */
+static uint32_t hash_path(const char *path)
+{
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Nanosecond mtime catches rewrites within the same second */
+uint64_t stat_mtime_ns(const struct stat *st)
+{
+#if defined(__APPLE__)
+    return (uint64_t)st->st_mtimespec.tv_sec * 1000000000u + st->st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    return (uint64_t)st->st_mtime * 1000000000u;
+#else
+    return (uint64_t)st->st_mtim.tv_sec * 1000000000u + st->st_mtim.tv_nsec;
+#endif
+}
+
+/* Fill a fresh entry from the file's stat, stat'ing its precompressed sidecar */
+static void load_meta(const char *path, const struct stat *st, path_meta_t *meta)
+{
+    memset(meta, 0, sizeof(*meta));
+    meta->size = st->st_size;
+    meta->mtime = st->st_mtime;
+    meta->ino = st->st_ino;
+
+    meta->mtime_ns = stat_mtime_ns(st);
+    snprintf(meta->etag, sizeof(meta->etag), "\"%jx-%jx-%jx\"",
+             (uintmax_t)st->st_ino, (uintmax_t)st->st_size, (uintmax_t)meta->mtime_ns);
+    make_gzip_etag(meta->etag, meta->gzip_etag, sizeof(meta->gzip_etag));
+    meta->cache_control = cache_policy_resolve(path);
+    meta->mime = get_mime_type(path);
+
+    meta->cache_mtime = meta->mtime;
+
+    /* The sidecar resolves beneath the content root like the file, and a
+       rebuilt sidecar changes the gzip tag even if the file did not */
+    char sidecar[PATH_MAX];
+    struct stat gz_st;
+    int gz_fd = -1;
+    if (snprintf(sidecar, sizeof(sidecar), "%s.gz", path) < (int)sizeof(sidecar))
+        gz_fd = content_open_path(sidecar, &gz_st);
+    if (gz_fd >= 0 && S_ISREG(gz_st.st_mode) && gz_st.st_mtime >= st->st_mtime)
+    {
+        meta->has_gzip_sidecar = true;
+        meta->gzip_size = gz_st.st_size;
+        meta->cache_mtime = gz_st.st_mtime;
+        snprintf(meta->gzip_etag, sizeof(meta->gzip_etag), "%.*s-gz-%jx-%jx-%jx\"",
+                 (int)strlen(meta->etag) - 1, meta->etag,
+                 (uintmax_t)gz_st.st_ino, (uintmax_t)gz_st.st_size, (uintmax_t)stat_mtime_ns(&gz_st));
+    }
+    if (gz_fd >= 0)
+        close(gz_fd);
+
+    meta->checked_at = time(NULL);
+}
+
+/* Look up a path, using a fresh cached entry that (when st is given)
+   still matches the open file; otherwise rebuild it from st, or from a
+   stat of the path */
+static int lookup(const char *path, const struct stat *st, path_meta_t *out)
+{
+    if (strlen(path) >= PATH_MAX)
+        return -1;
+
+    path_slot_t *slot = &entries[hash_path(path) % PATH_CACHE_ENTRIES];
+    const path_meta_t *cached = &slot->meta;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&path_cache_lock);
+    if (cached->checked_at != 0 && now - cached->checked_at < PATH_CACHE_TTL && strcmp(slot->path, path) == 0 &&
+        (!st || (cached->ino == st->st_ino && cached->size == st->st_size &&
+                 cached->mtime_ns == stat_mtime_ns(st))))
+    {
+        *out = *cached;
+        pthread_mutex_unlock(&path_cache_lock);
+        return 0;
+    }
+    pthread_mutex_unlock(&path_cache_lock);
+
+    /* Miss or stale: stat outside the lock, then publish */
+    struct stat path_st;
+    if (!st)
+    {
+        if (stat(path, &path_st) != 0 || !S_ISREG(path_st.st_mode))
+            return -1;
+        st = &path_st;
+    }
+
+    load_meta(path, st, out);
+
+    pthread_mutex_lock(&path_cache_lock);
+    strcpy(slot->path, path);
+    slot->meta = *out;
+    pthread_mutex_unlock(&path_cache_lock);
+    return 0;
+}
+
+int path_cache_lookup(const char *path, path_meta_t *out)
+{
+    return lookup(path, NULL, out);
+}
+
+int path_cache_lookup_stat(const char *path, const struct stat *st, path_meta_t *out)
+{
+    return lookup(path, st, out);
+}
+
+void path_cache_clear(void)
+{
+    pthread_mutex_lock(&path_cache_lock);
+    memset(entries, 0, sizeof(entries));
+    pthread_mutex_unlock(&path_cache_lock);
+}
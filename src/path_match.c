@@ -0,0 +1,42 @@
+#include <string.h>
+
+#include "include/path_match.h"
+
+static bool glob_match(const char *pattern, const char *str)
+{
+    while (*pattern)
+    {
+        if (*pattern == '*')
+        {
+            pattern++;
+            for (const char *s = str;; s++)
+            {
+                if (glob_match(pattern, s))
+                    return true;
+                if (*s == '\0' || *s == '/')
+                    return false;
+            }
+        }
+        if (*str == '\0' || (*pattern != '?' && *pattern != *str) || (*pattern == '?' && *str == '/'))
+            return false;
+        pattern++;
+        str++;
+    }
+    return *str == '\0';
+}
+
+bool path_glob_match(const char *pattern, const char *rel_path)
+{
+    while (*rel_path == '/')
+        rel_path++;
+
+    if (strchr(pattern, '/'))
+    {
+        while (*pattern == '/')
+            pattern++;
+        return glob_match(pattern, rel_path);
+    }
+
+    const char *base = strrchr(rel_path, '/');
+    return glob_match(pattern, base ? base + 1 : rel_path);
+}
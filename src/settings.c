@@ -247,78 +247,56 @@ const bool get_whitelist_enabled()
     return cJSON_IsBool(enabled) ? (enabled->valueint != 0) : false;
 }
 
-char **get_whitelist_ips(int *out_count)
+/* Point an arena-allocated array at the strings of a config array. The
+   config is loaded once and never freed, so the strings stay valid. */
+static const char **borrow_string_array(const char *key, arena_t *arena, int *out_count)
 {
     if (!out_count)
         return NULL;
 
     load_config();
-    cJSON *ips = cJSON_GetObjectItemCaseSensitive(cached_config, "whitelist-ips");
+    cJSON *array = cJSON_GetObjectItemCaseSensitive(cached_config, key);
 
     *out_count = 0;
-    if (!cJSON_IsArray(ips))
+    if (!cJSON_IsArray(array))
         return NULL;
 
-    int count = cJSON_GetArraySize(ips);
+    int count = cJSON_GetArraySize(array);
     if (count <= 0)
         return NULL;
 
-    char **entries = malloc(count * sizeof(char *));
+    const char **entries = arena_alloc(arena, count * sizeof(char *));
     if (!entries)
         return NULL;
 
     int valid_count = 0;
-    for (int i = 0; i < count; i++)
+    cJSON *item;
+    cJSON_ArrayForEach(item, array)
     {
-        cJSON *item = cJSON_GetArrayItem(ips, i);
         if (cJSON_IsString(item) && item->valuestring)
-        {
-            entries[valid_count] = strdup(item->valuestring);
-            if (entries[valid_count])
-                valid_count++;
-        }
+            entries[valid_count++] = item->valuestring;
     }
 
     *out_count = valid_count;
     return valid_count > 0 ? entries : NULL;
 }
 
-char **get_whitelist_files(int *out_count)
+const char **get_whitelist_ips(arena_t *arena, int *out_count)
 {
-    if (!out_count)
-        return NULL;
-
-    load_config();
-    cJSON *files = cJSON_GetObjectItemCaseSensitive(cached_config, "whitelist-files");
-
-    *out_count = 0;
-    if (!cJSON_IsArray(files))
-        return NULL;
-
-    int count = cJSON_GetArraySize(files);
-    if (count <= 0)
-        return NULL;
-
-    char **entries = malloc(count * sizeof(char *));
-    if (!entries)
-        return NULL;
-
-    int valid_count = 0;
-    for (int i = 0; i < count; i++)
-    {
-        cJSON *item = cJSON_GetArrayItem(files, i);
-        if (cJSON_IsString(item) && item->valuestring)
-        {
-            entries[valid_count] = strdup(item->valuestring);
-            if (entries[valid_count])
-                valid_count++;
-        }
-    }
+    return borrow_string_array("whitelist-ips", arena, out_count);
+}
 
-    *out_count = valid_count;
-    return valid_count > 0 ? entries : NULL;
+const char **get_whitelist_files(arena_t *arena, int *out_count)
+{
+    return borrow_string_array("whitelist-files", arena, out_count);
 }
+
 void free_whitelist_entries(char **entries, int count)
+{
+    free_string_array(entries, count);
+}
+
+void free_string_array(char **entries, int count)
 {
     if (!entries)
         return;
@@ -395,3 +373,387 @@ int get_thread_pool_size(void)
     }
     return 4; /* Default to 4 threads */
 }
+
+int get_thread_pool_queue_size(void)
+{
+    load_config();
+    cJSON *size = cJSON_GetObjectItemCaseSensitive(cached_config, "thread-pool-queue-size");
+    if (cJSON_IsNumber(size) && size->valueint > 0)
+    {
+        return size->valueint;
+    }
+    return 256; /* Default to 256 queued connections */
+}
+
+const bool get_thread_pool_adaptive(void)
+{
+    load_config();
+    cJSON *adaptive = cJSON_GetObjectItemCaseSensitive(cached_config, "thread-pool-adaptive");
+    return cJSON_IsBool(adaptive) ? (adaptive->valueint != 0) : false;
+}
+
+int get_thread_pool_min_size(void)
+{
+    load_config();
+    cJSON *size = cJSON_GetObjectItemCaseSensitive(cached_config, "thread-pool-min-size");
+    if (cJSON_IsNumber(size) && size->valueint > 0)
+    {
+        return size->valueint;
+    }
+    return get_thread_pool_size(); /* Default to the fixed pool size */
+}
+
+int get_thread_pool_max_size(void)
+{
+    load_config();
+    cJSON *size = cJSON_GetObjectItemCaseSensitive(cached_config, "thread-pool-max-size");
+    if (cJSON_IsNumber(size) && size->valueint > 0)
+    {
+        return size->valueint;
+    }
+    return get_thread_pool_size() * 4; /* Default to 4x the fixed pool size */
+}
+
+int get_thread_pool_grow_wait_ms(void)
+{
+    load_config();
+    cJSON *wait = cJSON_GetObjectItemCaseSensitive(cached_config, "thread-pool-grow-wait-ms");
+    if (cJSON_IsNumber(wait) && wait->valueint > 0)
+    {
+        return wait->valueint;
+    }
+    return 50; /* Default to growing when work waits over 50ms */
+}
+
+int get_thread_pool_shrink_idle_seconds(void)
+{
+    load_config();
+    cJSON *idle = cJSON_GetObjectItemCaseSensitive(cached_config, "thread-pool-shrink-idle-seconds");
+    if (cJSON_IsNumber(idle) && idle->valueint > 0)
+    {
+        return idle->valueint;
+    }
+    return 30; /* Default to shrinking after 30 idle seconds */
+}
+
+int get_load_shed_queue_depth(void)
+{
+    load_config();
+    cJSON *depth = cJSON_GetObjectItemCaseSensitive(cached_config, "load-shed-queue-depth");
+    if (cJSON_IsNumber(depth) && depth->valueint > 0)
+    {
+        return depth->valueint;
+    }
+    return 0; /* Default to shedding only when the queue is full */
+}
+
+int get_load_shed_target_wait_ms(void)
+{
+    load_config();
+    cJSON *wait = cJSON_GetObjectItemCaseSensitive(cached_config, "load-shed-target-wait-ms");
+    if (cJSON_IsNumber(wait) && wait->valueint >= 0)
+    {
+        return wait->valueint;
+    }
+    return 100; /* Default to shedding once queued work waits over 100ms */
+}
+
+int get_load_shed_interval_ms(void)
+{
+    load_config();
+    cJSON *interval = cJSON_GetObjectItemCaseSensitive(cached_config, "load-shed-interval-ms");
+    if (cJSON_IsNumber(interval) && interval->valueint > 0)
+    {
+        return interval->valueint;
+    }
+    return 500; /* Default to a 500ms observation interval */
+}
+
+int get_load_shed_retry_after(void)
+{
+    load_config();
+    cJSON *retry = cJSON_GetObjectItemCaseSensitive(cached_config, "load-shed-retry-after");
+    if (cJSON_IsNumber(retry) && retry->valueint > 0)
+    {
+        return retry->valueint;
+    }
+    return 1; /* Default to asking clients to retry after 1 second */
+}
+
+int get_io_buffer_size(void)
+{
+    load_config();
+    cJSON *size = cJSON_GetObjectItemCaseSensitive(cached_config, "io-buffer-size");
+    if (cJSON_IsNumber(size) && size->valueint > 0)
+    {
+        return size->valueint;
+    }
+    return 131072; /* Default to 128KB streaming buffers */
+}
+
+int get_io_buffer_pool_size(void)
+{
+    load_config();
+    cJSON *count = cJSON_GetObjectItemCaseSensitive(cached_config, "io-buffer-pool-size");
+    if (cJSON_IsNumber(count) && count->valueint >= 0)
+    {
+        return count->valueint;
+    }
+    return 64; /* Default to keeping 64 spare buffers shared between threads */
+}
+
+int get_fd_cache_size(void)
+{
+    load_config();
+    cJSON *size = cJSON_GetObjectItemCaseSensitive(cached_config, "fd-cache-size");
+    if (cJSON_IsNumber(size) && size->valueint >= 0)
+    {
+        return size->valueint;
+    }
+    return 256; /* Default to keeping up to 256 served files open */
+}
+
+int get_top_k_size(void)
+{
+    load_config();
+    cJSON *size = cJSON_GetObjectItemCaseSensitive(cached_config, "top-k-size");
+    if (cJSON_IsNumber(size) && size->valueint >= 0)
+    {
+        return size->valueint;
+    }
+    return 64; /* Default to tracking the 64 busiest paths and clients */
+}
+
+const bool get_io_buffer_hugepages(void)
+{
+    load_config();
+    cJSON *hugepages = cJSON_GetObjectItemCaseSensitive(cached_config, "io-buffer-hugepages");
+    return cJSON_IsBool(hugepages) ? (hugepages->valueint != 0) : false;
+}
+
+int get_compression_threads(void)
+{
+    load_config();
+    cJSON *threads = cJSON_GetObjectItemCaseSensitive(cached_config, "compression-threads");
+    if (cJSON_IsNumber(threads) && threads->valueint >= 0)
+    {
+        return threads->valueint;
+    }
+    return 2; /* Default to 2 threads for streaming compression */
+}
+
+int get_compression_queue_size(void)
+{
+    load_config();
+    cJSON *queue = cJSON_GetObjectItemCaseSensitive(cached_config, "compression-queue-size");
+    if (cJSON_IsNumber(queue) && queue->valueint > 0)
+    {
+        return queue->valueint;
+    }
+    return 8; /* Default to 8 responses waiting for a compression thread */
+}
+
+const char *get_content_bundle(void)
+{
+    load_config();
+    cJSON *bundle = cJSON_GetObjectItemCaseSensitive(cached_config, "content-bundle");
+    if (cJSON_IsString(bundle) && bundle->valuestring && bundle->valuestring[0] != '\0')
+    {
+        return bundle->valuestring;
+    }
+    return NULL; /* Default to serving the content directory */
+}
+
+const bool get_cache_immutable_hashed(void)
+{
+    load_config();
+    cJSON *hashed = cJSON_GetObjectItemCaseSensitive(cached_config, "cache-immutable-hashed-names");
+    return cJSON_IsBool(hashed) ? (hashed->valueint != 0) : false;
+}
+
+const char *get_cache_immutable_manifest(void)
+{
+    load_config();
+    cJSON *manifest = cJSON_GetObjectItemCaseSensitive(cached_config, "cache-immutable-manifest");
+    if (cJSON_IsString(manifest) && manifest->valuestring && manifest->valuestring[0] != '\0')
+    {
+        return manifest->valuestring;
+    }
+    return NULL; /* Default to no manifest */
+}
+
+/* Read a config object of string members into parallel malloc'd arrays
+   of names and values, in file order. Returns the number of members. */
+static int get_string_map(const char *key, char ***out_names, char ***out_values)
+{
+    *out_names = NULL;
+    *out_values = NULL;
+
+    load_config();
+    cJSON *map = cJSON_GetObjectItemCaseSensitive(cached_config, key);
+    if (!cJSON_IsObject(map))
+        return 0;
+
+    int count = cJSON_GetArraySize(map);
+    if (count <= 0)
+        return 0;
+
+    char **names = malloc(count * sizeof(char *));
+    char **values = malloc(count * sizeof(char *));
+    if (!names || !values)
+    {
+        free(names);
+        free(values);
+        return 0;
+    }
+
+    int valid_count = 0;
+    cJSON *item;
+    cJSON_ArrayForEach(item, map)
+    {
+        if (!cJSON_IsString(item) || !item->valuestring || !item->string)
+            continue;
+        names[valid_count] = strdup(item->string);
+        values[valid_count] = strdup(item->valuestring);
+        if (names[valid_count] && values[valid_count])
+        {
+            valid_count++;
+        }
+        else
+        {
+            free(names[valid_count]);
+            free(values[valid_count]);
+        }
+    }
+
+    if (valid_count == 0)
+    {
+        free(names);
+        free(values);
+        return 0;
+    }
+    *out_names = names;
+    *out_values = values;
+    return valid_count;
+}
+
+int get_cache_policies(char ***out_patterns, char ***out_values)
+{
+    /* "glob": "Cache-Control value" */
+    return get_string_map("cache-policies", out_patterns, out_values);
+}
+
+int get_mime_types(char ***out_extensions, char ***out_types)
+{
+    /* "extension": "type" */
+    return get_string_map("mime-types", out_extensions, out_types);
+}
+
+const bool get_warmup_on_start(void)
+{
+    load_config();
+    cJSON *warmup = cJSON_GetObjectItemCaseSensitive(cached_config, "warmup-on-start");
+    return cJSON_IsBool(warmup) ? (warmup->valueint != 0) : false;
+}
+
+char **get_warmup_patterns(int *out_count)
+{
+    if (!out_count)
+        return NULL;
+
+    load_config();
+    cJSON *patterns = cJSON_GetObjectItemCaseSensitive(cached_config, "warmup-patterns");
+
+    *out_count = 0;
+    if (!cJSON_IsArray(patterns))
+        return NULL;
+
+    int count = cJSON_GetArraySize(patterns);
+    if (count <= 0)
+        return NULL;
+
+    char **entries = malloc(count * sizeof(char *));
+    if (!entries)
+        return NULL;
+
+    int valid_count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        cJSON *item = cJSON_GetArrayItem(patterns, i);
+        if (cJSON_IsString(item) && item->valuestring && item->valuestring[0] != '\0')
+        {
+            entries[valid_count] = strdup(item->valuestring);
+            if (entries[valid_count])
+                valid_count++;
+        }
+    }
+
+    *out_count = valid_count;
+    if (valid_count == 0)
+    {
+        free(entries);
+        return NULL;
+    }
+    return entries;
+}
+
+const char *get_warmup_manifest(void)
+{
+    load_config();
+    cJSON *manifest = cJSON_GetObjectItemCaseSensitive(cached_config, "warmup-manifest");
+    if (cJSON_IsString(manifest) && manifest->valuestring && manifest->valuestring[0] != '\0')
+    {
+        return manifest->valuestring;
+    }
+    return NULL; /* Default to globs only */
+}
+
+int get_warmup_threads(void)
+{
+    load_config();
+    cJSON *threads = cJSON_GetObjectItemCaseSensitive(cached_config, "warmup-threads");
+    if (cJSON_IsNumber(threads) && threads->valueint > 0)
+    {
+        return threads->valueint;
+    }
+    return 4; /* Default to 4 warm-up threads */
+}
+
+int get_listen_backlog(void)
+{
+    load_config();
+    cJSON *backlog = cJSON_GetObjectItemCaseSensitive(cached_config, "listen-backlog");
+    if (cJSON_IsNumber(backlog) && backlog->valueint > 0)
+    {
+        return backlog->valueint;
+    }
+    return 0; /* Default to SOMAXCONN */
+}
+
+/* Read a non-negative integer member of a config object, or fallback */
+static int get_object_int(cJSON *object, const char *key, int fallback)
+{
+    cJSON *item = cJSON_GetObjectItemCaseSensitive(object, key);
+    if (cJSON_IsNumber(item) && item->valueint >= 0)
+        return item->valueint;
+    return fallback;
+}
+
+void get_socket_options(socket_options_t *out)
+{
+    load_config();
+    memset(out, 0, sizeof(*out));
+
+    cJSON *opts = cJSON_GetObjectItemCaseSensitive(cached_config, "socket-options");
+    if (!cJSON_IsObject(opts))
+        return; /* Default to system socket defaults */
+
+    out->defer_accept_seconds = get_object_int(opts, "tcp-defer-accept", 0);
+    out->fastopen_queue = get_object_int(opts, "tcp-fastopen", 0);
+    out->send_buffer = get_object_int(opts, "send-buffer", 0);
+    out->receive_buffer = get_object_int(opts, "receive-buffer", 0);
+    out->busy_poll_usec = get_object_int(opts, "busy-poll", 0);
+
+    cJSON *nodelay = cJSON_GetObjectItemCaseSensitive(opts, "tcp-nodelay");
+    out->nodelay = cJSON_IsBool(nodelay) ? (nodelay->valueint != 0) : false;
+}
@@ -36,7 +36,14 @@ void init_signal_handlers(void)
     sa.sa_handler = sigint_handler;
     sigaction(SIGINT, &sa, NULL);
 
-    log_info("Signal handlers initialized (SIGTERM, SIGINT)");
+    /* A client that disconnects mid-response must fail the write, not
+       kill the process */
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    log_info("Signal handlers initialized (SIGTERM, SIGINT, SIGPIPE ignored)");
 }
 
 int is_shutdown_requested(void)
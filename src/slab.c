@@ -0,0 +1,266 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "include/compat.h"
+#include "include/slab.h"
+#include "include/metrics.h"
+
+/* A free object holds the link to the next one */
+typedef struct free_object
+{
+    struct free_object *next;
+} free_object_t;
+
+/* Chunks are chained through a header in front of their objects */
+typedef struct chunk
+{
+    struct chunk *next;
+} chunk_t;
+
+struct slab
+{
+    uint64_t serial; /* Identifies this slab in the per-thread caches */
+    struct slab *next_live;
+    size_t object_size;
+    int objects_per_chunk;
+
+    pthread_mutex_t lock;
+    free_object_t *free_list; /* Shared list of returned objects */
+    int free_count;
+    char *bump;               /* Never-used objects left in the newest chunk */
+    int bump_remaining;
+    chunk_t *chunks;
+};
+
+typedef struct
+{
+    slab_t *slab;
+    uint64_t serial;
+    free_object_t *head;
+    int count;
+} thread_cache_t;
+
+static _Atomic uint64_t next_serial = 1;
+static slab_t *live_slabs; /* Every slab not yet destroyed */
+static pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local thread_cache_t thread_caches[SLAB_MAX_CACHES];
+static _Thread_local bool thread_caches_registered = false;
+static pthread_key_t caches_key;
+static pthread_once_t caches_key_once = PTHREAD_ONCE_INIT;
+
+/* Hand a list of count objects to the shared list */
+static void shared_push(slab_t *slab, free_object_t *head, free_object_t *tail, int count)
+{
+    pthread_mutex_lock(&slab->lock);
+    tail->next = slab->free_list;
+    slab->free_list = head;
+    slab->free_count += count;
+    pthread_mutex_unlock(&slab->lock);
+}
+
+/* Give a cache's objects back to its slab's shared list, unless that
+   slab has been destroyed meanwhile (its memory, objects included, went
+   with it, so the list is not even walked) */
+static void cache_flush(thread_cache_t *cache)
+{
+    if (cache->head)
+    {
+        pthread_mutex_lock(&live_lock);
+        for (slab_t *live = live_slabs; live; live = live->next_live)
+        {
+            if (live == cache->slab && live->serial == cache->serial)
+            {
+                free_object_t *tail = cache->head;
+                while (tail->next)
+                    tail = tail->next;
+                shared_push(live, cache->head, tail, cache->count);
+                break;
+            }
+        }
+        pthread_mutex_unlock(&live_lock);
+    }
+    cache->head = NULL;
+    cache->count = 0;
+}
+
+/* Thread exit: give cached objects back so other threads can reuse them.
+   Slabs outlive the threads that use them. */
+static void thread_caches_drain(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < SLAB_MAX_CACHES; i++)
+        cache_flush(&thread_caches[i]);
+}
+
+static void caches_key_create(void)
+{
+    pthread_key_create(&caches_key, thread_caches_drain);
+}
+
+/* The calling thread's cache for a slab. A slot held by another live
+   slab (more than SLAB_MAX_CACHES in use) is flushed back to it first. */
+static thread_cache_t *thread_cache_for(slab_t *slab)
+{
+    thread_cache_t *cache = &thread_caches[slab->serial % SLAB_MAX_CACHES];
+    if (cache->serial != slab->serial)
+    {
+        cache_flush(cache);
+        cache->slab = slab;
+        cache->serial = slab->serial;
+
+        if (!thread_caches_registered)
+        {
+            pthread_once(&caches_key_once, caches_key_create);
+            pthread_setspecific(caches_key, thread_caches);
+            thread_caches_registered = true;
+        }
+    }
+    return cache;
+}
+
+slab_t *slab_create(size_t object_size, int objects_per_chunk)
+{
+    slab_t *slab = calloc(1, sizeof(slab_t));
+    if (!slab)
+        return NULL;
+
+    /* Keep every object aligned for any member type */
+    size_t align = sizeof(max_align_t) < 16 ? sizeof(max_align_t) : 16;
+    if (object_size < sizeof(free_object_t))
+        object_size = sizeof(free_object_t);
+    slab->object_size = (object_size + align - 1) & ~(align - 1);
+    slab->objects_per_chunk = objects_per_chunk > 0 ? objects_per_chunk : 64;
+    slab->serial = atomic_fetch_add(&next_serial, 1);
+    pthread_mutex_init(&slab->lock, NULL);
+
+    pthread_mutex_lock(&live_lock);
+    slab->next_live = live_slabs;
+    live_slabs = slab;
+    pthread_mutex_unlock(&live_lock);
+    return slab;
+}
+
+/* Refill an empty thread cache with up to a batch of objects: returned
+   ones first, then fresh ones from the newest chunk. Called with the lock. */
+static void refill_locked(slab_t *slab, thread_cache_t *cache)
+{
+    int recycled = 0;
+    while (slab->free_list && recycled < SLAB_BATCH)
+    {
+        free_object_t *object = slab->free_list;
+        slab->free_list = object->next;
+        object->next = cache->head;
+        cache->head = object;
+        recycled++;
+    }
+    slab->free_count -= recycled;
+    cache->count += recycled;
+    if (recycled > 0)
+        return;
+
+    if (slab->bump_remaining == 0)
+    {
+        size_t header = (sizeof(chunk_t) + 15) & ~(size_t)15;
+        chunk_t *chunk = malloc(header + slab->object_size * (size_t)slab->objects_per_chunk);
+        if (!chunk)
+            return;
+        chunk->next = slab->chunks;
+        slab->chunks = chunk;
+        slab->bump = (char *)chunk + header;
+        slab->bump_remaining = slab->objects_per_chunk;
+        metrics_record_slab_chunk();
+    }
+
+    int fresh = slab->bump_remaining < SLAB_BATCH ? slab->bump_remaining : SLAB_BATCH;
+    for (int i = 0; i < fresh; i++)
+    {
+        free_object_t *object = (free_object_t *)slab->bump;
+        slab->bump += slab->object_size;
+        object->next = cache->head;
+        cache->head = object;
+    }
+    slab->bump_remaining -= fresh;
+    cache->count += fresh;
+}
+
+void *slab_alloc(slab_t *slab)
+{
+    thread_cache_t *cache = thread_cache_for(slab);
+    if (!cache->head)
+    {
+        pthread_mutex_lock(&slab->lock);
+        refill_locked(slab, cache);
+        pthread_mutex_unlock(&slab->lock);
+        if (!cache->head)
+            return NULL;
+    }
+
+    free_object_t *object = cache->head;
+    cache->head = object->next;
+    cache->count--;
+    metrics_record_slab_alloc();
+    return object;
+}
+
+void slab_free(slab_t *slab, void *ptr)
+{
+    if (!ptr)
+        return;
+
+    thread_cache_t *cache = thread_cache_for(slab);
+    free_object_t *object = ptr;
+    object->next = cache->head;
+    cache->head = object;
+    cache->count++;
+    metrics_record_slab_recycle();
+
+    /* Threads that only free (workers closing connections accepted
+       elsewhere) pass their surplus back a batch at a time */
+    if (cache->count >= SLAB_THREAD_CACHE)
+    {
+        free_object_t *head = cache->head, *tail = head;
+        for (int i = 1; i < SLAB_BATCH; i++)
+            tail = tail->next;
+        cache->head = tail->next;
+        cache->count -= SLAB_BATCH;
+        shared_push(slab, head, tail, SLAB_BATCH);
+    }
+}
+
+void slab_destroy(slab_t *slab)
+{
+    if (!slab)
+        return;
+
+    pthread_mutex_lock(&live_lock);
+    for (slab_t **link = &live_slabs; *link; link = &(*link)->next_live)
+    {
+        if (*link == slab)
+        {
+            *link = slab->next_live;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&live_lock);
+
+    /* Forget this thread's cache; other threads' slots are dropped lazily,
+       as the slab is no longer live */
+    thread_cache_t *cache = &thread_caches[slab->serial % SLAB_MAX_CACHES];
+    if (cache->serial == slab->serial)
+    {
+        cache->serial = 0;
+        cache->head = NULL;
+        cache->count = 0;
+    }
+
+    chunk_t *chunk = slab->chunks;
+    while (chunk)
+    {
+        chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    pthread_mutex_destroy(&slab->lock);
+    free(slab);
+}
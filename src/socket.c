@@ -11,7 +11,85 @@
 #include "include/socket.h"
 #include "include/logger.h"
 
-int start_server(const char *host, int port)
+static socket_options_t socket_opts;
+
+/* Set an integer socket option, optionally reporting the outcome at startup */
+static int set_int_option(int fd, int level, int name, int value, const char *label, bool report)
+{
+#ifdef _WIN32
+    int rc = setsockopt(fd, level, name, (const char *)&value, sizeof(value));
+#else
+    int rc = setsockopt(fd, level, name, &value, sizeof(value));
+#endif
+    if (report)
+    {
+        char msg[160];
+        if (rc == 0)
+            snprintf(msg, sizeof(msg), "Socket option %s=%d applied", label, value);
+        else
+            snprintf(msg, sizeof(msg), "Socket option %s=%d not applied: %s", label, value, strerror(SOCKET_ERRNO()));
+        log_info(msg);
+    }
+    return rc;
+}
+
+#if !defined(SO_BUSY_POLL) || !defined(TCP_DEFER_ACCEPT) || !defined(TCP_FASTOPEN)
+static void report_unsupported(const char *label)
+{
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Socket option %s not supported on this platform", label);
+    log_info(msg);
+}
+#endif
+
+/* Options that must be on the listener before listen(): buffer sizes (so the
+   window scale is negotiated from them), busy polling and deferred accept */
+static void apply_listener_options(int server_fd, const socket_options_t *opts)
+{
+    if (opts->send_buffer > 0)
+        set_int_option(server_fd, SOL_SOCKET, SO_SNDBUF, opts->send_buffer, "SO_SNDBUF", true);
+    if (opts->receive_buffer > 0)
+        set_int_option(server_fd, SOL_SOCKET, SO_RCVBUF, opts->receive_buffer, "SO_RCVBUF", true);
+
+    if (opts->busy_poll_usec > 0)
+    {
+#ifdef SO_BUSY_POLL
+        set_int_option(server_fd, SOL_SOCKET, SO_BUSY_POLL, opts->busy_poll_usec, "SO_BUSY_POLL", true);
+#else
+        report_unsupported("SO_BUSY_POLL");
+#endif
+    }
+
+    if (opts->defer_accept_seconds > 0)
+    {
+#ifdef TCP_DEFER_ACCEPT
+        set_int_option(server_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, opts->defer_accept_seconds, "TCP_DEFER_ACCEPT", true);
+#else
+        report_unsupported("TCP_DEFER_ACCEPT");
+#endif
+    }
+
+    if (opts->nodelay)
+        set_int_option(server_fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY", true);
+}
+
+void socket_apply_client_options(int client_fd)
+{
+    /* Linux copies these from the listener, so accepted sockets need no
+       setsockopt there; other stacks do not */
+#ifdef __linux__
+    (void)client_fd;
+#else
+    if (socket_opts.nodelay)
+        set_int_option(client_fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY", false);
+    if (socket_opts.send_buffer > 0)
+        set_int_option(client_fd, SOL_SOCKET, SO_SNDBUF, socket_opts.send_buffer, "SO_SNDBUF", false);
+    if (socket_opts.receive_buffer > 0)
+        set_int_option(client_fd, SOL_SOCKET, SO_RCVBUF, socket_opts.receive_buffer, "SO_RCVBUF", false);
+#endif
+}
+
+int start_server(const char *host, int port, int backlog, const socket_options_t *opts)
 {
 #ifdef _WIN32
     WSADATA wsaData;
@@ -74,6 +152,12 @@ int start_server(const char *host, int port)
     setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 #endif
 
+    if (opts)
+    {
+        socket_opts = *opts;
+        apply_listener_options(server_fd, opts);
+    }
+
     if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0)
     {
 #ifdef _WIN32
@@ -90,7 +174,10 @@ int start_server(const char *host, int port)
         exit(EXIT_FAILURE);
     }
 
-    if (listen(server_fd, 10) < 0)
+    if (backlog <= 0)
+        backlog = SOMAXCONN;
+
+    if (listen(server_fd, backlog) < 0)
     {
 #ifdef _WIN32
         log_error_code(7, "Listen failed: %d", WSAGetLastError());
@@ -106,8 +193,25 @@ int start_server(const char *host, int port)
         exit(EXIT_FAILURE);
     }
 
+    /* TCP_FASTOPEN takes effect on a listening socket */
+    if (opts && opts->fastopen_queue > 0)
+    {
+#ifdef TCP_FASTOPEN
+        set_int_option(server_fd, IPPROTO_TCP, TCP_FASTOPEN, opts->fastopen_queue, "TCP_FASTOPEN", true);
+#else
+        report_unsupported("TCP_FASTOPEN");
+#endif
+    }
+
+#ifndef _WIN32
+    /* Non-blocking listener so the accept loop can drain it in batches */
+    int flags = fcntl(server_fd, F_GETFL, 0);
+    fcntl(server_fd, F_SETFL, flags | O_NONBLOCK);
+    fcntl(server_fd, F_SETFD, FD_CLOEXEC);
+#endif
+
     char info_msg[128];
-    snprintf(info_msg, sizeof(info_msg), "Server started on %s:%d", host, port);
+    snprintf(info_msg, sizeof(info_msg), "Server started on %s:%d (listen backlog %d)", host, port, backlog);
     log_info(info_msg);
 
     return server_fd;
@@ -1,152 +1,832 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <time.h>
 
 #include "include/compat.h"
 #include "include/threadpool.h"
 #include "include/logger.h"
 #include "include/client.h"
+#include "include/metrics.h"
+#include "include/admission.h"
+#include "include/slab.h"
 
-#define MAX_QUEUE_SIZE 256
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#endif
 
-typedef struct queue_node
+#define CACHE_LINE_SIZE 64
+
+/* Connection objects carved per slab chunk */
+#define CONN_SLAB_CHUNK 256
+
+/* Seconds a keep-alive connection may sit idle in the poller */
+#define KEEPALIVE_IDLE_TIMEOUT 5
+
+/* Adaptive sizing: sample interval, consecutive slow samples needed to grow,
+   and samples to hold off after any resize (hysteresis) */
+#define RESIZE_TICK_MS 250
+#define RESIZE_GROW_TICKS 2
+#define RESIZE_COOLDOWN_TICKS 4
+
+/* One slot of the bounded MPMC ring (Vyukov). The sequence number tells
+   producers and consumers whether the slot is free or holds work for them. */
+typedef struct
+{
+    _Atomic size_t sequence;
+    work_item_t *work;
+} queue_cell_t;
+
+typedef struct
+{
+    queue_cell_t *cells;
+    size_t mask;
+
+    /* Producer and consumer cursors are padded onto separate cache lines */
+    char pad0[CACHE_LINE_SIZE];
+    _Atomic size_t enqueue_pos;
+    char pad1[CACHE_LINE_SIZE];
+    _Atomic size_t dequeue_pos;
+    char pad2[CACHE_LINE_SIZE];
+} work_queue_t;
+
+/* Per-worker state: its own run queue plus a private parking word, so a
+   submit can wake exactly the worker whose queue it filled */
+typedef struct
+{
+    threadpool_t *pool;
+    int index;
+    pthread_t thread;
+    work_queue_t queue;
+    _Atomic int idle;
+    _Atomic uint32_t wake_seq;
+    _Atomic bool retire; /* Set by the resizer to make this worker exit */
+    _Atomic bool exited; /* Set by the worker as it returns, so it can be joined at once */
+    bool started;
+#ifndef __linux__
+    pthread_mutex_t park_lock;
+    pthread_cond_t park_cond;
+#endif
+} worker_t;
+
+#ifdef __linux__
+/* A keep-alive connection waiting in the poller for its next request */
+typedef struct
 {
-    work_item_t work;
-    struct queue_node *next;
-} queue_node_t;
+    work_item_t *work; /* NULL when the slot is free */
+    time_t parked_at;
+} parked_conn_t;
+#endif
 
 typedef struct threadpool
 {
-    pthread_t *threads;
-    int num_threads;
-    pthread_mutex_t lock;
-    pthread_cond_t cond;
-    queue_node_t *queue_head;
-    queue_node_t *queue_tail;
-    int queue_size;
-    bool shutdown;
+    worker_t *workers;
+    int num_threads; /* Worker slots allocated (max size when adaptive) */
+    unsigned int next_worker; /* Round-robin cursor, accept thread only */
+
+    _Atomic int active_threads; /* Workers [0, active_threads) are running */
+    _Atomic int queued;
+    int queue_limit; /* Configured bound on queued across every worker */
+    _Atomic int idle_workers;
+    _Atomic bool shutdown;
+
+    /* Adaptive sizing */
+    bool adaptive;
+    threadpool_sizing_t sizing;
+    pthread_t resizer;
+    _Atomic uint64_t max_wait_us; /* Longest queue wait since the last sample */
+
+    /* Connection state lives in slab objects from accept to close; the
+       queues and the poller pass pointers to them */
+    slab_t *conns;
+
+#ifdef __linux__
+    int epoll_fd;
+    pthread_t poller;
+    pthread_mutex_t parked_lock;
+    parked_conn_t *parked;
+    int parked_cap;
+#endif
 } threadpool_t;
 
-static void *worker_thread(void *arg)
+/* Monotonic clock in microseconds, used to measure queue wait time */
+static uint64_t now_us(void)
 {
-    threadpool_t *pool = (threadpool_t *)arg;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
 
-    while (1)
+/* Round up to the next power of two so slot lookup is a mask */
+static size_t round_up_pow2(size_t n)
+{
+    size_t p = 2;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+static int queue_init(work_queue_t *q, size_t capacity)
+{
+    q->cells = malloc(capacity * sizeof(queue_cell_t));
+    if (!q->cells)
+        return -1;
+
+    q->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++)
+        atomic_init(&q->cells[i].sequence, i);
+    atomic_init(&q->enqueue_pos, 0);
+    atomic_init(&q->dequeue_pos, 0);
+    return 0;
+}
+
+static bool queue_push(work_queue_t *q, work_item_t *work)
+{
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    for (;;)
+    {
+        queue_cell_t *cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                cell->work = work;
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false; /* Queue full */
+        }
+        else
+        {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static bool queue_pop(work_queue_t *q, work_item_t **out)
+{
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    for (;;)
     {
-        pthread_mutex_lock(&pool->lock);
+        queue_cell_t *cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
 
-        /* Wait for work or shutdown signal */
-        while (pool->queue_size == 0 && !pool->shutdown)
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                *out = cell->work;
+                atomic_store_explicit(&cell->sequence, pos + q->mask + 1, memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
         {
-            pthread_cond_wait(&pool->cond, &pool->lock);
+            return false; /* Queue empty */
         }
+        else
+        {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+/* Block until wake_seq moves away from seq (futex on Linux, condvar elsewhere) */
+static void park_wait(worker_t *w, uint32_t seq)
+{
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *)&w->wake_seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&w->park_lock);
+    while (atomic_load(&w->wake_seq) == seq)
+        pthread_cond_wait(&w->park_cond, &w->park_lock);
+    pthread_mutex_unlock(&w->park_lock);
+#endif
+}
+
+static void park_wake(worker_t *w)
+{
+#ifdef __linux__
+    atomic_fetch_add(&w->wake_seq, 1);
+    syscall(SYS_futex, (uint32_t *)&w->wake_seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&w->park_lock);
+    atomic_fetch_add(&w->wake_seq, 1);
+    pthread_cond_signal(&w->park_cond);
+    pthread_mutex_unlock(&w->park_lock);
+#endif
+}
 
-        /* Check if we should exit */
-        if (pool->shutdown && pool->queue_size == 0)
+/* Wake one idle worker (if any) so it can steal queued work */
+static void wake_idle_worker(threadpool_t *pool)
+{
+    if (atomic_load_explicit(&pool->idle_workers, memory_order_relaxed) == 0)
+        return;
+
+    for (int i = 0; i < pool->num_threads; i++)
+    {
+        if (atomic_load_explicit(&pool->workers[i].idle, memory_order_relaxed))
         {
-            pthread_mutex_unlock(&pool->lock);
+            park_wake(&pool->workers[i]);
             break;
         }
+    }
+}
+
+/* Push work onto a specific worker's queue and make sure someone picks it
+   up: the owner if it is idle, otherwise any idle worker that can steal it */
+static bool submit_to_worker(threadpool_t *pool, int index, work_item_t *work)
+{
+    worker_t *w = &pool->workers[index];
+
+    /* Claim a place within the configured total before pushing: the rings
+       are sized for the smallest pool, so together they can hold more */
+    int depth = atomic_fetch_add(&pool->queued, 1) + 1;
+    if (depth > pool->queue_limit)
+    {
+        atomic_fetch_sub(&pool->queued, 1);
+        return false;
+    }
+
+    work->worker = index;
+    work->enqueued_at = now_us();
+    if (!queue_push(&w->queue, work))
+    {
+        atomic_fetch_sub(&pool->queued, 1);
+        return false;
+    }
+    metrics_record_queue_depth(depth);
+
+    /* Pairs with the idle announcement in worker_thread: either the worker
+       sees our item on its re-check, or we see it idle and wake it */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&w->idle, memory_order_relaxed))
+    {
+        park_wake(w);
+        return true;
+    }
+
+    wake_idle_worker(pool);
+    return true;
+}
+
+/* Submit to the preferred worker, spilling to the others if its queue is full */
+static bool submit_any(threadpool_t *pool, int preferred, work_item_t *work)
+{
+    int active = atomic_load_explicit(&pool->active_threads, memory_order_relaxed);
+    for (int i = 0; i < active; i++)
+    {
+        if (submit_to_worker(pool, (preferred + i) % active, work))
+            return true;
+    }
+    return false;
+}
+
+/* Report how long an item sat queued to admission control, and remember
+   the longest wait for the resizer */
+static void record_queue_wait(threadpool_t *pool, const work_item_t *work)
+{
+    uint64_t now = now_us();
+    uint64_t wait = now - work->enqueued_at;
+    admission_record_wait(wait, now);
+
+    if (!pool->adaptive)
+        return;
+
+    uint64_t prev = atomic_load_explicit(&pool->max_wait_us, memory_order_relaxed);
+    while (wait > prev &&
+           !atomic_compare_exchange_weak_explicit(&pool->max_wait_us, &prev, wait,
+                                                  memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+/* Take work from our own queue first, then steal from the others */
+static bool take_work(worker_t *self, work_item_t **out)
+{
+    threadpool_t *pool = self->pool;
+
+    if (queue_pop(&self->queue, out))
+    {
+        metrics_record_queue_depth(atomic_fetch_sub(&pool->queued, 1) - 1);
+        record_queue_wait(pool, *out);
+        return true;
+    }
+
+    /* Scan every slot, not just active ones, so work left behind in a
+       retired worker's queue is still picked up */
+    for (int i = 1; i < pool->num_threads; i++)
+    {
+        worker_t *victim = &pool->workers[(self->index + i) % pool->num_threads];
+        if (queue_pop(&victim->queue, out))
+        {
+            metrics_record_queue_depth(atomic_fetch_sub(&pool->queued, 1) - 1);
+            record_queue_wait(pool, *out);
+            metrics_record_steal();
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef __linux__
+/* Finish with a connection: close it (unless it was already closed or
+   handed off) and return its state to the slab */
+static void release_connection(threadpool_t *pool, work_item_t *work, bool close_fd)
+{
+    if (close_fd)
+        client_connection_close(work);
+    slab_free(pool->conns, work);
+}
 
-        /* Dequeue work */
-        if (pool->queue_size > 0)
+/* Hand an idle keep-alive connection to the poller until it becomes readable */
+static void park_connection(threadpool_t *pool, work_item_t *work)
+{
+    int fd = work->client_fd;
+
+    pthread_mutex_lock(&pool->parked_lock);
+    if (fd >= pool->parked_cap)
+    {
+        int new_cap = pool->parked_cap ? pool->parked_cap : 1024;
+        while (new_cap <= fd)
+            new_cap *= 2;
+        parked_conn_t *grown = realloc(pool->parked, new_cap * sizeof(parked_conn_t));
+        if (!grown)
         {
-            queue_node_t *node = pool->queue_head;
-            work_item_t work = node->work;
-            pool->queue_head = node->next;
-            pool->queue_size--;
+            pthread_mutex_unlock(&pool->parked_lock);
+            release_connection(pool, work, true);
+            return;
+        }
+        memset(grown + pool->parked_cap, 0, (new_cap - pool->parked_cap) * sizeof(parked_conn_t));
+        pool->parked = grown;
+        pool->parked_cap = new_cap;
+    }
+
+    pool->parked[fd].work = work;
+    pool->parked[fd].parked_at = time(NULL);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.fd = fd;
+    if (epoll_ctl(pool->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+        pool->parked[fd].work = NULL;
+        pthread_mutex_unlock(&pool->parked_lock);
+        release_connection(pool, work, true);
+        return;
+    }
+    pthread_mutex_unlock(&pool->parked_lock);
+}
+
+/* Close parked connections that have been idle too long (or all, on shutdown) */
+static void expire_parked(threadpool_t *pool, time_t now, bool all)
+{
+    pthread_mutex_lock(&pool->parked_lock);
+    for (int fd = 0; fd < pool->parked_cap; fd++)
+    {
+        parked_conn_t *p = &pool->parked[fd];
+        if (!p->work || (!all && now - p->parked_at < KEEPALIVE_IDLE_TIMEOUT))
+            continue;
+
+        epoll_ctl(pool->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        release_connection(pool, p->work, true);
+        p->work = NULL;
+    }
+    pthread_mutex_unlock(&pool->parked_lock);
+}
 
-            if (pool->queue_size == 0)
-                pool->queue_tail = NULL;
+/* Poller thread: turns readable keep-alive connections back into work items
+   on the queue of the worker that served them last */
+static void *poller_thread(void *arg)
+{
+    threadpool_t *pool = (threadpool_t *)arg;
+    struct epoll_event events[64];
+    time_t last_sweep = time(NULL);
 
-            pthread_mutex_unlock(&pool->lock);
-            free(node);
+    while (!atomic_load(&pool->shutdown))
+    {
+        int n = epoll_wait(pool->epoll_fd, events, 64, 1000);
 
-            /* Handle the client outside of lock */
-            handle_accepted_client(work.client_fd, work.client_addr, work.content_directory, work.show_ext);
+        for (int i = 0; i < n; i++)
+        {
+            int fd = events[i].data.fd;
+
+            pthread_mutex_lock(&pool->parked_lock);
+            work_item_t *work = fd < pool->parked_cap ? pool->parked[fd].work : NULL;
+            if (!work)
+            {
+                pthread_mutex_unlock(&pool->parked_lock);
+                continue;
+            }
+            pool->parked[fd].work = NULL;
+            epoll_ctl(pool->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            pthread_mutex_unlock(&pool->parked_lock);
+
+            if (!submit_any(pool, work->worker, work))
+            {
+                admission_reject(work->client_fd);
+                release_connection(pool, work, false);
+            }
         }
-        else
+
+        time_t now = time(NULL);
+        if (now != last_sweep)
         {
-            pthread_mutex_unlock(&pool->lock);
+            expire_parked(pool, now, false);
+            last_sweep = now;
         }
     }
 
     return NULL;
 }
+#endif
 
-threadpool_t *threadpool_create(int num_threads)
+/* Run one unit of work: a single request on a ready connection */
+static void run_work_item(threadpool_t *pool, worker_t *self, work_item_t *work)
 {
-    threadpool_t *pool = malloc(sizeof(threadpool_t));
-    if (!pool)
-        return NULL;
+#ifdef __linux__
+    if (work->request_count == 0 && work->start_time == 0 && !client_connection_open(work))
+    {
+        release_connection(pool, work, false); /* Already closed */
+        return;
+    }
 
-    pool->num_threads = num_threads;
-    pool->threads = malloc(num_threads * sizeof(pthread_t));
-    pool->queue_head = NULL;
-    pool->queue_tail = NULL;
-    pool->queue_size = 0;
-    pool->shutdown = false;
+    switch (client_serve_next_request(work))
+    {
+    case CLIENT_CONN_READY:
+        /* More bytes already buffered: keep it on this worker, cache-warm */
+        if (!submit_to_worker(pool, self->index, work) && !submit_any(pool, self->index, work))
+            release_connection(pool, work, true);
+        break;
+    case CLIENT_CONN_IDLE:
+        park_connection(pool, work);
+        break;
+    case CLIENT_CONN_DETACHED:
+        release_connection(pool, work, false); /* The compression pool owns the fd now */
+        break;
+    default:
+        release_connection(pool, work, true);
+        break;
+    }
+#else
+    (void)self;
+    handle_accepted_client(work->client_fd, work->client_addr, work->content_directory, work->show_ext);
+    slab_free(pool->conns, work);
+#endif
+}
 
-    pthread_mutex_init(&pool->lock, NULL);
-    pthread_cond_init(&pool->cond, NULL);
+static void *worker_thread(void *arg)
+{
+    worker_t *self = (worker_t *)arg;
+    threadpool_t *pool = self->pool;
+    work_item_t *work;
 
-    /* Create worker threads */
-    for (int i = 0; i < num_threads; i++)
+    while (1)
     {
-        if (pthread_create(&pool->threads[i], NULL, worker_thread, pool) != 0)
+        if (atomic_load(&self->retire))
         {
-            log_error_code(19, "Failed to create worker thread");
-            free(pool->threads);
-            free(pool);
-            return NULL;
+            /* Shrinking: finish what is already in our own queue, then exit */
+            while (queue_pop(&self->queue, &work))
+            {
+                atomic_fetch_sub(&pool->queued, 1);
+                run_work_item(pool, self, work);
+            }
+            /* A submit may have woken us instead of a worker that stays */
+            if (atomic_load(&pool->queued) > 0)
+                wake_idle_worker(pool);
+            break;
+        }
+
+        if (take_work(self, &work))
+        {
+            run_work_item(pool, self, work);
+            continue;
+        }
+
+        /* Drain the queues before honouring shutdown */
+        if (atomic_load(&pool->shutdown))
+            break;
+
+        /* Announce we are idle, then re-check the queues so a submit that
+           raced with us either sees us idle or its item is taken here */
+        atomic_store(&self->idle, 1);
+        atomic_fetch_add(&pool->idle_workers, 1);
+        uint32_t seq = atomic_load(&self->wake_seq);
+
+        bool found = take_work(self, &work);
+        if (!found && !atomic_load(&pool->shutdown) && !atomic_load(&self->retire))
+            park_wait(self, seq);
+
+        atomic_fetch_sub(&pool->idle_workers, 1);
+        atomic_store(&self->idle, 0);
+
+        if (found)
+            run_work_item(pool, self, work);
+    }
+
+    atomic_store(&self->exited, true);
+    return NULL;
+}
+
+static bool start_worker(threadpool_t *pool, int index)
+{
+    worker_t *w = &pool->workers[index];
+    if (w->started)
+        return false; /* Still finishing its last request since it retired */
+    atomic_store(&w->retire, false);
+    atomic_store(&w->exited, false);
+    if (pthread_create(&w->thread, NULL, worker_thread, w) != 0)
+        return false;
+    w->started = true;
+    return true;
+}
+
+/* Join retired workers that have finished. Retiring never waits for them
+   here: one may be in the middle of a long send. */
+static void reap_retired_workers(threadpool_t *pool, int active)
+{
+    for (int i = active; i < pool->num_threads; i++)
+    {
+        worker_t *w = &pool->workers[i];
+        if (w->started && atomic_load(&w->exited))
+        {
+            pthread_join(w->thread, NULL);
+            w->started = false;
         }
     }
+}
 
-    char msg[64];
-    snprintf(msg, sizeof(msg), "Thread pool created with %d workers", num_threads);
+static void log_resize(const char *direction, int workers, uint64_t wait_us)
+{
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Thread pool %s to %d workers (max queue wait %.1f ms)",
+             direction, workers, wait_us / 1000.0);
     log_info(msg);
+}
 
-    return pool;
+/* Resizer thread: grows the pool while queued work waits longer than the
+   threshold, and shrinks it one worker at a time after sustained idleness */
+static void *resizer_thread(void *arg)
+{
+    threadpool_t *pool = (threadpool_t *)arg;
+    const threadpool_sizing_t *cfg = &pool->sizing;
+    uint64_t grow_wait_us = (uint64_t)cfg->grow_wait_ms * 1000u;
+    int shrink_ticks = cfg->shrink_idle_seconds * 1000 / RESIZE_TICK_MS;
+    int slow_ticks = 0, idle_ticks = 0, cooldown = 0;
+
+    while (!atomic_load(&pool->shutdown))
+    {
+        struct timespec tick = {0, RESIZE_TICK_MS * 1000000L};
+        nanosleep(&tick, NULL);
+
+        uint64_t wait = atomic_exchange(&pool->max_wait_us, 0);
+        int active = atomic_load(&pool->active_threads);
+        int idle = atomic_load(&pool->idle_workers);
+        int queued = atomic_load(&pool->queued);
+        reap_retired_workers(pool, active);
+
+        if (cooldown > 0)
+        {
+            cooldown--;
+            continue;
+        }
+
+        /* Work that is stuck behind busy workers never gets dequeued, so a
+           backlog with nobody idle counts as slow even without a wait sample */
+        bool slow = wait > grow_wait_us || (queued >= active && idle == 0);
+
+        if (slow)
+        {
+            idle_ticks = 0;
+            if (++slow_ticks >= RESIZE_GROW_TICKS && active < cfg->max_threads)
+            {
+                /* A slot whose retired worker is still busy is retried next tick */
+                if (!start_worker(pool, active))
+                    continue;
+                atomic_store(&pool->active_threads, active + 1);
+                metrics_record_pool_size(active + 1, true);
+                log_resize("grown", active + 1, wait);
+                slow_ticks = 0;
+                cooldown = RESIZE_COOLDOWN_TICKS;
+            }
+        }
+        else if (idle > 0 && queued == 0)
+        {
+            slow_ticks = 0;
+            if (++idle_ticks >= shrink_ticks && active > cfg->min_threads)
+            {
+                worker_t *w = &pool->workers[active - 1];
+                atomic_store(&pool->active_threads, active - 1);
+                atomic_store(&w->retire, true);
+                park_wake(w); /* Joined by reap_retired_workers() once it exits */
+                metrics_record_pool_size(active - 1, true);
+                log_resize("shrunk", active - 1, wait);
+                idle_ticks = 0;
+                cooldown = RESIZE_COOLDOWN_TICKS;
+            }
+        }
+        else
+        {
+            slow_ticks = 0;
+            idle_ticks = 0;
+        }
+    }
+
+    return NULL;
 }
 
-void threadpool_submit(threadpool_t *pool, work_item_t work)
+static void threadpool_free(threadpool_t *pool)
 {
+    for (int i = 0; i < pool->num_threads; i++)
+    {
+        free(pool->workers[i].queue.cells);
+#ifndef __linux__
+        pthread_mutex_destroy(&pool->workers[i].park_lock);
+        pthread_cond_destroy(&pool->workers[i].park_cond);
+#endif
+    }
+#ifdef __linux__
+    if (pool->epoll_fd >= 0)
+        close(pool->epoll_fd);
+    pthread_mutex_destroy(&pool->parked_lock);
+    free(pool->parked);
+#endif
+    slab_destroy(pool->conns);
+    free(pool->workers);
+    free(pool);
+}
+
+/* Stop and join the pool's threads: the resizer (when it was started),
+   the poller and every started worker */
+static void stop_threads(threadpool_t *pool, bool join_resizer)
+{
+    atomic_store(&pool->shutdown, true);
+
+    if (join_resizer)
+        pthread_join(pool->resizer, NULL);
+
+#ifdef __linux__
+    pthread_join(pool->poller, NULL);
+#endif
+
+    /* Wait for all threads to finish */
+    for (int i = 0; i < pool->num_threads; i++)
+        park_wake(&pool->workers[i]);
+    for (int i = 0; i < pool->num_threads; i++)
+    {
+        if (pool->workers[i].started)
+            pthread_join(pool->workers[i].thread, NULL);
+    }
+}
+
+threadpool_t *threadpool_create(int num_threads, int queue_size, const threadpool_sizing_t *sizing)
+{
+    threadpool_t *pool = calloc(1, sizeof(threadpool_t));
     if (!pool)
-        return;
+        return NULL;
 
-    queue_node_t *node = malloc(sizeof(queue_node_t));
-    if (!node)
+    int initial_threads = num_threads;
+    if (sizing && sizing->max_threads > sizing->min_threads)
     {
-        log_error_code(22, "Failed to allocate work item");
-        close(work.client_fd);
-        return;
+        pool->adaptive = true;
+        pool->sizing = *sizing;
+        if (initial_threads < sizing->min_threads)
+            initial_threads = sizing->min_threads;
+        if (initial_threads > sizing->max_threads)
+            initial_threads = sizing->max_threads;
+        num_threads = sizing->max_threads; /* Allocate every slot up front */
     }
 
-    node->work = work;
-    node->next = NULL;
+    /* queue_size bounds the total, enforced by queue_limit. Each ring can
+       hold a share of it for the initial pool; an adaptive pool allocates
+       rings for its max size, but they never hold more than the bound. */
+    int per_worker = (queue_size + initial_threads - 1) / initial_threads;
+    size_t capacity = round_up_pow2(per_worker > 0 ? (size_t)per_worker : 1);
+    pool->queue_limit = queue_size > 0 ? queue_size : 1;
+
+    atomic_init(&pool->active_threads, initial_threads);
+    atomic_init(&pool->max_wait_us, 0);
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->idle_workers, 0);
+    atomic_init(&pool->shutdown, false);
+
+#ifdef __linux__
+    pthread_mutex_init(&pool->parked_lock, NULL);
+    pool->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+
+    pool->workers = calloc(num_threads, sizeof(worker_t));
+    if (!pool->workers)
+    {
+        log_error_code(22, "Failed to allocate work queue");
+        free(pool);
+        return NULL;
+    }
+    pool->num_threads = num_threads;
 
-    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < num_threads; i++)
+    {
+        worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->index = i;
+        atomic_init(&w->idle, 0);
+        atomic_init(&w->wake_seq, 0);
+        atomic_init(&w->retire, false);
+        atomic_init(&w->exited, false);
+#ifndef __linux__
+        pthread_mutex_init(&w->park_lock, NULL);
+        pthread_cond_init(&w->park_cond, NULL);
+#endif
+        if (queue_init(&w->queue, capacity) != 0)
+        {
+            log_error_code(22, "Failed to allocate work queue");
+            threadpool_free(pool);
+            return NULL;
+        }
+    }
 
-    /* Check queue size limit */
-    if (pool->queue_size >= MAX_QUEUE_SIZE)
+    pool->conns = slab_create(sizeof(work_item_t), CONN_SLAB_CHUNK);
+    if (!pool->conns)
     {
-        log_error_code(20, "Work queue full, rejecting connection");
-        pthread_mutex_unlock(&pool->lock);
-        free(node);
-        close(work.client_fd);
-        return;
+        log_error_code(22, "Failed to allocate work queue");
+        threadpool_free(pool);
+        return NULL;
     }
 
-    if (pool->queue_tail)
-        pool->queue_tail->next = node;
+#ifdef __linux__
+    if (pool->epoll_fd < 0 || pthread_create(&pool->poller, NULL, poller_thread, pool) != 0)
+    {
+        log_error_code(19, "Failed to create keep-alive poller thread");
+        threadpool_free(pool);
+        return NULL;
+    }
+#endif
+
+    /* Create worker threads */
+    for (int i = 0; i < initial_threads; i++)
+    {
+        if (!start_worker(pool, i))
+        {
+            log_error_code(19, "Failed to create worker thread");
+            stop_threads(pool, false);
+            threadpool_free(pool);
+            return NULL;
+        }
+    }
+
+    if (pool->adaptive && pthread_create(&pool->resizer, NULL, resizer_thread, pool) != 0)
+    {
+        log_error_code(19, "Failed to create thread pool resizer thread");
+        stop_threads(pool, false);
+        threadpool_free(pool);
+        return NULL;
+    }
+
+    metrics_record_pool_size(initial_threads, false);
+
+    char msg[160];
+    if (pool->adaptive)
+        snprintf(msg, sizeof(msg), "Thread pool created with %d workers (adaptive %d-%d), %zu queue slots per worker",
+                 initial_threads, pool->sizing.min_threads, pool->sizing.max_threads, capacity);
     else
-        pool->queue_head = node;
+        snprintf(msg, sizeof(msg), "Thread pool created with %d workers, %zu queue slots per worker",
+                 initial_threads, capacity);
+    log_info(msg);
 
-    pool->queue_tail = node;
-    pool->queue_size++;
+    return pool;
+}
 
-    pthread_cond_signal(&pool->cond);
-    pthread_mutex_unlock(&pool->lock);
+bool threadpool_submit(threadpool_t *pool, work_item_t work)
+{
+    if (!pool)
+        return false;
+
+    work_item_t *conn = slab_alloc(pool->conns);
+    if (!conn)
+        return false;
+    *conn = work;
+    conn->request_count = 0;
+    conn->start_time = 0;
+
+    unsigned int active = (unsigned int)atomic_load_explicit(&pool->active_threads, memory_order_relaxed);
+    int preferred = (int)(pool->next_worker++ % active);
+    if (submit_any(pool, preferred, conn))
+        return true;
+
+    slab_free(pool->conns, conn);
+    return false;
 }
 
 void threadpool_shutdown(threadpool_t *pool)
@@ -154,31 +834,24 @@ void threadpool_shutdown(threadpool_t *pool)
     if (!pool)
         return;
 
-    pthread_mutex_lock(&pool->lock);
-    pool->shutdown = true;
-    pthread_cond_broadcast(&pool->cond);
-    pthread_mutex_unlock(&pool->lock);
+    stop_threads(pool, pool->adaptive);
 
-    /* Wait for all threads to finish */
+    /* Cleanup remaining queued items */
+    work_item_t *work;
     for (int i = 0; i < pool->num_threads; i++)
     {
-        pthread_join(pool->threads[i], NULL);
+        while (queue_pop(&pool->workers[i].queue, &work))
+        {
+            close(work->client_fd);
+            slab_free(pool->conns, work);
+        }
     }
 
-    /* Cleanup remaining queued items */
-    queue_node_t *node = pool->queue_head;
-    while (node)
-    {
-        queue_node_t *next = node->next;
-        close(node->work.client_fd);
-        free(node);
-        node = next;
-    }
+#ifdef __linux__
+    expire_parked(pool, time(NULL), true);
+#endif
 
-    pthread_mutex_destroy(&pool->lock);
-    pthread_cond_destroy(&pool->cond);
-    free(pool->threads);
-    free(pool);
+    threadpool_free(pool);
 
     log_info("Thread pool shutdown complete");
 }
@@ -188,9 +861,6 @@ int threadpool_queue_size(threadpool_t *pool)
     if (!pool)
         return 0;
 
-    pthread_mutex_lock(&pool->lock);
-    int size = pool->queue_size;
-    pthread_mutex_unlock(&pool->lock);
-
-    return size;
+    int queued = atomic_load_explicit(&pool->queued, memory_order_relaxed);
+    return queued > 0 ? queued : 0;
 }
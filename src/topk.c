@@ -0,0 +1,478 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "include/compat.h"
+#include "include/topk.h"
+#include "lib/cJSON.h"
+
+#define TOPK_STATUS_MAX 600 /* Status codes 100-599 are counted exactly */
+
+/* One monitored key. Space-Saving guarantees count - error <= true count
+   <= count. Bytes and latency cover the count - error requests seen since
+   the key took over its slot. */
+typedef struct
+{
+    char key[TOPK_KEY_MAX];
+    uint32_t hash;
+    int32_t heap_pos; /* Where the entry sits in the table's heap */
+    uint64_t count;
+    uint64_t error;
+    uint64_t bytes;
+    double latency_ms;
+} topk_entry_t;
+
+/* Entries, an open-addressed (linear probing) index of them by key hash
+   holding entry numbers or -1, and a min-heap of entry numbers on count,
+   so the slot to take over is always at the root */
+typedef struct
+{
+    topk_entry_t *entries;
+    int used;
+    int32_t *index;
+    uint32_t index_mask;
+    int32_t *heap;
+} topk_table_t;
+
+/* Each recording thread owns a shard, so requests never contend with each
+   other; the shard lock is only ever shared with a /status/top read. A
+   shard outlives its thread and is handed to the next one that starts. */
+typedef struct topk_shard
+{
+    pthread_mutex_t lock;
+    topk_table_t paths;
+    topk_table_t clients;
+    bool in_use;
+    struct topk_shard *next;
+} topk_shard_t;
+
+/* Exact per-status totals; latency is kept in nanoseconds */
+typedef struct
+{
+    _Atomic uint64_t count;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t latency_ns;
+} topk_status_t;
+
+static int capacity;
+static topk_shard_t *shards;
+static pthread_mutex_t shards_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t shard_key;
+static pthread_once_t shard_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local topk_shard_t *thread_shard;
+static topk_status_t statuses[TOPK_STATUS_MAX];
+
+/* FNV-1a over at most TOPK_KEY_MAX - 1 bytes, the part of a key kept */
+static uint32_t hash_key(const char *key, size_t *len)
+{
+    uint32_t h = 2166136261u;
+    size_t n = 0;
+    for (const unsigned char *p = (const unsigned char *)key; *p && n < TOPK_KEY_MAX - 1; p++, n++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    *len = n;
+    return h;
+}
+
+static bool table_init(topk_table_t *table, int entries)
+{
+    /* At most half full, so probe runs stay short */
+    uint32_t slots = 1;
+    while (slots < (uint32_t)entries * 2)
+        slots <<= 1;
+
+    table->entries = calloc((size_t)entries, sizeof(topk_entry_t));
+    table->index = malloc(slots * sizeof(int32_t));
+    table->heap = malloc((size_t)entries * sizeof(int32_t));
+    if (!table->entries || !table->index || !table->heap)
+        return false;
+    memset(table->index, 0xff, slots * sizeof(int32_t));
+    table->index_mask = slots - 1;
+    return true;
+}
+
+static void table_free(topk_table_t *table)
+{
+    free(table->entries);
+    free(table->index);
+    free(table->heap);
+}
+
+void topk_init(int entries)
+{
+    if (entries > 0)
+        capacity = entries;
+}
+
+static topk_entry_t *table_find(const topk_table_t *table, const char *key, size_t len, uint32_t hash)
+{
+    for (uint32_t i = hash & table->index_mask; table->index[i] >= 0; i = (i + 1) & table->index_mask)
+    {
+        topk_entry_t *e = &table->entries[table->index[i]];
+        if (e->hash == hash && strncmp(e->key, key, len) == 0 && e->key[len] == '\0')
+            return e;
+    }
+    return NULL;
+}
+
+static void index_insert(topk_table_t *table, int32_t n)
+{
+    uint32_t i = table->entries[n].hash & table->index_mask;
+    while (table->index[i] >= 0)
+        i = (i + 1) & table->index_mask;
+    table->index[i] = n;
+}
+
+/* Remove entry n from the index, shifting later members of its probe run
+   back so lookups never stop early at the hole */
+static void index_remove(topk_table_t *table, int32_t n)
+{
+    uint32_t mask = table->index_mask;
+    uint32_t hole = table->entries[n].hash & mask;
+    while (table->index[hole] != n)
+        hole = (hole + 1) & mask;
+    table->index[hole] = -1;
+
+    for (uint32_t i = (hole + 1) & mask; table->index[i] >= 0; i = (i + 1) & mask)
+    {
+        uint32_t home = table->entries[table->index[i]].hash & mask;
+        /* Leave it if its home lies cyclically in (hole, i] */
+        bool stays = hole < i ? (home > hole && home <= i) : (home > hole || home <= i);
+        if (!stays)
+        {
+            table->index[hole] = table->index[i];
+            table->index[i] = -1;
+            hole = i;
+        }
+    }
+}
+
+static void heap_place(topk_table_t *table, int pos, int32_t n)
+{
+    table->heap[pos] = n;
+    table->entries[n].heap_pos = pos;
+}
+
+/* Restore the heap below pos after its entry's count grew. Counts grow by
+   one, so this usually stops at once. */
+static void heap_sift_down(topk_table_t *table, int pos)
+{
+    int32_t n = table->heap[pos];
+    uint64_t count = table->entries[n].count;
+    for (;;)
+    {
+        int child = 2 * pos + 1;
+        if (child >= table->used)
+            break;
+        if (child + 1 < table->used &&
+            table->entries[table->heap[child + 1]].count < table->entries[table->heap[child]].count)
+            child++;
+        if (table->entries[table->heap[child]].count >= count)
+            break;
+        heap_place(table, pos, table->heap[child]);
+        pos = child;
+    }
+    heap_place(table, pos, n);
+}
+
+/* Move a new entry, which has the least count, up towards the root */
+static void heap_sift_up(topk_table_t *table, int pos)
+{
+    int32_t n = table->heap[pos];
+    uint64_t count = table->entries[n].count;
+    while (pos > 0)
+    {
+        int parent = (pos - 1) / 2;
+        if (table->entries[table->heap[parent]].count <= count)
+            break;
+        heap_place(table, pos, table->heap[parent]);
+        pos = parent;
+    }
+    heap_place(table, pos, n);
+}
+
+static void table_record(topk_table_t *table, const char *key, off_t bytes, double latency_ms)
+{
+    size_t len;
+    uint32_t hash = hash_key(key, &len);
+
+    topk_entry_t *slot = table_find(table, key, len, hash);
+    bool added = false;
+    if (!slot)
+    {
+        if (table->used < capacity)
+        {
+            int32_t n = table->used++;
+            slot = &table->entries[n];
+            slot->count = 0;
+            slot->error = 0;
+            heap_place(table, n, n);
+            added = true;
+        }
+        else
+        {
+            /* Take over the least counted slot; its count becomes the bound
+               on how much the new key may be overcounted */
+            slot = &table->entries[table->heap[0]];
+            index_remove(table, table->heap[0]);
+            slot->error = slot->count;
+        }
+        memcpy(slot->key, key, len);
+        slot->key[len] = '\0';
+        slot->hash = hash;
+        slot->bytes = 0;
+        slot->latency_ms = 0;
+        index_insert(table, (int32_t)(slot - table->entries));
+    }
+
+    slot->count++;
+    slot->bytes += (uint64_t)bytes;
+    slot->latency_ms += latency_ms;
+    if (added)
+        heap_sift_up(table, slot->heap_pos);
+    else
+        heap_sift_down(table, slot->heap_pos);
+}
+
+/* Thread exit: leave the shard, with its counts, for the next thread */
+static void shard_detach(void *arg)
+{
+    topk_shard_t *shard = arg;
+    pthread_mutex_lock(&shards_lock);
+    shard->in_use = false;
+    pthread_mutex_unlock(&shards_lock);
+}
+
+static void shard_key_create(void)
+{
+    pthread_key_create(&shard_key, shard_detach);
+}
+
+/* The calling thread's shard, adopting a free one or creating it on the
+   thread's first request */
+static topk_shard_t *shard_for_thread(void)
+{
+    if (thread_shard)
+        return thread_shard;
+
+    pthread_once(&shard_key_once, shard_key_create);
+    pthread_mutex_lock(&shards_lock);
+    topk_shard_t *shard = shards;
+    while (shard && shard->in_use)
+        shard = shard->next;
+    if (!shard)
+    {
+        shard = calloc(1, sizeof(topk_shard_t));
+        if (shard && (!table_init(&shard->paths, capacity) || !table_init(&shard->clients, capacity)))
+        {
+            table_free(&shard->paths);
+            table_free(&shard->clients);
+            free(shard);
+            shard = NULL;
+        }
+        if (shard)
+        {
+            pthread_mutex_init(&shard->lock, NULL);
+            shard->next = shards;
+            shards = shard;
+        }
+    }
+    if (shard)
+        shard->in_use = true;
+    pthread_mutex_unlock(&shards_lock);
+
+    if (shard)
+    {
+        pthread_setspecific(shard_key, shard);
+        thread_shard = shard;
+    }
+    return shard;
+}
+
+void topk_record(const char *path, const char *client_ip, int status, off_t bytes, double latency_ms)
+{
+    if (capacity == 0)
+        return;
+    if (bytes < 0)
+        bytes = 0;
+
+    if (status >= 100 && status < TOPK_STATUS_MAX)
+    {
+        topk_status_t *s = &statuses[status];
+        atomic_fetch_add_explicit(&s->count, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&s->bytes, (uint64_t)bytes, memory_order_relaxed);
+        atomic_fetch_add_explicit(&s->latency_ns, (uint64_t)(latency_ms * 1e6), memory_order_relaxed);
+    }
+
+    topk_shard_t *shard = shard_for_thread();
+    if (!shard)
+        return;
+    pthread_mutex_lock(&shard->lock);
+    table_record(&shard->paths, path, bytes, latency_ms);
+    table_record(&shard->clients, client_ip, bytes, latency_ms);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+static double round_ms(double ms)
+{
+    return (double)(int64_t)(ms * 1000.0 + 0.5) / 1000.0;
+}
+
+/* A key's contribution from one shard while merging. count and error are
+   offset by the shard's floor (see table_json). */
+typedef struct
+{
+    const char *key;
+    int64_t count;
+    int64_t error;
+    uint64_t bytes;
+    double latency_ms;
+} topk_merged_t;
+
+static int compare_key(const void *a, const void *b)
+{
+    return strcmp(((const topk_merged_t *)a)->key, ((const topk_merged_t *)b)->key);
+}
+
+static int compare_count_desc(const void *a, const void *b)
+{
+    const topk_merged_t *x = a, *y = b;
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+/* Merge one table across every shard and format it busiest first.
+
+   A full shard's floor (its least count) bounds what it may have seen of
+   any key it no longer tracks, so a key absent from a shard is charged
+   that floor as both count and error. Stored per entry as offsets from
+   the floor, a key's merged count is then sum(count - floor) + total
+   floor, and likewise its error, which keeps count - error <= true count
+   <= count across the merge. */
+static cJSON *table_json(size_t table_offset, const char *key_name)
+{
+    cJSON *array = cJSON_CreateArray();
+
+    pthread_mutex_lock(&shards_lock);
+    size_t total = 0;
+    for (topk_shard_t *shard = shards; shard; shard = shard->next)
+        total += (size_t)capacity;
+    topk_merged_t *merged = total > 0 ? malloc(total * sizeof(topk_merged_t)) : NULL;
+    char *keys = total > 0 ? malloc(total * TOPK_KEY_MAX) : NULL;
+    size_t used = 0;
+    int64_t total_floor = 0;
+    for (topk_shard_t *shard = merged && keys ? shards : NULL; shard; shard = shard->next)
+    {
+        const topk_table_t *table = (const topk_table_t *)((const char *)shard + table_offset);
+        pthread_mutex_lock(&shard->lock);
+        int64_t floor = table->used == capacity ? (int64_t)table->entries[table->heap[0]].count : 0;
+        total_floor += floor;
+        for (int i = 0; i < table->used; i++)
+        {
+            const topk_entry_t *e = &table->entries[i];
+            char *key = keys + used * TOPK_KEY_MAX;
+            memcpy(key, e->key, TOPK_KEY_MAX);
+            merged[used++] = (topk_merged_t){key, (int64_t)e->count - floor, (int64_t)e->error - floor,
+                                             e->bytes, e->latency_ms};
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    pthread_mutex_unlock(&shards_lock);
+
+    /* Fold the shards' entries for each key together */
+    size_t keys_out = 0;
+    if (used > 0)
+    {
+        qsort(merged, used, sizeof(topk_merged_t), compare_key);
+        for (size_t i = 0; i < used; i++)
+        {
+            if (keys_out > 0 && strcmp(merged[keys_out - 1].key, merged[i].key) == 0)
+            {
+                topk_merged_t *into = &merged[keys_out - 1];
+                into->count += merged[i].count;
+                into->error += merged[i].error;
+                into->bytes += merged[i].bytes;
+                into->latency_ms += merged[i].latency_ms;
+            }
+            else
+                merged[keys_out++] = merged[i];
+        }
+        qsort(merged, keys_out, sizeof(topk_merged_t), compare_count_desc);
+    }
+
+    for (size_t i = 0; i < keys_out && i < (size_t)capacity; i++)
+    {
+        const topk_merged_t *e = &merged[i];
+        int64_t count = e->count + total_floor, error = e->error + total_floor;
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, key_name, e->key);
+        cJSON_AddNumberToObject(item, "requests", (double)count);
+        cJSON_AddNumberToObject(item, "max_overcount", (double)error);
+        cJSON_AddNumberToObject(item, "bytes", (double)e->bytes);
+        cJSON_AddNumberToObject(item, "avg_latency_ms", round_ms(e->latency_ms / (double)(count - error)));
+        cJSON_AddItemToArray(array, item);
+    }
+    free(merged);
+    free(keys);
+    return array;
+}
+
+static cJSON *status_json(void)
+{
+    cJSON *array = cJSON_CreateArray();
+    for (int status = 100; status < TOPK_STATUS_MAX; status++)
+    {
+        uint64_t count = atomic_load_explicit(&statuses[status].count, memory_order_relaxed);
+        if (count == 0)
+            continue;
+        uint64_t bytes = atomic_load_explicit(&statuses[status].bytes, memory_order_relaxed);
+        uint64_t latency_ns = atomic_load_explicit(&statuses[status].latency_ns, memory_order_relaxed);
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "status", status);
+        cJSON_AddNumberToObject(item, "requests", (double)count);
+        cJSON_AddNumberToObject(item, "bytes", (double)bytes);
+        cJSON_AddNumberToObject(item, "avg_latency_ms", round_ms((double)latency_ns / 1e6 / (double)count));
+        cJSON_AddItemToArray(array, item);
+    }
+    return array;
+}
+
+char *topk_json(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+        return NULL;
+
+    cJSON_AddNumberToObject(root, "tracked", capacity);
+    cJSON_AddItemToObject(root, "paths", table_json(offsetof(topk_shard_t, paths), "path"));
+    cJSON_AddItemToObject(root, "clients", table_json(offsetof(topk_shard_t, clients), "ip"));
+    cJSON_AddItemToObject(root, "statuses", status_json());
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+/* Call once the recording threads are gone */
+void topk_shutdown(void)
+{
+    capacity = 0;
+    pthread_mutex_lock(&shards_lock);
+    topk_shard_t *shard = shards;
+    shards = NULL;
+    pthread_mutex_unlock(&shards_lock);
+    while (shard)
+    {
+        topk_shard_t *next = shard->next;
+        table_free(&shard->paths);
+        table_free(&shard->clients);
+        pthread_mutex_destroy(&shard->lock);
+        free(shard);
+        shard = next;
+    }
+    thread_shard = NULL;
+}
@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <limits.h>
+
+#include "include/compat.h"
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+#include "include/warmup.h"
+#include "include/http.h"
+#include "include/client.h"
+#include "include/path_cache.h"
+#include "include/settings.h"
+#include "include/logger.h"
+#include "include/access_log.h"
+#include "include/path_match.h"
+
+#define WARMUP_MAX_FILES 65536
+#define WARMUP_MAX_THREADS 64
+
+typedef struct
+{
+    char **paths; /* Absolute, resolved paths to warm */
+    int count;
+    int capacity;
+    _Atomic int next;   /* Next index to hand to a thread */
+    _Atomic int warmed; /* Files whose metadata and contents were loaded */
+    _Atomic int cached; /* Of those, placed in the file cache */
+} warmup_list_t;
+
+static _Atomic bool warmup_running = false;
+
+static bool matches_any(char **patterns, int count, const char *rel_path)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (path_glob_match(patterns[i], rel_path))
+            return true;
+    }
+    return false;
+}
+
+/* Resolve a content-relative path and queue it if it stays inside the
+   content directory */
+static void list_add(warmup_list_t *list, const char *abs_content, const char *rel_path)
+{
+    if (list->count >= WARMUP_MAX_FILES)
+        return;
+
+    char joined[PATH_MAX], resolved[PATH_MAX];
+    if (snprintf(joined, sizeof(joined), "%s/%s", abs_content, rel_path) >= (int)sizeof(joined) ||
+        !realpath(joined, resolved))
+        return;
+
+    size_t root_len = strlen(abs_content);
+    if (strncmp(resolved, abs_content, root_len) != 0 || resolved[root_len] != '/')
+        return;
+
+    if (list->count == list->capacity)
+    {
+        int capacity = list->capacity ? list->capacity * 2 : 256;
+        char **paths = realloc(list->paths, capacity * sizeof(char *));
+        if (!paths)
+            return;
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+
+    char *copy = strdup(resolved);
+    if (copy)
+        list->paths[list->count++] = copy;
+}
+
+/* Collect the files named in a manifest: one content-relative path per
+   line, blank lines and '#' comments ignored */
+static void collect_manifest(warmup_list_t *list, const char *abs_content, const char *manifest)
+{
+    FILE *f = fopen(manifest, "r");
+    if (!f)
+    {
+        log_info("Warm-up manifest could not be opened, skipping it");
+        return;
+    }
+
+    char line[PATH_MAX];
+    while (fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        const char *rel = line;
+        while (*rel == '/')
+            rel++;
+        if (*rel != '\0' && *rel != '#')
+            list_add(list, abs_content, rel);
+    }
+    fclose(f);
+}
+
+/* Recursively collect files under dir (rel is its path relative to the
+   content directory, "" at the root) that match the patterns */
+static void collect_matching(warmup_list_t *list, const char *abs_content, const char *rel,
+                             char **patterns, int pattern_count)
+{
+    char dir[PATH_MAX];
+    if (snprintf(dir, sizeof(dir), "%s%s%s", abs_content, *rel ? "/" : "", rel) >= (int)sizeof(dir))
+        return;
+
+#ifdef _WIN32
+    char search[PATH_MAX];
+    if (snprintf(search, sizeof(search), "%s\\*", dir) >= (int)sizeof(search))
+        return;
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(search, &fd);
+    if (h == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        const char *name = fd.cFileName;
+        bool is_dir = (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+    DIR *d = opendir(dir);
+    if (!d)
+        return;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        const char *name = ent->d_name;
+        char full[PATH_MAX];
+        struct stat st;
+        if (snprintf(full, sizeof(full), "%s/%s", dir, name) >= (int)sizeof(full) || lstat(full, &st) != 0)
+            continue;
+        bool is_dir = S_ISDIR(st.st_mode);
+#endif
+        if (name[0] == '.')
+            continue; /* ".", "..", and hidden files are never served warm */
+
+        char child[PATH_MAX];
+        if (snprintf(child, sizeof(child), "%s%s%s", rel, *rel ? "/" : "", name) >= (int)sizeof(child))
+            continue;
+
+        if (is_dir)
+            collect_matching(list, abs_content, child, patterns, pattern_count);
+        else if (matches_any(patterns, pattern_count, child))
+            list_add(list, abs_content, child);
+#ifdef _WIN32
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
+    }
+    closedir(d);
+#endif
+}
+
+/* Warm one file: metadata into the path cache, small files (with their
+   gzip variant) into the file cache, large ones into the page cache */
+static void warm_file(warmup_list_t *list, const char *path)
+{
+    path_meta_t meta;
+    if (path_cache_lookup(path, &meta) != 0)
+        return;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+
+    cache_entry_t *entry = NULL;
+    if (meta.size <= CACHE_MAX_FILE_SIZE && atomic_load(&list->cached) < CACHE_MAX_ENTRIES)
+        entry = http_cache_file(fd, path, meta.mime, &meta);
+
+    if (entry)
+    {
+        cache_release(entry);
+        atomic_fetch_add(&list->cached, 1);
+    }
+    else
+    {
+#if defined(__linux__)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+    }
+
+    close(fd);
+    atomic_fetch_add(&list->warmed, 1);
+}
+
+static void *warmup_thread(void *arg)
+{
+    warmup_list_t *list = (warmup_list_t *)arg;
+    int i;
+    while ((i = atomic_fetch_add(&list->next, 1)) < list->count)
+        warm_file(list, list->paths[i]);
+    return NULL;
+}
+
+/* Claim the single warm-up slot; false if a run already holds it */
+static bool warmup_claim(void)
+{
+    bool expected = false;
+    return atomic_compare_exchange_strong(&warmup_running, &expected, true);
+}
+
+/* The warm-up itself, run by whoever claimed the slot; releases it */
+static int warmup_run_claimed(const char *content_directory, int num_threads)
+{
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+
+    warmup_list_t list = {0};
+    char abs_content[PATH_MAX];
+    if (realpath(content_directory, abs_content))
+    {
+        const char *manifest = get_warmup_manifest();
+        if (manifest)
+            collect_manifest(&list, abs_content, manifest);
+
+        int pattern_count = 0;
+        char **patterns = get_warmup_patterns(&pattern_count);
+        if (pattern_count > 0)
+            collect_matching(&list, abs_content, "", patterns, pattern_count);
+        free_string_array(patterns, pattern_count);
+    }
+
+    if (num_threads < 1)
+        num_threads = 1;
+    if (num_threads > WARMUP_MAX_THREADS)
+        num_threads = WARMUP_MAX_THREADS;
+    if (num_threads > list.count)
+        num_threads = list.count;
+
+    /* The calling thread takes a share of the work too */
+    pthread_t threads[WARMUP_MAX_THREADS];
+    int started = 0;
+    for (int i = 1; i < num_threads; i++)
+    {
+        if (pthread_create(&threads[started], NULL, warmup_thread, &list) == 0)
+            started++;
+    }
+    warmup_thread(&list);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    gettimeofday(&end, NULL);
+    double elapsed_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_usec - start.tv_usec) / 1000.0;
+
+    int warmed = atomic_load(&list.warmed);
+    char msg[192];
+    snprintf(msg, sizeof(msg), "Warm-up loaded %d files (%d into the file cache) in %.1f ms using %d threads",
+             warmed, atomic_load(&list.cached), elapsed_ms, started + 1);
+    log_info(msg);
+
+    for (int i = 0; i < list.count; i++)
+        free(list.paths[i]);
+    free(list.paths);
+
+    atomic_store(&warmup_running, false);
+    return warmed;
+}
+
+int warmup_run(const char *content_directory, int num_threads)
+{
+    if (!warmup_claim())
+        return -1;
+    return warmup_run_claimed(content_directory, num_threads);
+}
+
+typedef struct
+{
+    char content_directory[PATH_MAX];
+    int num_threads;
+} warmup_args_t;
+
+static void *warmup_async_thread(void *arg)
+{
+    warmup_args_t *args = (warmup_args_t *)arg;
+    warmup_run_claimed(args->content_directory, args->num_threads);
+    free(args);
+    return NULL;
+}
+
+bool warmup_start_async(const char *content_directory, int num_threads)
+{
+    /* Claimed here, not on the new thread, so two concurrent triggers
+       cannot both be told a run was started */
+    if (!warmup_claim())
+        return false;
+
+    warmup_args_t *args = malloc(sizeof(warmup_args_t));
+    if (!args)
+    {
+        atomic_store(&warmup_running, false);
+        return false;
+    }
+    strncpy(args->content_directory, content_directory, sizeof(args->content_directory) - 1);
+    args->content_directory[sizeof(args->content_directory) - 1] = '\0';
+    args->num_threads = num_threads;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, warmup_async_thread, args) != 0)
+    {
+        free(args);
+        atomic_store(&warmup_running, false);
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+void handle_warmup_request(int client_fd, const char *client_ip, const char *method,
+                           const char *path, const char *content_directory)
+{
+    int status;
+    const char *response;
+
+    if (strcmp(client_ip, "127.0.0.1") != 0)
+    {
+        status = 403;
+        response = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n";
+    }
+    else if (strcmp(method, "POST") != 0)
+    {
+        status = 405;
+        response = "HTTP/1.1 405 Method Not Allowed\r\nAllow: POST\r\nContent-Length: 0\r\n\r\n";
+    }
+    else if (!warmup_start_async(content_directory, get_warmup_threads()))
+    {
+        status = 409;
+        response = "HTTP/1.1 409 Conflict\r\nContent-Length: 0\r\n\r\n";
+    }
+    else
+    {
+        status = 202;
+        response = "HTTP/1.1 202 Accepted\r\nContent-Length: 0\r\n\r\n";
+    }
+
+    send_response_header(client_fd, status, response, strlen(response));
+    access_log_request(client_ip, method, path, "HTTP/1.1", status, 0, NULL, NULL);
+}
@@ -56,7 +56,7 @@ static int ip_matches_entry(const char *client_ip, const char *entry)
 
 /* Check if IP address is in whitelist
    Returns 1 if IP is allowed, 0 if not allowed */
-int is_ip_whitelisted(const char *client_ip, char **whitelist_ips, int count)
+int is_ip_whitelisted(const char *client_ip, const char **whitelist_ips, int count)
 {
     if (!client_ip || !whitelist_ips || count <= 0)
         return 0;
@@ -95,7 +95,7 @@ static int path_matches_entry(const char *request_path, const char *entry)
 
 /* Check if file path is whitelisted
    Returns 1 if file is allowed, 0 if not allowed */
-int is_file_whitelisted(const char *request_path, char **whitelist_files, int count)
+int is_file_whitelisted(const char *request_path, const char **whitelist_files, int count)
 {
     if (!request_path || !whitelist_files || count <= 0)
         return 0;
@@ -109,18 +109,17 @@ int is_file_whitelisted(const char *request_path, char **whitelist_files, int co
     return 0;
 }
 
-void handle_whitelist(int client_fd, const char *client_ip, const char *method, const char *path){
+bool handle_whitelist(int client_fd, const char *client_ip, const char *method, const char *path)
+{
     int file_count = 0;
-    char **whitelist_files = get_whitelist_files(&file_count);
+    const char **whitelist_files = get_whitelist_files(request_arena(), &file_count);
 
     if (file_count > 0 && !is_file_whitelisted(path, whitelist_files, file_count))
     {
         send_403(client_fd);
         access_log_request(client_ip, method, path, "HTTP/1.1", 403, 0, NULL, NULL);
-        free_whitelist_entries(whitelist_files, file_count);
-        return;
+        return false;
     }
 
-    if (whitelist_files)
-        free_whitelist_entries(whitelist_files, file_count);
-}
\ No newline at end of file
+    return true;
+}
@@ -0,0 +1,23 @@
+/* Minimal assertions for the tests/check_*.c programs. A failed CHECK
+   reports its location and the check carries on, so one run lists every
+   failure; main() returns CHECK_RESULT(). */
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+static int check_failures;
+
+#define CHECK(cond)                                                              \
+    do                                                                           \
+    {                                                                            \
+        if (!(cond))                                                             \
+        {                                                                        \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            check_failures++;                                                    \
+        }                                                                        \
+    } while (0)
+
+#define CHECK_RESULT() (check_failures == 0 ? 0 : 1)
+
+#endif
@@ -0,0 +1,129 @@
+/* check_admission: when admission control sheds. The queue depth limit,
+   an overload episode entered after a whole interval of slow dequeues,
+   and each way out of it: a fast dequeue, a drained queue, or an interval
+   with no slow dequeue at all. Then the 503 itself, over a socketpair. */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "check.h"
+#include "admission.h"
+#include "metrics.h"
+
+#define TARGET_MS 5
+#define INTERVAL_MS 100
+#define SLOW_US (TARGET_MS * 1000 * 2)
+#define FAST_US (TARGET_MS * 1000 / 2)
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/* A fresh episode of slow dequeues spanning a whole interval, the last
+   one ago_us ago */
+static void overload(uint64_t ago_us)
+{
+    uint64_t now = now_us();
+    admission_record_wait(FAST_US, now - ago_us - INTERVAL_MS * 1000);
+    admission_record_wait(SLOW_US, now - ago_us - INTERVAL_MS * 1000);
+    admission_record_wait(SLOW_US, now - ago_us);
+}
+
+static void check_queue_depth(void)
+{
+    admission_init(10, 0, INTERVAL_MS, 1);
+    CHECK(!admission_should_shed(0));
+    CHECK(!admission_should_shed(9));
+    CHECK(admission_should_shed(10));
+
+    /* No wait target: slow dequeues never shed */
+    overload(0);
+    CHECK(!admission_should_shed(5));
+}
+
+static void check_overload(void)
+{
+    admission_init(0, TARGET_MS, INTERVAL_MS, 1);
+    CHECK(!admission_should_shed(1000));
+
+    /* Slow, but not yet for a whole interval */
+    uint64_t now = now_us();
+    admission_record_wait(SLOW_US, now - INTERVAL_MS * 1000 / 2);
+    admission_record_wait(SLOW_US, now);
+    CHECK(!admission_should_shed(5));
+
+    /* One fast dequeue restarts the interval */
+    admission_record_wait(FAST_US, now);
+    admission_record_wait(SLOW_US, now);
+    CHECK(!admission_should_shed(5));
+
+    /* A slow dequeue stamped before the episode began (workers read the
+       clock themselves) does not complete the interval */
+    admission_record_wait(SLOW_US, now - 1);
+    CHECK(!admission_should_shed(5));
+
+    overload(0);
+    CHECK(admission_should_shed(5));
+    CHECK(admission_should_shed(5));
+
+    /* Ended by a fast dequeue */
+    admission_record_wait(FAST_US, now_us());
+    CHECK(!admission_should_shed(5));
+
+    /* Ended by a drained queue, and stays ended */
+    overload(0);
+    CHECK(admission_should_shed(5));
+    CHECK(!admission_should_shed(0));
+    CHECK(!admission_should_shed(5));
+
+    /* Ended when no slow dequeue has been seen for an interval */
+    overload(INTERVAL_MS * 1000 * 2);
+    CHECK(!admission_should_shed(5));
+    CHECK(!admission_should_shed(5));
+}
+
+static void check_reject(void)
+{
+    admission_init(1, 0, INTERVAL_MS, 7);
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        CHECK(!"socketpair");
+        return;
+    }
+    send(fds[0], "GET / HTTP/1.1\r\n\r\n", 18, 0);
+
+    unsigned long shed = metrics_get().shed_connections;
+    admission_reject(fds[1]);
+    CHECK(metrics_get().shed_connections == shed + 1);
+
+    char response[512];
+    size_t len = 0;
+    ssize_t n;
+    while (len < sizeof(response) - 1 && (n = recv(fds[0], response + len, sizeof(response) - 1 - len, 0)) > 0)
+        len += (size_t)n;
+    response[len] = '\0';
+    close(fds[0]);
+
+    CHECK(strncmp(response, "HTTP/1.1 503 Service Unavailable\r\n", 34) == 0);
+    CHECK(strstr(response, "\r\nRetry-After: 7\r\n") != NULL);
+    CHECK(strstr(response, "\r\nConnection: close\r\n") != NULL);
+    const char *body = strstr(response, "\r\n\r\n");
+    CHECK(body && strcmp(body + 4, "Service Unavailable") == 0);
+}
+
+int main(void)
+{
+    metrics_init();
+    check_queue_depth();
+    check_overload();
+    check_reject();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,244 @@
+/* check_bundle: mapping, validation and hot swaps of content bundles.
+   Malformed files are refused; lookups find every entry and nothing
+   else; a bundle renamed over the path is picked up by the watcher while
+   readers keep taking references, and a reference taken before the swap
+   stays readable until it is released. A malformed replacement leaves
+   the current bundle in place. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "bundle.h"
+
+#define ENTRY_COUNT 3
+#define READERS 4
+#define SWAP_WAIT_MS 5000 /* Well over the watcher's check interval */
+#define NO_SWAP_WAIT_MS 1500 /* Long enough for at least one check */
+
+static char base[] = "/tmp/check_bundle.XXXXXX";
+static char bundle_path[sizeof(base) + 16];
+static char next_path[sizeof(base) + 16];
+
+static const char *paths[ENTRY_COUNT] = {"/a.css", "/index.html", "/z/last.js"};
+
+typedef enum
+{
+    BUNDLE_OK,
+    BAD_MAGIC,
+    BAD_VERSION,
+    BAD_TOTAL_SIZE,
+    BAD_PAYLOAD,
+    BAD_STRINGS,
+    TRUNCATED
+} bundle_fault_t;
+
+/* Write a bundle whose payload for each path is "<tag>:<path>" */
+static bool write_bundle(const char *file, const char *tag, bundle_fault_t fault)
+{
+    char strings[512], payloads[512];
+    size_t strings_size = 0, payloads_size = 0;
+    bundle_entry_t entries[ENTRY_COUNT];
+    memset(entries, 0, sizeof(entries));
+
+    size_t payload_base = sizeof(bundle_header_t) + sizeof(entries);
+    for (int i = 0; i < ENTRY_COUNT; i++)
+    {
+        entries[i].path = (uint32_t)strings_size;
+        strings_size += (size_t)sprintf(strings + strings_size, "%s", paths[i]) + 1;
+        entries[i].mime = (uint32_t)strings_size;
+        strings_size += (size_t)sprintf(strings + strings_size, "text/plain") + 1;
+        entries[i].etag = (uint32_t)strings_size;
+        strings_size += (size_t)sprintf(strings + strings_size, "\"%s-%d\"", tag, i) + 1;
+        entries[i].mtime = 1700000000;
+    }
+    payload_base += strings_size;
+    for (int i = 0; i < ENTRY_COUNT; i++)
+    {
+        int len = sprintf(payloads + payloads_size, "%s:%s", tag, paths[i]);
+        entries[i].data_offset = payload_base + payloads_size;
+        entries[i].data_size = (uint64_t)len;
+        payloads_size += (size_t)len;
+    }
+
+    bundle_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.entry_count = ENTRY_COUNT;
+    header.index_offset = sizeof(header);
+    header.strings_offset = sizeof(header) + sizeof(entries);
+    header.strings_size = strings_size;
+    header.total_size = payload_base + payloads_size;
+
+    if (fault == BAD_MAGIC)
+        header.magic[0] = 'X';
+    else if (fault == BAD_VERSION)
+        header.version = BUNDLE_VERSION + 1;
+    else if (fault == BAD_TOTAL_SIZE)
+        header.total_size++;
+    else if (fault == BAD_PAYLOAD)
+        entries[1].data_size = header.total_size;
+    else if (fault == BAD_STRINGS)
+        strings[strings_size - 1] = 'x';
+
+    FILE *f = fopen(file, "wb");
+    if (!f)
+        return false;
+    if (fault == TRUNCATED)
+        fwrite(&header, 1, sizeof(header) / 2, f);
+    else
+    {
+        fwrite(&header, 1, sizeof(header), f);
+        fwrite(entries, 1, sizeof(entries), f);
+        fwrite(strings, 1, strings_size, f);
+        fwrite(payloads, 1, payloads_size, f);
+    }
+    return fclose(f) == 0;
+}
+
+/* Whether bundle serves path with the payload written under tag */
+static bool serves(const bundle_t *bundle, const char *path, const char *tag)
+{
+    const bundle_entry_t *entry = bundle_find(bundle, path);
+    if (!entry)
+        return false;
+    char expected[128];
+    int len = snprintf(expected, sizeof(expected), "%s:%s", tag, path);
+    return entry->data_size == (uint64_t)len &&
+           memcmp(bundle_payload(bundle, entry->data_offset), expected, (size_t)len) == 0 &&
+           strcmp(bundle_string(bundle, entry->mime), "text/plain") == 0;
+}
+
+/* Rename a new bundle over the served one, as a deploy does */
+static void deploy(const char *tag, bundle_fault_t fault)
+{
+    write_bundle(next_path, tag, fault);
+    rename(next_path, bundle_path);
+}
+
+/* Wait up to wait_ms for the watcher to switch to the bundle written
+   under tag */
+static bool wait_for(const char *tag, int wait_ms)
+{
+    for (int waited = 0; waited < wait_ms; waited += 10)
+    {
+        bundle_t *bundle = bundle_acquire();
+        bool swapped = bundle && serves(bundle, paths[0], tag);
+        bundle_release(bundle);
+        if (swapped)
+            return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+static void check_invalid(void)
+{
+    bundle_fault_t faults[] = {BAD_MAGIC, BAD_VERSION, BAD_TOTAL_SIZE, BAD_PAYLOAD, BAD_STRINGS, TRUNCATED};
+    for (size_t i = 0; i < sizeof(faults) / sizeof(faults[0]); i++)
+    {
+        CHECK(write_bundle(bundle_path, "bad", faults[i]));
+        CHECK(bundle_open(bundle_path) == -1);
+    }
+    CHECK(bundle_open(next_path) == -1); /* Missing */
+    CHECK(!bundle_enabled());
+    CHECK(bundle_acquire() == NULL);
+}
+
+static void check_lookup(void)
+{
+    bundle_t *bundle = bundle_acquire();
+    CHECK(bundle != NULL);
+    if (!bundle)
+        return;
+    for (int i = 0; i < ENTRY_COUNT; i++)
+        CHECK(serves(bundle, paths[i], "v1"));
+    CHECK(bundle_find(bundle, "/") == NULL);
+    CHECK(bundle_find(bundle, "/a.cs") == NULL);
+    CHECK(bundle_find(bundle, "/b.css") == NULL);
+    CHECK(bundle_find(bundle, "/zz") == NULL);
+    const bundle_entry_t *entry = bundle_find(bundle, "/index.html");
+    CHECK(entry && strcmp(bundle_string(bundle, entry->etag), "\"v1-1\"") == 0 && entry->gzip_size == 0);
+    bundle_release(bundle);
+}
+
+static _Atomic bool readers_stop;
+static _Atomic unsigned long reads_done;
+static _Atomic unsigned long reads_wrong;
+
+/* A request's use of the bundle: take it, look up, read, release */
+static void *reader(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&readers_stop))
+    {
+        bundle_t *bundle = bundle_acquire();
+        bool ok = bundle && (serves(bundle, paths[2], "v2") || serves(bundle, paths[2], "v3"));
+        bundle_release(bundle);
+        atomic_fetch_add(&reads_done, 1);
+        if (!ok)
+            atomic_fetch_add(&reads_wrong, 1);
+    }
+    return NULL;
+}
+
+static void check_swaps(void)
+{
+    bundle_t *old = bundle_acquire();
+
+    deploy("v2", BUNDLE_OK);
+    CHECK(wait_for("v2", SWAP_WAIT_MS));
+
+    /* The reference taken before the swap still reads the old mapping */
+    CHECK(old && serves(old, paths[1], "v1"));
+    bundle_release(old);
+
+    /* A malformed replacement is not switched to */
+    deploy("v9", BAD_PAYLOAD);
+    CHECK(!wait_for("v9", NO_SWAP_WAIT_MS));
+
+    /* Swapping under concurrent readers */
+    pthread_t threads[READERS];
+    for (int i = 0; i < READERS; i++)
+        pthread_create(&threads[i], NULL, reader, NULL);
+    deploy("v3", BUNDLE_OK);
+    CHECK(wait_for("v3", SWAP_WAIT_MS));
+    atomic_store(&readers_stop, true);
+    for (int i = 0; i < READERS; i++)
+        pthread_join(threads[i], NULL);
+    CHECK(atomic_load(&reads_done) > 0);
+    CHECK(atomic_load(&reads_wrong) == 0);
+}
+
+int main(void)
+{
+    if (!mkdtemp(base))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(bundle_path, sizeof(bundle_path), "%s/site.bundle", base);
+    snprintf(next_path, sizeof(next_path), "%s/site.next", base);
+
+    check_invalid();
+
+    CHECK(write_bundle(bundle_path, "v1", BUNDLE_OK));
+    CHECK(bundle_open(bundle_path) == 0);
+    CHECK(bundle_enabled());
+    check_lookup();
+    check_swaps();
+
+    bundle_close();
+    CHECK(bundle_acquire() == NULL);
+
+    unlink(bundle_path);
+    unlink(next_path);
+    rmdir(base);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,94 @@
+/* check_cache_policy: which file names cache_policy_resolve() takes as
+   content-hashed (and so immutable) with "cache-immutable-hashed-names",
+   and that other names fall through to the "cache-policies" globs. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "cache_policy.h"
+#include "settings.h"
+
+static char root[] = "/tmp/check_cache_policy.XXXXXX";
+static char config[sizeof(root) + 16];
+
+static bool immutable(const char *path)
+{
+    const char *value = cache_policy_resolve(path);
+    return value && strcmp(value, CACHE_CONTROL_IMMUTABLE) == 0;
+}
+
+static void check_hashed_names(void)
+{
+    CHECK(immutable("/app.3f2a9c1b.js"));
+    CHECK(immutable("/assets/app-3f2a9c1b.css"));
+    CHECK(immutable("/chunk.0123456789abcdef.min.js"));
+    CHECK(immutable("/app.3F2A9C1B.js"));
+    CHECK(immutable("/a.b.3f2a9c1b.js"));
+
+    char absolute[sizeof(root) + 32];
+    snprintf(absolute, sizeof(absolute), "%s/app.3f2a9c1b.js", root);
+    CHECK(immutable(absolute));
+}
+
+static void check_plain_names(void)
+{
+    /* Too short, or no digit, or no letter: words, dates and counters */
+    CHECK(!immutable("/app.3f2a9c1.js"));
+    CHECK(!immutable("/deadbeef.html"));
+    CHECK(!immutable("/app.deadbeef.js"));
+    CHECK(!immutable("/report-20240101.pdf"));
+    CHECK(!immutable("/img-12345678.png"));
+
+    /* Not all hex digits */
+    CHECK(!immutable("/iPhone15Pro.png"));
+    CHECK(!immutable("/app.3f2a9c1g.js"));
+    CHECK(!immutable("/Screenshot_2024abcd.png"));
+
+    /* The first token is the name itself, and the extension is not a token */
+    CHECK(!immutable("/3f2a9c1b.js"));
+    CHECK(!immutable("/app.3f2a9c1b"));
+
+    /* Only the file name counts, not directories */
+    CHECK(!immutable("/build-3f2a9c1b/app.js"));
+}
+
+static void check_fallthrough(void)
+{
+    const char *value = cache_policy_resolve("/index.html");
+    CHECK(value && strcmp(value, "no-cache") == 0);
+    CHECK(cache_policy_resolve("/style.css") == NULL);
+}
+
+int main(void)
+{
+    if (!mkdtemp(root))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(config, sizeof(config), "%s/config.json", root);
+    FILE *f = fopen(config, "w");
+    if (!f)
+    {
+        perror(config);
+        return 1;
+    }
+    fputs("{\"cache-immutable-hashed-names\": true,"
+          " \"cache-policies\": {\"*.html\": \"no-cache\"}}\n",
+          f);
+    fclose(f);
+
+    set_config_path(config);
+    cache_policy_init(root);
+
+    check_hashed_names();
+    check_plain_names();
+    check_fallthrough();
+
+    unlink(config);
+    rmdir(root);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,248 @@
+/* check_compress_pool: chunked gzip responses from the compression pool.
+   The body, de-chunked and inflated, must be the file; HEAD must get the
+   GET's headers; a file shorter than announced still ends in a valid
+   stream; and a saturated pool must refuse a job, leaving its fds to the
+   caller. Responses are read from the other end of a socketpair. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <zlib.h>
+#include <sys/socket.h>
+
+#include "check.h"
+#include "compress_pool.h"
+#include "io_buffer.h"
+
+#define FILE_SIZE (3 * 1024 * 1024) /* Compresses to more than a socket buffer */
+
+static char base[] = "/tmp/check_compress_pool.XXXXXX";
+static char file_path[sizeof(base) + 16];
+static char *data;
+
+typedef struct
+{
+    char *bytes;
+    size_t len;
+} response_t;
+
+/* Text that compresses only so far: words from a small alphabet */
+static void make_data(void)
+{
+    data = malloc(FILE_SIZE);
+    uint64_t state = 1;
+    for (size_t i = 0; i < FILE_SIZE; i++)
+    {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        data[i] = (i % 64 == 63) ? '\n' : "abcdefghijklmnop"[(state >> 33) & 15];
+    }
+    FILE *f = fopen(file_path, "wb");
+    if (f)
+    {
+        fwrite(data, 1, FILE_SIZE, f);
+        fclose(f);
+    }
+}
+
+static compress_job_t make_job(int client_fd, off_t size)
+{
+    compress_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.client_fd = client_fd;
+    job.file_fd = open(file_path, O_RDONLY);
+    job.size = size;
+    job.mime = "text/plain";
+    snprintf(job.etag, sizeof(job.etag), "\"1-2-3-gz\"");
+    job.last_modified = 1700000000;
+    job.cache_control = "no-cache";
+    return job;
+}
+
+/* Everything the pool sends until it closes the connection */
+static response_t read_all(int fd)
+{
+    response_t r = {NULL, 0};
+    size_t capacity = 0;
+    for (;;)
+    {
+        if (r.len + 65536 > capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1 << 20;
+            r.bytes = realloc(r.bytes, capacity + 1);
+        }
+        ssize_t n = recv(fd, r.bytes + r.len, capacity - r.len, 0);
+        if (n <= 0)
+            break;
+        r.len += (size_t)n;
+    }
+    r.bytes[r.len] = '\0';
+    close(fd);
+    return r;
+}
+
+/* De-chunk and inflate a response body; true if it is expected[0..len) */
+static bool body_is(const response_t *r, const char *expected, size_t len)
+{
+    const char *end = r->bytes + r->len;
+    const char *p = strstr(r->bytes, "\r\n\r\n");
+    if (!p)
+        return false;
+    p += 4;
+
+    size_t gz_len = 0;
+    char *gz = malloc(r->len);
+    for (;;)
+    {
+        char *line_end;
+        unsigned long size = strtoul(p, &line_end, 16);
+        if (line_end == p || line_end + 2 > end || memcmp(line_end, "\r\n", 2) != 0)
+        {
+            free(gz);
+            return false;
+        }
+        p = line_end + 2;
+        if (size == 0)
+            break;
+        if (p + size + 2 > end)
+        {
+            free(gz);
+            return false;
+        }
+        memcpy(gz + gz_len, p, size);
+        gz_len += size;
+        p += size + 2;
+    }
+
+    char *out = malloc(len + 1);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    inflateInit2(&zs, 15 + 16);
+    zs.next_in = (unsigned char *)gz;
+    zs.avail_in = (uInt)gz_len;
+    zs.next_out = (unsigned char *)out;
+    zs.avail_out = (uInt)len + 1;
+    int ret = inflate(&zs, Z_FINISH);
+    bool ok = ret == Z_STREAM_END && zs.total_out == len && memcmp(out, expected, len) == 0;
+    inflateEnd(&zs);
+    free(out);
+    free(gz);
+    return ok && p + 2 == end;
+}
+
+static bool has_header(const response_t *r, const char *line)
+{
+    const char *headers_end = strstr(r->bytes, "\r\n\r\n");
+    const char *found = strstr(r->bytes, line);
+    return found && headers_end && found < headers_end;
+}
+
+static void check_get_and_saturation(void)
+{
+    int a[2], b[2], c[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, a);
+    socketpair(AF_UNIX, SOCK_STREAM, 0, b);
+    socketpair(AF_UNIX, SOCK_STREAM, 0, c);
+
+    /* The one thread takes the first job and blocks on the unread socket */
+    compress_job_t job_a = make_job(a[1], FILE_SIZE);
+    CHECK(compress_pool_submit(&job_a));
+    char peek;
+    recv(a[0], &peek, 1, MSG_PEEK);
+
+    compress_job_t job_b = make_job(b[1], FILE_SIZE / 3);
+    CHECK(compress_pool_submit(&job_b));
+
+    /* Thread busy, waiting room full: refused, and the fds are still ours */
+    compress_job_t job_c = make_job(c[1], FILE_SIZE);
+    CHECK(!compress_pool_submit(&job_c));
+    CHECK(fcntl(job_c.file_fd, F_GETFD) != -1 && fcntl(c[1], F_GETFD) != -1);
+    close(job_c.file_fd);
+    close(c[0]);
+    close(c[1]);
+
+    response_t r = read_all(a[0]);
+    CHECK(strncmp(r.bytes, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    CHECK(has_header(&r, "\r\nContent-Encoding: gzip\r\n"));
+    CHECK(has_header(&r, "\r\nTransfer-Encoding: chunked\r\n"));
+    CHECK(has_header(&r, "\r\nVary: Accept-Encoding\r\n"));
+    CHECK(has_header(&r, "\r\nETag: \"1-2-3-gz\"\r\n"));
+    CHECK(has_header(&r, "\r\nCache-Control: no-cache\r\n"));
+    CHECK(has_header(&r, "\r\nConnection: close\r\n"));
+    CHECK(!has_header(&r, "Content-Length"));
+    CHECK(body_is(&r, data, FILE_SIZE));
+    free(r.bytes);
+
+    r = read_all(b[0]);
+    CHECK(body_is(&r, data, FILE_SIZE / 3));
+    free(r.bytes);
+}
+
+/* The file is shorter than the job says (truncated after the stat) */
+static void check_short_file(void)
+{
+    int s[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, s);
+    compress_job_t job = make_job(s[1], FILE_SIZE + 12345);
+    CHECK(compress_pool_submit(&job));
+    response_t r = read_all(s[0]);
+    CHECK(body_is(&r, data, FILE_SIZE));
+    free(r.bytes);
+}
+
+static void check_head(void)
+{
+    int get[2], head[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, get);
+    socketpair(AF_UNIX, SOCK_STREAM, 0, head);
+
+    compress_job_t job = make_job(get[1], 100);
+    CHECK(compress_pool_submit(&job));
+    response_t get_r = read_all(get[0]);
+
+    compress_job_t head_job = make_job(head[1], 100);
+    close(head_job.file_fd);
+    CHECK(compress_pool_send_head(&head_job, true) == 0);
+    close(head[1]);
+    response_t head_r = read_all(head[0]);
+
+    /* The same headers but for the connection, and no body */
+    const char *get_end = strstr(get_r.bytes, "\r\n\r\n");
+    CHECK(get_end && head_r.len == (size_t)(get_end - get_r.bytes) + 4 + strlen("keep-alive") - strlen("close"));
+    const char *conn = strstr(get_r.bytes, "Connection: close");
+    CHECK(conn && strncmp(head_r.bytes, get_r.bytes, (size_t)(conn - get_r.bytes)) == 0);
+    CHECK(has_header(&head_r, "\r\nConnection: keep-alive\r\n"));
+    free(get_r.bytes);
+    free(head_r.bytes);
+}
+
+int main(void)
+{
+    if (!mkdtemp(base))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(file_path, sizeof(file_path), "%s/big.txt", base);
+    make_data();
+    alarm(60); /* A stuck pool would otherwise hang the run */
+
+    io_buffer_pool_init(IO_BUFFER_DEFAULT_SIZE, 4, false);
+    compress_pool_init(1, 1);
+    CHECK(compress_pool_enabled());
+
+    check_get_and_saturation();
+    check_short_file();
+    check_head();
+
+    compress_pool_shutdown();
+    CHECK(!compress_pool_enabled());
+    io_buffer_pool_shutdown();
+
+    free(data);
+    unlink(file_path);
+    rmdir(base);
+    return CHECK_RESULT();
+}
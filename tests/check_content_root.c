@@ -0,0 +1,245 @@
+/* check_content_root: content_open() must never resolve outside the
+   content root and must only hand out regular files and directories.
+
+   The cases run twice where the kernel allows it: with openat2
+   (RESOLVE_BENEATH), then with openat2 filtered out by seccomp, as a
+   container policy would, so the component-by-component fallback is
+   covered too. The two differ only in what they accept inside the root:
+   openat2 follows symlinks and ".." that stay beneath it, the fallback
+   refuses both. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#endif
+
+#include "check.h"
+#include "content_root.h"
+
+static char base[] = "/tmp/check_content_root.XXXXXX";
+static char path_buf[8][PATH_MAX];
+
+/* base/<rel> in one of a few rotating buffers */
+static const char *at(const char *rel)
+{
+    static int next;
+    char *buf = path_buf[next++ % 8];
+    snprintf(buf, PATH_MAX, "%s/%s", base, rel);
+    return buf;
+}
+
+static void make_file(const char *rel, const char *content)
+{
+    FILE *f = fopen(at(rel), "w");
+    if (f)
+    {
+        fputs(content, f);
+        fclose(f);
+    }
+}
+
+static void make_tree(void)
+{
+    mkdir(at("root"), 0755);
+    mkdir(at("root/sub"), 0755);
+    mkdir(at("outside_dir"), 0755);
+    make_file("root/file.txt", "inside\n");
+    make_file("root/sub/inner.txt", "inner\n");
+    make_file("outside.txt", "outside\n");
+    make_file("outside_dir/secret.txt", "secret\n");
+    mkfifo(at("root/fifo"), 0644);
+    mkfifo(at("outside_fifo"), 0644);
+    symlink("file.txt", at("root/inside_link"));
+    symlink("../outside.txt", at("root/escape_link"));
+    symlink(at("outside.txt"), at("root/absolute_link"));
+    symlink("../outside_dir", at("root/escape_dir"));
+    symlink("/proc/self/root/etc/passwd", at("root/proc_link"));
+}
+
+static void remove_tree(void)
+{
+    const char *entries[] = {"root/proc_link", "root/escape_dir", "root/absolute_link", "root/escape_link",
+                             "root/inside_link", "root/fifo", "root/sub/inner.txt", "root/file.txt",
+                             "outside_fifo", "outside_dir/secret.txt", "outside.txt"};
+    for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++)
+        unlink(at(entries[i]));
+    rmdir(at("root/sub"));
+    rmdir(at("root"));
+    rmdir(at("outside_dir"));
+    rmdir(base);
+}
+
+/* content_open(rel) succeeds with a file of the given type and size */
+static bool opens(const char *rel, mode_t type, off_t size)
+{
+    struct stat st;
+    int fd = content_open(rel, &st);
+    if (fd < 0)
+        return false;
+    close(fd);
+    return (st.st_mode & S_IFMT) == type && (type != S_IFREG || st.st_size == size);
+}
+
+/* content_open(rel) fails with one of the given errnos */
+static bool refused(const char *rel, int err1, int err2)
+{
+    struct stat st;
+    errno = 0;
+    int fd = content_open(rel, &st);
+    if (fd >= 0)
+    {
+        close(fd);
+        return false;
+    }
+    return errno == err1 || errno == err2;
+}
+
+static void check_common(void)
+{
+    CHECK(opens("file.txt", S_IFREG, 7));
+    CHECK(opens("/file.txt", S_IFREG, 7));
+    CHECK(opens("sub/inner.txt", S_IFREG, 6));
+    CHECK(opens("./sub//inner.txt", S_IFREG, 6));
+    CHECK(opens("", S_IFDIR, 0));
+    CHECK(opens("sub", S_IFDIR, 0));
+
+    CHECK(refused("missing", ENOENT, ENOENT));
+    CHECK(refused("sub/missing.txt", ENOENT, ENOENT));
+    CHECK(refused("file.txt/x", ENOTDIR, ENOTDIR));
+
+    /* Leaving the root: openat2 says EXDEV, the walk EXDEV or ELOOP */
+    CHECK(refused("..", EXDEV, EXDEV));
+    CHECK(refused("../outside.txt", EXDEV, EXDEV));
+    CHECK(refused("sub/../../outside.txt", EXDEV, EXDEV));
+    CHECK(refused("escape_link", EXDEV, ELOOP));
+    CHECK(refused("absolute_link", EXDEV, ELOOP));
+    CHECK(refused("escape_dir/secret.txt", EXDEV, ELOOP));
+    CHECK(refused("proc_link", EXDEV, ELOOP));
+
+    /* Not a regular file or directory, and the open must not block */
+    CHECK(refused("fifo", EACCES, EACCES));
+}
+
+static void check_open_path(void)
+{
+    struct stat st;
+    int fd = content_open_path(at("root/file.txt"), &st);
+    CHECK(fd >= 0 && st.st_size == 7);
+    if (fd >= 0)
+        close(fd);
+
+    /* Under the root it is resolved beneath it */
+    errno = 0;
+    fd = content_open_path(at("root/../outside.txt"), &st);
+    CHECK(fd < 0 && errno == EXDEV);
+    fd = content_open_path(at("root/escape_link"), &st);
+    CHECK(fd < 0);
+
+    /* Elsewhere it is opened directly, with the same file type check */
+    fd = content_open_path(at("outside.txt"), &st);
+    CHECK(fd >= 0 && st.st_size == 8);
+    if (fd >= 0)
+        close(fd);
+    errno = 0;
+    fd = content_open_path(at("outside_fifo"), &st);
+    CHECK(fd < 0 && errno == EACCES);
+}
+
+/* What openat2 accepts and the walk refuses */
+static void check_inside_links(bool beneath)
+{
+    if (beneath)
+    {
+        CHECK(opens("inside_link", S_IFREG, 7));
+        CHECK(opens("sub/../file.txt", S_IFREG, 7));
+    }
+    else
+    {
+        CHECK(refused("inside_link", ELOOP, ELOOP));
+        CHECK(refused("sub/../file.txt", EXDEV, EXDEV));
+    }
+}
+
+#if defined(__linux__) && defined(SYS_openat2)
+static bool have_openat2(void)
+{
+    return syscall(SYS_openat2, -1, "", NULL, 0) < 0 && errno != ENOSYS;
+}
+
+/* Make openat2 fail with ENOSYS for the rest of the process */
+static bool filter_openat2(void)
+{
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SYS_openat2, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+    struct sock_fprog prog = {.len = sizeof(filter) / sizeof(filter[0]), .filter = filter};
+    return prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0 &&
+           prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) == 0;
+}
+#else
+static bool have_openat2(void)
+{
+    return false;
+}
+
+static bool filter_openat2(void)
+{
+    return true;
+}
+#endif
+
+int main(void)
+{
+    if (!mkdtemp(base))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    alarm(30); /* A blocking FIFO open would otherwise hang the run */
+    make_tree();
+    if (content_root_open(at("root")) != 0)
+    {
+        remove_tree();
+        return 1;
+    }
+
+    if (have_openat2())
+    {
+        check_common();
+        check_open_path();
+        check_inside_links(true);
+    }
+    else
+    {
+        printf("openat2 not available, checking the fallback only\n");
+    }
+
+    if (filter_openat2())
+    {
+        check_common();
+        check_open_path();
+        check_inside_links(false);
+    }
+    else
+    {
+        printf("could not filter openat2 (%s), fallback not checked\n", strerror(errno));
+    }
+
+    content_root_close();
+    remove_tree();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,176 @@
+/* check_fd_cache: shared descriptors and when they are not trusted. A hot
+   file is opened once; a rewrite in place is reopened on the next use,
+   while handles already given out stay valid; a file replaced by rename
+   is picked up after FD_CACHE_TTL; directories are never kept; errors
+   come back as content_open() reports them. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "check.h"
+#include "fd_cache.h"
+#include "content_root.h"
+#include "metrics.h"
+
+static char base[] = "/tmp/check_fd_cache.XXXXXX";
+static char path_buf[8][PATH_MAX];
+
+/* base/<rel> in one of a few rotating buffers */
+static const char *at(const char *rel)
+{
+    static int next;
+    char *buf = path_buf[next++ % 8];
+    snprintf(buf, PATH_MAX, "%s/%s", base, rel);
+    return buf;
+}
+
+static void write_file(const char *rel, const char *content, time_t mtime)
+{
+    /* In place: the inode stays the same */
+    int fd = open(at(rel), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+    if (write(fd, content, strlen(content)) < 0)
+        perror("write");
+    struct timespec times[2] = {{mtime, 0}, {mtime, 0}};
+    futimens(fd, times);
+    close(fd);
+}
+
+/* The handle's bytes, read the way the server does (at an offset) */
+static bool reads(const fd_handle_t *handle, const char *content)
+{
+    char buf[64];
+    ssize_t n = pread(handle->fd, buf, sizeof(buf) - 1, 0);
+    if (n < 0)
+        return false;
+    buf[n] = '\0';
+    return strcmp(buf, content) == 0 && handle->st.st_size == (off_t)strlen(content);
+}
+
+/* Entries age in whole seconds: start where a second has just begun, so
+   a check that expects a hit is not crossing into the next one */
+static void new_second(void)
+{
+    time_t start = time(NULL);
+    while (time(NULL) == start)
+        usleep(1000);
+}
+
+static void check_sharing(void)
+{
+    new_second();
+    metrics_t before = metrics_get();
+    fd_handle_t *a = fd_cache_open("hot.txt");
+    fd_handle_t *b = fd_cache_open("/hot.txt");
+    CHECK(a && b && a == b && a->fd == b->fd);
+    CHECK(a && reads(a, "first"));
+    metrics_t after = metrics_get();
+    CHECK(after.fd_cache_misses == before.fd_cache_misses + 1);
+    CHECK(after.fd_cache_hits == before.fd_cache_hits + 1);
+    fd_cache_release(a);
+    fd_cache_release(b);
+}
+
+static void check_rewrite_in_place(void)
+{
+    fd_handle_t *old = fd_cache_open("hot.txt");
+    CHECK(old && reads(old, "first"));
+
+    /* New size */
+    write_file("root/hot.txt", "second!", 1700000001);
+    fd_handle_t *fresh = fd_cache_open("hot.txt");
+    CHECK(fresh && fresh != old && reads(fresh, "second!"));
+
+    /* Same size, new mtime */
+    write_file("root/hot.txt", "third!!", 1700000002);
+    fd_handle_t *third = fd_cache_open("hot.txt");
+    CHECK(third && third != fresh && reads(third, "third!!"));
+    CHECK(third && third->st.st_mtime == 1700000002);
+
+    /* Handles already out keep their descriptor until released */
+    CHECK(old && fcntl(old->fd, F_GETFD) != -1);
+    fd_cache_release(old);
+    fd_cache_release(fresh);
+    fd_cache_release(third);
+}
+
+static void check_rename(void)
+{
+    new_second();
+    fd_handle_t *before = fd_cache_open("swap.txt");
+    CHECK(before && reads(before, "old"));
+
+    write_file("root/swap.new", "new", 1700000000);
+    rename(at("root/swap.new"), at("root/swap.txt"));
+
+    /* Same size and mtime on the old inode: trusted until the TTL */
+    fd_handle_t *cached = fd_cache_open("swap.txt");
+    CHECK(cached == before);
+    fd_cache_release(cached);
+
+    sleep(FD_CACHE_TTL + 1);
+    fd_handle_t *after = fd_cache_open("swap.txt");
+    CHECK(after && after != before && reads(after, "new"));
+    CHECK(before && reads(before, "old"));
+    fd_cache_release(before);
+    fd_cache_release(after);
+}
+
+static void check_uncached(void)
+{
+    fd_handle_t *a = fd_cache_open("dir");
+    fd_handle_t *b = fd_cache_open("dir");
+    CHECK(a && b && a != b && S_ISDIR(a->st.st_mode));
+    fd_cache_release(a);
+    fd_cache_release(b);
+
+    errno = 0;
+    CHECK(fd_cache_open("missing.txt") == NULL && errno == ENOENT);
+    errno = 0;
+    CHECK(fd_cache_open("../outside.txt") == NULL && errno == EXDEV);
+    errno = 0;
+    CHECK(fd_cache_open("fifo") == NULL && errno == EACCES);
+}
+
+int main(void)
+{
+    if (!mkdtemp(base))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    mkdir(at("root"), 0755);
+    mkdir(at("root/dir"), 0755);
+    write_file("root/hot.txt", "first", 1700000000);
+    write_file("root/swap.txt", "old", 1700000000);
+    write_file("outside.txt", "outside", 1700000000);
+    mkfifo(at("root/fifo"), 0644);
+    alarm(30); /* A blocking FIFO open would otherwise hang the run */
+
+    metrics_init();
+    fd_cache_init(16);
+    if (content_root_open(at("root")) != 0)
+        return 1;
+
+    check_sharing();
+    check_rewrite_in_place();
+    check_rename();
+    check_uncached();
+
+    fd_cache_shutdown();
+    content_root_close();
+    const char *entries[] = {"root/hot.txt", "root/swap.txt", "root/fifo", "outside.txt"};
+    for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++)
+        unlink(at(entries[i]));
+    rmdir(at("root/dir"));
+    rmdir(at("root"));
+    rmdir(base);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,111 @@
+/* check_mime: the perfect-hash MIME table. Built-in lookups and misses,
+   configured types overriding built-ins, duplicate and unusable config
+   entries, and a table large enough that many extensions share a bucket. */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "check.h"
+#include "mime.h"
+
+#define SYNTHETIC_COUNT 1000
+
+static bool type_is(const char *path, const char *type)
+{
+    return strcmp(get_mime_type(path), type) == 0;
+}
+
+static void check_builtin(void)
+{
+    int builtin_count = mime_init(NULL, NULL, 0);
+    CHECK(builtin_count > 0);
+
+    CHECK(type_is("/index.html", "text/html"));
+    CHECK(type_is("/index.htm", "text/html"));
+    CHECK(type_is("/INDEX.HTML", "text/html"));
+    CHECK(type_is("/a/b.c/app.js", "application/javascript"));
+    CHECK(type_is("/photo.JpEg", "image/jpeg"));
+    CHECK(type_is("/font.woff2", "font/woff2"));
+
+    /* Misses, including names that share a prefix with a known extension */
+    CHECK(type_is("/README", "application/octet-stream"));
+    CHECK(type_is("/dir.d/file", "application/octet-stream"));
+    CHECK(type_is("/file.", "application/octet-stream"));
+    CHECK(type_is("/file.jp", "application/octet-stream"));
+    CHECK(type_is("/file.jpegx", "application/octet-stream"));
+    CHECK(type_is("/file.xyz", "application/octet-stream"));
+    CHECK(type_is("/file.averyveryverylongextension", "application/octet-stream"));
+}
+
+static void check_overrides(void)
+{
+    int builtin_count = mime_init(NULL, NULL, 0);
+
+    char *extensions[] = {".css", "JS", "foo", ".foo", "bar", ".averyveryverylongextension", ""};
+    char *types[] = {"text/x-css", "text/x-js", "application/x-foo-1", "application/x-foo-2", "", "application/x-long", "application/x-empty"};
+    int count = (int)(sizeof(extensions) / sizeof(extensions[0]));
+
+    /* css and js replace built-ins, foo is added once (the later entry
+       wins), bar has no type and the long and empty extensions are unusable */
+    CHECK(mime_init(extensions, types, count) == builtin_count + 1);
+    CHECK(type_is("/style.css", "text/x-css"));
+    CHECK(type_is("/app.JS", "text/x-js"));
+    CHECK(type_is("/a.foo", "application/x-foo-2"));
+    CHECK(type_is("/a.bar", "application/octet-stream"));
+    CHECK(type_is("/a.averyveryverylongextension", "application/octet-stream"));
+    CHECK(type_is("/index.html", "text/html"));
+
+    /* A rebuild starts again from the built-ins */
+    CHECK(mime_init(NULL, NULL, 0) == builtin_count);
+    CHECK(type_is("/style.css", "text/css"));
+    CHECK(type_is("/a.foo", "application/octet-stream"));
+}
+
+static void check_many(void)
+{
+    static char ext_buf[SYNTHETIC_COUNT][8], type_buf[SYNTHETIC_COUNT][32];
+    static char *extensions[SYNTHETIC_COUNT], *types[SYNTHETIC_COUNT];
+    for (int i = 0; i < SYNTHETIC_COUNT; i++)
+    {
+        snprintf(ext_buf[i], sizeof(ext_buf[i]), "x%d", i);
+        snprintf(type_buf[i], sizeof(type_buf[i]), "application/x-%d", i);
+        extensions[i] = ext_buf[i];
+        types[i] = type_buf[i];
+    }
+
+    int builtin_count = mime_init(NULL, NULL, 0);
+    CHECK(mime_init(extensions, types, SYNTHETIC_COUNT) == builtin_count + SYNTHETIC_COUNT);
+
+    int wrong = 0;
+    for (int i = 0; i < SYNTHETIC_COUNT; i++)
+    {
+        char path[32];
+        snprintf(path, sizeof(path), "/f.x%d", i);
+        wrong += !type_is(path, types[i]);
+        snprintf(path, sizeof(path), "/f.y%d", i);
+        wrong += !type_is(path, "application/octet-stream");
+    }
+    CHECK(wrong == 0);
+    CHECK(type_is("/index.html", "text/html"));
+    CHECK(type_is("/song.flac", "audio/flac"));
+}
+
+static void check_compressible(void)
+{
+    CHECK(is_compressible_mime("text/html"));
+    CHECK(is_compressible_mime("image/svg+xml"));
+    CHECK(is_compressible_mime("application/ld+json"));
+    CHECK(is_compressible_mime("application/wasm"));
+    CHECK(!is_compressible_mime("image/png"));
+    CHECK(!is_compressible_mime("application/octet-stream"));
+    CHECK(!is_compressible_mime("application/xml+zip"));
+}
+
+int main(void)
+{
+    check_builtin();
+    check_overrides();
+    check_many();
+    check_compressible();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,104 @@
+/* check_range: Range and If-Range parsing (parse_range_header,
+   if_range_matches) against a 1000-byte representation. */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "check.h"
+#include "client.h"
+
+#define FILE_SIZE 1000
+
+static byte_range_t ranges[MAX_BYTE_RANGES];
+
+/* Parse "GET / ...\r\nRange: <value>\r\n\r\n" */
+static int parse(const char *value, off_t file_size)
+{
+    char request[1024];
+    snprintf(request, sizeof(request), "GET /f HTTP/1.1\r\nHost: x\r\nRange: %s\r\n\r\n", value);
+    memset(ranges, 0, sizeof(ranges));
+    return parse_range_header(request, file_size, ranges, MAX_BYTE_RANGES);
+}
+
+static bool range_is(int i, off_t start, off_t end)
+{
+    return ranges[i].start == start && ranges[i].end == end;
+}
+
+static void check_single_ranges(void)
+{
+    CHECK(parse("bytes=0-99", FILE_SIZE) == 1 && range_is(0, 0, 99));
+    CHECK(parse("bytes=500-", FILE_SIZE) == 1 && range_is(0, 500, 999));
+    CHECK(parse("bytes=-200", FILE_SIZE) == 1 && range_is(0, 800, 999));
+    CHECK(parse("bytes=-5000", FILE_SIZE) == 1 && range_is(0, 0, 999));
+    CHECK(parse("bytes=990-5000", FILE_SIZE) == 1 && range_is(0, 990, 999));
+    CHECK(parse("bytes=999-999", FILE_SIZE) == 1 && range_is(0, 999, 999));
+    CHECK(parse("BYTES=0-0", FILE_SIZE) == 1 && range_is(0, 0, 0));
+}
+
+static void check_multiple_ranges(void)
+{
+    CHECK(parse("bytes=0-0, 10-19,-1", FILE_SIZE) == 3);
+    CHECK(range_is(0, 0, 0) && range_is(1, 10, 19) && range_is(2, 999, 999));
+
+    /* An unsatisfiable range is dropped when another one applies */
+    CHECK(parse("bytes=2000-3000, 0-9", FILE_SIZE) == 1 && range_is(0, 0, 9));
+
+    /* More ranges than the caller takes: serve the whole file */
+    char many[512] = "bytes=";
+    for (int i = 0; i <= MAX_BYTE_RANGES; i++)
+        snprintf(many + strlen(many), sizeof(many) - strlen(many), "%s%d-%d", i ? "," : "", i * 10, i * 10 + 1);
+    CHECK(parse(many, FILE_SIZE) == 0);
+}
+
+static void check_unsatisfiable(void)
+{
+    CHECK(parse("bytes=1000-", FILE_SIZE) == -1);
+    CHECK(parse("bytes=1000-2000", FILE_SIZE) == -1);
+    CHECK(parse("bytes=-0", FILE_SIZE) == -1);
+    CHECK(parse("bytes=0-", 0) == -1);
+    CHECK(parse("bytes=-10", 0) == -1);
+}
+
+static void check_ignored(void)
+{
+    CHECK(parse_range_header("GET /f HTTP/1.1\r\nHost: x\r\n\r\n", FILE_SIZE, ranges, MAX_BYTE_RANGES) == 0);
+    CHECK(parse("items=0-1", FILE_SIZE) == 0);
+    CHECK(parse("bytes=10-5", FILE_SIZE) == 0);
+    CHECK(parse("bytes=abc", FILE_SIZE) == 0);
+    CHECK(parse("bytes=0-1x", FILE_SIZE) == 0);
+    CHECK(parse("bytes=-", FILE_SIZE) == 0);
+    CHECK(parse("bytes=--5", FILE_SIZE) == 0);
+    CHECK(parse("bytes=", FILE_SIZE) == 0);
+}
+
+static void check_if_range(void)
+{
+    const char *etag = "\"abc-123\"";
+    time_t mtime = 1700000000;
+    char date[64], request[256];
+    format_http_date(mtime, date, sizeof(date));
+
+    CHECK(if_range_matches("GET /f HTTP/1.1\r\n\r\n", etag, mtime));
+
+    CHECK(if_range_matches("GET /f HTTP/1.1\r\nIf-Range: \"abc-123\"\r\n\r\n", etag, mtime));
+    CHECK(!if_range_matches("GET /f HTTP/1.1\r\nIf-Range: \"abc-124\"\r\n\r\n", etag, mtime));
+    CHECK(!if_range_matches("GET /f HTTP/1.1\r\nIf-Range: \"abc-123-gz\"\r\n\r\n", etag, mtime));
+    CHECK(!if_range_matches("GET /f HTTP/1.1\r\nIf-Range: W/\"abc-123\"\r\n\r\n", etag, mtime));
+    CHECK(!if_range_matches("GET /f HTTP/1.1\r\nIf-Range: \"abc-123\"\r\n\r\n", NULL, mtime));
+
+    snprintf(request, sizeof(request), "GET /f HTTP/1.1\r\nIf-Range: %s\r\n\r\n", date);
+    CHECK(if_range_matches(request, etag, mtime));
+    CHECK(!if_range_matches(request, etag, mtime + 1));
+}
+
+int main(void)
+{
+    check_single_ranges();
+    check_multiple_ranges();
+    check_unsatisfiable();
+    check_ignored();
+    check_if_range();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,168 @@
+/* check_sidecar: gzip negotiation and precompressed .gz sidecars. Which
+   Accept-Encoding headers allow gzip, which sidecars path_cache takes (at
+   least as new as the file, a regular file beneath the content root), the
+   gzip entity tag that follows the sidecar, and If-None-Match against the
+   identity and gzip tags. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "check.h"
+#include "client.h"
+#include "content_root.h"
+#include "path_cache.h"
+
+static char base[] = "/tmp/check_sidecar.XXXXXX";
+static char path_buf[8][PATH_MAX];
+
+/* base/<rel> in one of a few rotating buffers */
+static const char *at(const char *rel)
+{
+    static int next;
+    char *buf = path_buf[next++ % 8];
+    snprintf(buf, PATH_MAX, "%s/%s", base, rel);
+    return buf;
+}
+
+static void make_file(const char *rel, const char *content, time_t mtime)
+{
+    FILE *f = fopen(at(rel), "w");
+    if (!f)
+        return;
+    fputs(content, f);
+    fclose(f);
+    struct timespec times[2] = {{mtime, 0}, {mtime, 0}};
+    utimensat(AT_FDCWD, at(rel), times, 0);
+}
+
+static bool accepts(const char *value)
+{
+    char request[256];
+    snprintf(request, sizeof(request), "GET / HTTP/1.1\r\nAccept-Encoding: %s\r\n\r\n", value);
+    return get_accepts_gzip(request) != 0;
+}
+
+static void check_accept_encoding(void)
+{
+    CHECK(!get_accepts_gzip("GET / HTTP/1.1\r\nHost: x\r\n\r\n"));
+    CHECK(accepts("gzip"));
+    CHECK(accepts("GZIP"));
+    CHECK(accepts("deflate, gzip;q=0.5, br"));
+    CHECK(accepts("*"));
+    CHECK(accepts("br, *;q=0.1"));
+    CHECK(!accepts("br, deflate"));
+    CHECK(!accepts("gzip;q=0"));
+    CHECK(!accepts("gzip; q=0.000"));
+    CHECK(!accepts("*;q=0"));
+    CHECK(!accepts("x-gzip"));
+    CHECK(!accepts("gzipped"));
+
+    /* An explicit gzip entry wins over the wildcard, either way round */
+    CHECK(accepts("*;q=0, gzip"));
+    CHECK(accepts("gzip, *;q=0"));
+    CHECK(!accepts("*, gzip;q=0"));
+    CHECK(!accepts("gzip;q=0, *"));
+}
+
+static void check_sidecars(void)
+{
+    path_meta_t plain, gz, older, escaped, fifo;
+    CHECK(path_cache_lookup(at("root/plain.css"), &plain) == 0);
+    CHECK(!plain.has_gzip_sidecar);
+    char expected[sizeof(plain.gzip_etag)];
+    make_gzip_etag(plain.etag, expected, sizeof(expected));
+    CHECK(strcmp(plain.gzip_etag, expected) == 0);
+
+    CHECK(path_cache_lookup(at("root/gz.css"), &gz) == 0);
+    CHECK(gz.has_gzip_sidecar && gz.gzip_size == 7);
+    CHECK(strncmp(gz.gzip_etag, gz.etag, strlen(gz.etag) - 1) == 0);
+    CHECK(strstr(gz.gzip_etag + strlen(gz.etag) - 1, "-gz-") != NULL);
+    CHECK(gz.cache_mtime == 2000000000 && gz.mtime == 1900000000);
+
+    /* Older than the file: stale, not served */
+    CHECK(path_cache_lookup(at("root/older.css"), &older) == 0);
+    CHECK(!older.has_gzip_sidecar && older.cache_mtime == older.mtime);
+
+    /* A symlink out of the root, or not a regular file */
+    CHECK(path_cache_lookup(at("root/escaped.css"), &escaped) == 0);
+    CHECK(!escaped.has_gzip_sidecar);
+    CHECK(path_cache_lookup(at("root/fifo.css"), &fifo) == 0);
+    CHECK(!fifo.has_gzip_sidecar);
+
+    CHECK(path_cache_lookup(at("root"), &plain) == -1);
+    CHECK(path_cache_lookup(at("root/missing.css"), &plain) == -1);
+
+    /* A rebuilt sidecar changes the gzip tag but not the file's */
+    make_file("root/gz.css.gz", "rebuilt sidecar", 2000000001);
+    path_cache_clear();
+    path_meta_t rebuilt;
+    CHECK(path_cache_lookup(at("root/gz.css"), &rebuilt) == 0);
+    CHECK(rebuilt.has_gzip_sidecar && rebuilt.gzip_size == 15);
+    CHECK(strcmp(rebuilt.etag, gz.etag) == 0);
+    CHECK(strcmp(rebuilt.gzip_etag, gz.gzip_etag) != 0);
+
+    /* With the open file's stat, a rewrite is seen without waiting */
+    make_file("root/plain.css", "rewritten body", 1900000005);
+    struct stat st;
+    stat(at("root/plain.css"), &st);
+    path_meta_t rewritten;
+    CHECK(path_cache_lookup_stat(at("root/plain.css"), &st, &rewritten) == 0);
+    CHECK(rewritten.size == 14 && strcmp(rewritten.etag, plain.etag) != 0);
+}
+
+static void check_if_none_match_tags(void)
+{
+    const char *etag = "\"1-2-3\"", *gzip_etag = "\"1-2-3-gz-4-5-6\"";
+    CHECK(check_if_none_match("GET / HTTP/1.1\r\n\r\n", etag, gzip_etag) == -1);
+    CHECK(check_if_none_match("GET / HTTP/1.1\r\nIf-None-Match: \"1-2-3\"\r\n\r\n", etag, gzip_etag) == 1);
+    CHECK(check_if_none_match("GET / HTTP/1.1\r\nIf-None-Match: W/\"1-2-3\"\r\n\r\n", etag, gzip_etag) == 1);
+    CHECK(check_if_none_match("GET / HTTP/1.1\r\nIf-None-Match: *\r\n\r\n", etag, gzip_etag) == 1);
+    CHECK(check_if_none_match("GET / HTTP/1.1\r\nIf-None-Match: \"x\", \"1-2-3-gz-4-5-6\"\r\n\r\n", etag, gzip_etag) == 2);
+    CHECK(check_if_none_match("GET / HTTP/1.1\r\nIf-None-Match: \"x\",\"y\"\r\n\r\n", etag, gzip_etag) == 0);
+
+    /* Only the exact gzip tag: not the old suffix, not another sidecar's */
+    CHECK(check_if_none_match("GET / HTTP/1.1\r\nIf-None-Match: \"1-2-3-gz\"\r\n\r\n", etag, gzip_etag) == 0);
+    CHECK(check_if_none_match("GET / HTTP/1.1\r\nIf-None-Match: \"1-2-3-gz-4-5-7\"\r\n\r\n", etag, gzip_etag) == 0);
+    CHECK(check_if_none_match("GET / HTTP/1.1\r\nIf-None-Match: \"1-2-3-gz\"\r\n\r\n", etag, "") == 0);
+}
+
+int main(void)
+{
+    if (!mkdtemp(base))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    mkdir(at("root"), 0755);
+    make_file("root/plain.css", "body { }", 1900000000);
+    make_file("root/gz.css", "body { }", 1900000000);
+    make_file("root/gz.css.gz", "sidecar", 2000000000);
+    make_file("root/older.css", "body { }", 1900000000);
+    make_file("root/older.css.gz", "sidecar", 1800000000);
+    make_file("root/escaped.css", "body { }", 1900000000);
+    make_file("outside.gz", "outside", 2000000000);
+    symlink(at("outside.gz"), at("root/escaped.css.gz"));
+    make_file("root/fifo.css", "body { }", 1900000000);
+    mkfifo(at("root/fifo.css.gz"), 0644);
+    alarm(30); /* A blocking FIFO open would otherwise hang the run */
+
+    if (content_root_open(at("root")) != 0)
+        return 1;
+    check_accept_encoding();
+    check_sidecars();
+    check_if_none_match_tags();
+    content_root_close();
+
+    const char *entries[] = {"root/plain.css", "root/gz.css", "root/gz.css.gz", "root/older.css",
+                             "root/older.css.gz", "root/escaped.css", "root/escaped.css.gz",
+                             "root/fifo.css", "root/fifo.css.gz", "outside.gz"};
+    for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++)
+        unlink(at(entries[i]));
+    rmdir(at("root"));
+    rmdir(base);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,195 @@
+/* check_slab: per-thread caches must give their objects back rather than
+   lose them. A cache slot taken over by a colliding slab is flushed to the
+   slab it held, objects freed on another thread are reused, and a slot
+   left by a destroyed slab is dropped without touching its memory (run
+   under AddressSanitizer to see the latter fail loudly). Chunk counts from
+   the metrics show whether objects were lost: lost objects mean new chunks. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "check.h"
+#include "slab.h"
+#include "metrics.h"
+
+#define OBJECT_SIZE 64
+#define PER_CHUNK 32
+#define LIVE 1000
+#define ROUNDS 20
+
+static unsigned long chunks(void)
+{
+    return metrics_get().slab_chunks;
+}
+
+static int compare_ptr(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)*(void *const *)a, y = (uintptr_t)*(void *const *)b;
+    return (x > y) - (x < y);
+}
+
+/* No object handed out twice while live */
+static bool distinct(void **objects, int count)
+{
+    void **sorted = malloc((size_t)count * sizeof(void *));
+    if (!sorted)
+        return false;
+    memcpy(sorted, objects, (size_t)count * sizeof(void *));
+    qsort(sorted, (size_t)count, sizeof(void *), compare_ptr);
+    bool ok = true;
+    for (int i = 1; i < count && ok; i++)
+        ok = sorted[i] != sorted[i - 1];
+    free(sorted);
+    return ok;
+}
+
+/* Slabs created SLAB_MAX_CACHES apart share a thread cache slot */
+static void check_colliding_slabs(void)
+{
+    slab_t *slabs[SLAB_MAX_CACHES + 1];
+    for (int i = 0; i <= SLAB_MAX_CACHES; i++)
+        slabs[i] = slab_create(OBJECT_SIZE, PER_CHUNK);
+    slab_t *a = slabs[0], *b = slabs[SLAB_MAX_CACHES];
+
+    unsigned long before = chunks();
+    void *first[PER_CHUNK], *again[PER_CHUNK];
+    for (int i = 0; i < PER_CHUNK; i++)
+        first[i] = slab_alloc(a);
+    for (int i = 0; i < PER_CHUNK; i++)
+        slab_free(a, first[i]);
+
+    /* b takes the slot over; a's cached objects go back to a */
+    slab_free(b, slab_alloc(b));
+
+    for (int i = 0; i < PER_CHUNK; i++)
+        again[i] = slab_alloc(a);
+    CHECK(chunks() - before == 2);
+
+    qsort(first, PER_CHUNK, sizeof(void *), compare_ptr);
+    qsort(again, PER_CHUNK, sizeof(void *), compare_ptr);
+    CHECK(memcmp(first, again, sizeof(first)) == 0);
+    for (int i = 0; i < PER_CHUNK; i++)
+        slab_free(a, again[i]);
+
+    /* Alternating between them keeps reusing the same two chunks */
+    for (int round = 0; round < 1000; round++)
+    {
+        slab_t *slab = round % 2 ? a : b;
+        void *objects[PER_CHUNK / 2];
+        for (int i = 0; i < PER_CHUNK / 2; i++)
+            objects[i] = slab_alloc(slab);
+        for (int i = 0; i < PER_CHUNK / 2; i++)
+            slab_free(slab, objects[i]);
+    }
+    CHECK(chunks() - before == 2);
+
+    for (int i = 0; i <= SLAB_MAX_CACHES; i++)
+        slab_destroy(slabs[i]);
+}
+
+typedef struct
+{
+    slab_t *slab;
+    void **objects;
+} alloc_job_t;
+
+static void *alloc_all(void *arg)
+{
+    alloc_job_t *job = arg;
+    for (int i = 0; i < LIVE; i++)
+        job->objects[i] = slab_alloc(job->slab);
+    return NULL;
+}
+
+/* One thread allocates, another frees, as with accepted connections */
+static void check_cross_thread(void)
+{
+    slab_t *slab = slab_create(OBJECT_SIZE, PER_CHUNK);
+    void **objects = malloc(LIVE * sizeof(void *));
+    if (!slab || !objects)
+    {
+        CHECK(!"out of memory");
+        return;
+    }
+
+    unsigned long before = chunks();
+    bool all_distinct = true;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        alloc_job_t job = {slab, objects};
+        pthread_t thread;
+        pthread_create(&thread, NULL, alloc_all, &job);
+        pthread_join(thread, NULL);
+
+        all_distinct = all_distinct && distinct(objects, LIVE);
+        for (int i = 0; i < LIVE; i++)
+            slab_free(slab, objects[i]);
+    }
+    CHECK(all_distinct);
+
+    /* Each round reuses what the last one freed (and what the exiting
+       thread had cached), so the slab holds about one round's worth */
+    unsigned long needed = (LIVE + PER_CHUNK - 1) / PER_CHUNK;
+    CHECK(chunks() - before <= needed + 2 * SLAB_THREAD_CACHE / PER_CHUNK + 1);
+
+    free(objects);
+    slab_destroy(slab);
+}
+
+typedef struct
+{
+    slab_t *slab;
+    _Atomic int step; /* 1: slab used, 2: slab destroyed and replaced */
+} stale_job_t;
+
+static void *use_after_destroy(void *arg)
+{
+    stale_job_t *job = arg;
+    slab_free(job->slab, slab_alloc(job->slab));
+    atomic_store(&job->step, 1);
+    while (atomic_load(&job->step) != 2)
+        sched_yield();
+    slab_free(job->slab, slab_alloc(job->slab));
+    return NULL;
+}
+
+/* A thread's slot still refers to a slab another thread destroyed; the
+   next slab to use the slot must not flush into the freed memory */
+static void check_destroyed_slab(void)
+{
+    stale_job_t job = {slab_create(OBJECT_SIZE, PER_CHUNK), 0};
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, use_after_destroy, &job);
+    while (atomic_load(&job.step) != 1)
+        sched_yield();
+
+    slab_t *others[SLAB_MAX_CACHES];
+    slab_destroy(job.slab);
+    for (int i = 0; i < SLAB_MAX_CACHES; i++)
+        others[i] = slab_create(OBJECT_SIZE, PER_CHUNK);
+    job.slab = others[SLAB_MAX_CACHES - 1]; /* Same slot as the destroyed one */
+    atomic_store(&job.step, 2);
+    pthread_join(thread, NULL);
+
+    void *object = slab_alloc(job.slab);
+    CHECK(object != NULL);
+    slab_free(job.slab, object);
+
+    for (int i = 0; i < SLAB_MAX_CACHES; i++)
+        slab_destroy(others[i]);
+}
+
+int main(void)
+{
+    metrics_init();
+    check_colliding_slabs();
+    check_cross_thread();
+    check_destroyed_slab();
+    return CHECK_RESULT();
+}
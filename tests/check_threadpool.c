@@ -0,0 +1,166 @@
+/* check_threadpool: the queue bound is the configured total, not the sum
+   of the per-worker rings. With every worker held writing a large file to
+   a client that does not read, exactly queue_size connections are taken,
+   the next is refused and left to the caller, and the queued ones are
+   all picked up once the workers are free again. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "check.h"
+#include "threadpool.h"
+#include "content_root.h"
+#include "metrics.h"
+#include "settings.h"
+
+#define WORKERS 2
+#define QUEUE_SIZE 3 /* Rings of 2 per worker: together they hold 4 */
+#define FILE_SIZE (8 * 1024 * 1024) /* Well over a socket buffer */
+#define WAIT_MS 5000
+
+static char base[] = "/tmp/check_threadpool.XXXXXX";
+static char root[sizeof(base) + 16];
+static char path_buf[4][sizeof(base) + 32];
+
+/* base/<rel> in one of a few rotating buffers */
+static const char *at(const char *rel)
+{
+    static int next;
+    char *buf = path_buf[next++ % 4];
+    snprintf(buf, sizeof(path_buf[0]), "%s/%s", base, rel);
+    return buf;
+}
+
+static bool write_file(const char *path, const char *content, size_t len)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(content, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+static work_item_t make_work(int client_fd)
+{
+    work_item_t work;
+    memset(&work, 0, sizeof(work));
+    work.client_fd = client_fd;
+    work.client_addr.sin_family = AF_INET;
+    work.client_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    work.content_directory = root;
+    return work;
+}
+
+/* Wait up to WAIT_MS for the queues to hold exactly expected items */
+static bool wait_for_queued(threadpool_t *pool, int expected)
+{
+    for (int waited = 0; waited < WAIT_MS; waited += 10)
+    {
+        if (threadpool_queue_size(pool) == expected)
+            return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+static void check_queue_bound(threadpool_t *pool)
+{
+    /* Hold every worker: each sends the big file until the buffer fills */
+    int busy[WORKERS][2];
+    for (int i = 0; i < WORKERS; i++)
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, busy[i]);
+        const char *request = "GET /big.bin HTTP/1.1\r\n\r\n";
+        send(busy[i][0], request, strlen(request), 0);
+        CHECK(threadpool_submit(pool, make_work(busy[i][1])));
+    }
+    for (int i = 0; i < WORKERS; i++)
+    {
+        char peek;
+        CHECK(recv(busy[i][0], &peek, 1, MSG_PEEK) == 1);
+    }
+    CHECK(wait_for_queued(pool, 0));
+
+    /* Idle connections queue up to the bound, whichever rings they land on */
+    int queued[QUEUE_SIZE + 1][2];
+    int accepted = 0;
+    for (int i = 0; i < QUEUE_SIZE + 1; i++)
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, queued[i]);
+        if (threadpool_submit(pool, make_work(queued[i][1])))
+            accepted++;
+        else
+        {
+            /* Refused: the fd is still ours */
+            CHECK(fcntl(queued[i][1], F_GETFD) != -1);
+            close(queued[i][1]);
+        }
+    }
+    CHECK(accepted == QUEUE_SIZE);
+    CHECK(threadpool_queue_size(pool) == QUEUE_SIZE);
+
+    /* Freed workers drain the queues, and the pool takes work again */
+    for (int i = 0; i < WORKERS; i++)
+        close(busy[i][0]);
+    CHECK(wait_for_queued(pool, 0));
+
+    int again[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, again);
+    CHECK(threadpool_submit(pool, make_work(again[1])));
+    CHECK(wait_for_queued(pool, 0));
+
+    close(again[0]);
+    for (int i = 0; i < QUEUE_SIZE + 1; i++)
+        close(queued[i][0]);
+}
+
+int main(void)
+{
+    if (!mkdtemp(base))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(root, sizeof(root), "%s/root", base);
+    mkdir(root, 0755);
+
+    char *data = malloc(FILE_SIZE);
+    memset(data, 'x', FILE_SIZE);
+    bool written = write_file(at("root/big.bin"), data, FILE_SIZE) && write_file(at("config.json"), "{}\n", 3);
+    free(data);
+    if (!written)
+    {
+        perror(base);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN); /* Busy clients hang up mid-response */
+    alarm(60); /* A worker that never frees up would otherwise hang the run */
+
+    set_config_path(at("config.json"));
+    metrics_init();
+    if (content_root_open(root) != 0)
+        return 1;
+
+    threadpool_t *pool = threadpool_create(WORKERS, QUEUE_SIZE, NULL);
+    CHECK(pool != NULL);
+    if (pool)
+    {
+        check_queue_bound(pool);
+        threadpool_shutdown(pool);
+    }
+
+    content_root_close();
+    unlink(at("root/big.bin"));
+    unlink(at("config.json"));
+    rmdir(root);
+    rmdir(base);
+    return CHECK_RESULT();
+}
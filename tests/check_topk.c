@@ -0,0 +1,231 @@
+/* check_topk: Space-Saving top-k tracking against exact counts. A small
+   table fed many distinct keys evicts constantly, so slots are taken over
+   and index entries removed (and probe runs shifted back) on almost every
+   miss; a broken index shows up as a key tracked twice. The reported
+   bounds must hold for every key, for one recording thread and for
+   several merged shards. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "check.h"
+#include "topk.h"
+#include "lib/cJSON.h"
+
+#define TRACKED 8
+#define KEYS 400
+#define RECORDS 200000
+#define THREADS 4
+#define CLIENTS 5
+
+static uint64_t truth[KEYS];
+
+/* Skewed key choice: low key numbers are much more frequent */
+static int next_key(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    double u = (double)(*state >> 11) / (double)(1ull << 53);
+    return (int)(KEYS * u * u * u);
+}
+
+static void record(int key, int n)
+{
+    char path[32], ip[32];
+    snprintf(path, sizeof(path), "/k%d", key);
+    snprintf(ip, sizeof(ip), "10.0.0.%d", n % CLIENTS);
+    topk_record(path, ip, n % 3 ? 200 : 404, 100, 1.0);
+}
+
+static cJSON *snapshot(void)
+{
+    char *json = topk_json();
+    cJSON *root = json ? cJSON_Parse(json) : NULL;
+    free(json);
+    return root;
+}
+
+static double number(const cJSON *item, const char *name)
+{
+    const cJSON *value = cJSON_GetObjectItemCaseSensitive(item, name);
+    return cJSON_IsNumber(value) ? value->valuedouble : -1;
+}
+
+/* Whether the paths are TRACKED distinct keys, each with requests -
+   max_overcount <= true count <= requests, and (with one shard, when
+   records > 0) requests summing to the number recorded */
+static bool paths_consistent(const cJSON *root, uint64_t records)
+{
+    const cJSON *paths = cJSON_GetObjectItemCaseSensitive(root, "paths");
+    if (cJSON_GetArraySize(paths) != TRACKED)
+        return false;
+
+    bool seen[KEYS] = {false};
+    uint64_t sum = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, paths)
+    {
+        const cJSON *path = cJSON_GetObjectItemCaseSensitive(item, "path");
+        int key = -1;
+        if (!cJSON_IsString(path) || sscanf(path->valuestring, "/k%d", &key) != 1 || key < 0 || key >= KEYS)
+            return false;
+        if (seen[key])
+            return false;
+        seen[key] = true;
+
+        uint64_t requests = (uint64_t)number(item, "requests");
+        uint64_t overcount = (uint64_t)number(item, "max_overcount");
+        if (overcount > requests || requests - overcount > truth[key] || truth[key] > requests)
+            return false;
+        sum += requests;
+    }
+    return records == 0 || sum == records;
+}
+
+/* Fewer clients than slots: counted exactly */
+static void check_clients(const cJSON *root, uint64_t records)
+{
+    const cJSON *clients = cJSON_GetObjectItemCaseSensitive(root, "clients");
+    CHECK(cJSON_GetArraySize(clients) == CLIENTS);
+    const cJSON *item;
+    cJSON_ArrayForEach(item, clients)
+    {
+        CHECK(number(item, "max_overcount") == 0);
+        CHECK((uint64_t)number(item, "requests") == records / CLIENTS);
+    }
+}
+
+static void check_statuses(const cJSON *root, uint64_t records)
+{
+    uint64_t ok = 0, not_found = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(root, "statuses"))
+    {
+        if (number(item, "status") == 200)
+            ok = (uint64_t)number(item, "requests");
+        else if (number(item, "status") == 404)
+            not_found = (uint64_t)number(item, "requests");
+    }
+    CHECK(not_found == (records + 2) / 3);
+    CHECK(ok + not_found == records);
+}
+
+static void check_single_thread(void)
+{
+    memset(truth, 0, sizeof(truth));
+    topk_init(TRACKED);
+    uint64_t state = 1;
+    int bad_snapshots = 0;
+    for (int n = 0; n < RECORDS; n++)
+    {
+        int key = next_key(&state);
+        truth[key]++;
+        record(key, n);
+
+        /* A key tracked twice is folded together in the JSON, leaving
+           fewer than TRACKED paths, so look while it is still there */
+        if (n >= TRACKED && n % 500 == 0)
+        {
+            cJSON *root = snapshot();
+            bad_snapshots += !root || !paths_consistent(root, (uint64_t)n + 1);
+            cJSON_Delete(root);
+        }
+    }
+    CHECK(bad_snapshots == 0);
+
+    cJSON *root = snapshot();
+    CHECK(root != NULL);
+    if (!root)
+        return;
+    CHECK(paths_consistent(root, RECORDS));
+
+    /* Any key seen more than RECORDS / TRACKED times must be tracked */
+    const cJSON *paths = cJSON_GetObjectItemCaseSensitive(root, "paths");
+    for (int key = 0; key < KEYS; key++)
+    {
+        if (truth[key] <= RECORDS / TRACKED)
+            continue;
+        char path[32];
+        snprintf(path, sizeof(path), "/k%d", key);
+        bool found = false;
+        const cJSON *item;
+        cJSON_ArrayForEach(item, paths)
+            found = found || strcmp(cJSON_GetObjectItemCaseSensitive(item, "path")->valuestring, path) == 0;
+        CHECK(found);
+    }
+
+    check_clients(root, RECORDS);
+    check_statuses(root, RECORDS);
+    cJSON_Delete(root);
+    topk_shutdown();
+}
+
+static void *record_slice(void *arg)
+{
+    int thread = (int)(intptr_t)arg;
+    uint64_t state = 1;
+    for (int n = 0; n < RECORDS; n++)
+    {
+        int key = next_key(&state);
+        if (n % THREADS == thread)
+            record(key, n);
+    }
+    return NULL;
+}
+
+static void check_threads(void)
+{
+    memset(truth, 0, sizeof(truth));
+    uint64_t state = 1;
+    for (int n = 0; n < RECORDS; n++)
+        truth[next_key(&state)]++;
+
+    topk_init(TRACKED);
+    pthread_t threads[THREADS];
+    for (int i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, record_slice, (void *)(intptr_t)i);
+    for (int i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    cJSON *root = snapshot();
+    CHECK(root != NULL);
+    if (root)
+    {
+        CHECK(paths_consistent(root, 0));
+        check_clients(root, RECORDS);
+        cJSON_Delete(root);
+    }
+    topk_shutdown();
+}
+
+/* Keys are truncated to TOPK_KEY_MAX - 1 bytes and share a slot */
+static void check_truncation(void)
+{
+    topk_init(TRACKED);
+    char a[TOPK_KEY_MAX + 32], b[TOPK_KEY_MAX + 32];
+    memset(a, 'a', sizeof(a) - 1);
+    a[sizeof(a) - 1] = '\0';
+    memcpy(b, a, sizeof(b));
+    b[TOPK_KEY_MAX + 8] = 'b';
+    topk_record(a, "10.0.0.1", 200, 0, 1.0);
+    topk_record(b, "10.0.0.1", 200, 0, 1.0);
+
+    cJSON *root = snapshot();
+    const cJSON *paths = cJSON_GetObjectItemCaseSensitive(root, "paths");
+    CHECK(cJSON_GetArraySize(paths) == 1);
+    const cJSON *first = cJSON_GetArrayItem(paths, 0);
+    CHECK(first && number(first, "requests") == 2);
+    CHECK(first && strlen(cJSON_GetObjectItemCaseSensitive(first, "path")->valuestring) == TOPK_KEY_MAX - 1);
+    cJSON_Delete(root);
+    topk_shutdown();
+}
+
+int main(void)
+{
+    check_single_thread();
+    check_threads();
+    check_truncation();
+    return CHECK_RESULT();
+}
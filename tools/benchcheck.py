@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+"""benchcheck: throughput and p99 regression check against a stored baseline.
+
+For every cell of a matrix (file size x keep-alive x concurrency x cache
+state) this starts a fresh httpserver with a fixed config, drives it with
+httpbench, and compares requests/sec and p99 latency with the baseline
+JSON. It exits 1 if any cell regressed past the baseline's thresholds.
+
+  benchcheck.py --server build/httpserver --bench build/httpbench \\
+      --baseline tools/bench-baseline.json [--update] [--cells REGEX]
+
+Cache states:
+  hot   one file, requested repeatedly after a warm-up, with every
+        in-process cache (file, path and fd caches) enabled
+  cold  a freshly started server with the fd cache off, cycling through
+        more distinct files than its caches hold, with no warm-up. The
+        OS page cache is not dropped.
+
+Baselines only mean something on the machine (class) that recorded them:
+rerun with --update on the reference box to rewrite the cell numbers,
+keeping the thresholds.
+
+--socket-options replaces the server's "socket-options" object, so a
+socket tuning profile can be compared with the kernel defaults:
+
+  benchcheck.py ... --baseline /tmp/defaults.json --update \
+      --keep-alive off --sizes 1KB --socket-options '{}'
+  benchcheck.py ... --baseline /tmp/defaults.json \
+      --keep-alive off --sizes 1KB --socket-options \
+      '{"tcp-nodelay": true, "tcp-defer-accept": 1, "tcp-fastopen": 256, "busy-poll": 50}'
+"""
+import argparse
+import json
+import os
+import platform
+import re
+import resource
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+SIZES = {"1KB": 1024, "64KB": 64 * 1024, "10MB": 10 * 1024 * 1024}
+COLD_FILES = {"1KB": 1024, "64KB": 1024, "10MB": 16}
+DEFAULT_THRESHOLDS = {
+    "throughput_drop_pct": 15.0,  # Fail if requests/sec falls by more than this
+    "p99_rise_pct": 30.0,         # Fail if p99 rises by more than this...
+    "p99_floor_us": 500,          # ...and by more than this many microseconds
+    "error_pct": 1.0,             # Fail if errors exceed this share of requests
+    "retry_rise_pct": 1.0,        # Fail if the share of resent requests rises
+                                  # by more than this many percentage points
+}
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--server", required=True, help="httpserver binary")
+    parser.add_argument("--bench", required=True, help="httpbench binary")
+    parser.add_argument("--baseline", required=True, help="baseline JSON to compare with (or --update)")
+    parser.add_argument("--update", action="store_true", help="record this run as the new baseline")
+    parser.add_argument("--sizes", default="1KB,64KB,10MB")
+    parser.add_argument("--concurrency", default="1,16,128,1024")
+    parser.add_argument("--keep-alive", default="on,off")
+    parser.add_argument("--cache", default="hot,cold")
+    parser.add_argument("--cells", help="only run cells whose name matches this regex")
+    parser.add_argument("--duration", type=float, default=3.0, help="measured seconds per cell")
+    parser.add_argument("--warmup", type=float, default=1.0, help="warm-up seconds for hot cells")
+    parser.add_argument("--bench-threads", type=int, default=2)
+    parser.add_argument("--server-threads", type=int, default=4)
+    parser.add_argument("--socket-options", type=json.loads,
+                        default={"tcp-nodelay": True, "tcp-defer-accept": 1},
+                        help='JSON for the server\'s "socket-options" (default: %(default)s)')
+    return parser.parse_args()
+
+
+def raise_fd_limit():
+    """1024 connections on both ends need more than the usual 1024 fds"""
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    want = hard if hard != resource.RLIM_INFINITY else 65536
+    if soft < want:
+        resource.setrlimit(resource.RLIMIT_NOFILE, (want, hard))
+
+
+def make_content(root, sizes):
+    """One hot file per size, plus the set of distinct files cold cells cycle through"""
+    for name in sizes:
+        size = SIZES[name]
+        block = os.urandom(min(size, 1 << 20))
+        with open(os.path.join(root, "hot-%s.bin" % name), "wb") as f:
+            for offset in range(0, size, len(block)):
+                f.write(block[: size - offset])
+
+        cold_dir = os.path.join(root, "cold-%s" % name)
+        os.mkdir(cold_dir)
+        for i in range(COLD_FILES[name]):
+            with open(os.path.join(cold_dir, "%04d.bin" % i), "wb") as f:
+                for offset in range(0, size, len(block)):
+                    f.write(block[: size - offset])
+
+        with open(os.path.join(root, "cold-%s.txt" % name), "w") as f:
+            for i in range(COLD_FILES[name]):
+                f.write("/cold-%s/%04d.bin\n" % (name, i))
+
+
+def free_port():
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def start_server(args, workdir, content, cold):
+    port = free_port()
+    config = {
+        "server-port": port,
+        "server-content-directory": content,
+        "server-host": "127.0.0.1",
+        "show-file-extension": True,
+        "whitelist-enabled": False,
+        "enable-access-logging": False,
+        "access-log-file": os.path.join(workdir, "access.log"),
+        "thread-pool-size": args.server_threads,
+        "thread-pool-queue-size": 4096,
+        "thread-pool-adaptive": False,
+        "load-shed-queue-depth": 0,
+        "load-shed-target-wait-ms": 0,  # Measure serving, not admission control
+        "socket-options": args.socket_options,
+        "fd-cache-size": 0 if cold else 256,
+        "warmup-on-start": False,
+        "content-bundle": "",
+    }
+    config_path = os.path.join(workdir, "config.json")
+    with open(config_path, "w") as f:
+        json.dump(config, f)
+
+    log = open(os.path.join(workdir, "server.log"), "ab")
+    proc = subprocess.Popen([args.server, "--config", config_path], stdout=log, stderr=log)
+    log.close()
+
+    deadline = time.monotonic() + 10
+    while time.monotonic() < deadline:
+        if proc.poll() is not None:
+            sys.exit("httpserver exited during startup; see %s" % os.path.join(workdir, "server.log"))
+        try:
+            socket.create_connection(("127.0.0.1", port), timeout=0.2).close()
+            return proc, port
+        except OSError:
+            time.sleep(0.05)
+    proc.kill()
+    sys.exit("httpserver did not start listening on port %d" % port)
+
+
+def stop_server(proc):
+    proc.terminate()
+    try:
+        proc.wait(timeout=5)
+    except subprocess.TimeoutExpired:
+        proc.kill()
+        proc.wait()
+
+
+def run_cell(args, workdir, content, size, keep_alive, concurrency, cache):
+    cold = cache == "cold"
+    proc, port = start_server(args, workdir, content, cold)
+    try:
+        cmd = [
+            args.bench,
+            "-t", str(min(args.bench_threads, concurrency)),
+            "-c", str(concurrency),
+            "-d", str(args.duration),
+            "-w", "0" if cold else str(args.warmup),
+            "-k", "1" if keep_alive else "0",
+            "-j",
+        ]
+        if cold:
+            cmd += ["-f", os.path.join(content, "cold-%s.txt" % size), "http://127.0.0.1:%d/" % port]
+        else:
+            cmd += ["http://127.0.0.1:%d/hot-%s.bin" % (port, size)]
+        out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+        return json.loads(out.strip().splitlines()[-1])
+    finally:
+        stop_server(proc)
+
+
+def retry_pct(result):
+    """Share of requests httpbench resent after a kept-alive connection dropped
+    them. Some is normal (the server closes a connection after 100 requests),
+    so it is compared with the baseline rather than with zero."""
+    return result["retries"] * 100.0 / result["requests"] if result["requests"] else 0.0
+
+
+def compare(name, result, baseline, thresholds):
+    """Return (verdict, detail) for one cell"""
+    requests = result["requests"]
+    errors = result["connect_errors"] + result["read_errors"] + result["timeouts"] + result["non_2xx_3xx"]
+    if requests == 0 or errors * 100.0 > thresholds["error_pct"] * requests:
+        return "FAIL", "%d errors in %d requests" % (errors, requests)
+
+    base = baseline.get(name)
+    if not base:
+        return "new", ""
+
+    retries, base_retries = retry_pct(result), base.get("retry_pct", 0.0)
+    if retries - base_retries > thresholds["retry_rise_pct"]:
+        return "FAIL", "%.2f%% of requests resent (baseline %.2f%%)" % (retries, base_retries)
+
+    rps, base_rps = result["requests_per_sec"], base["requests_per_sec"]
+    p99, base_p99 = result["latency_us"]["p99"], base["p99_us"]
+    drop = (base_rps - rps) * 100.0 / base_rps if base_rps else 0.0
+    rise = (p99 - base_p99) * 100.0 / base_p99 if base_p99 else 0.0
+    detail = "rps %+.1f%%, p99 %+.1f%%" % (-drop, rise)
+
+    if drop > thresholds["throughput_drop_pct"]:
+        return "FAIL", detail
+    if rise > thresholds["p99_rise_pct"] and p99 - base_p99 > thresholds["p99_floor_us"]:
+        return "FAIL", detail
+    return "ok", detail
+
+
+def main():
+    args = parse_args()
+    raise_fd_limit()
+
+    sizes = [s for s in args.sizes.split(",") if s]
+    for size in sizes:
+        if size not in SIZES:
+            sys.exit("unknown size %s (expected one of %s)" % (size, ", ".join(SIZES)))
+    concurrencies = [int(c) for c in args.concurrency.split(",") if c]
+    keep_alives = [k == "on" for k in args.keep_alive.split(",") if k]
+    caches = [c for c in args.cache.split(",") if c]
+    cell_filter = re.compile(args.cells) if args.cells else None
+
+    stored = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            stored = json.load(f)
+    elif not args.update:
+        sys.exit("no baseline at %s; record one with --update" % args.baseline)
+    thresholds = dict(DEFAULT_THRESHOLDS, **stored.get("thresholds", {}))
+    baseline_cells = stored.get("cells", {})
+
+    workdir = tempfile.mkdtemp(prefix="benchcheck-")
+    content = os.path.join(workdir, "content")
+    os.mkdir(content)
+    make_content(content, sizes)
+
+    results = {}
+    failures = 0
+    print("%-28s %12s %10s %8s  %s" % ("cell", "req/s", "p99 us", "retry %", "vs baseline"))
+    try:
+        for size in sizes:
+            for keep_alive in keep_alives:
+                for concurrency in concurrencies:
+                    for cache in caches:
+                        name = "%s/%s/c%d/%s" % (size, "keepalive" if keep_alive else "close", concurrency, cache)
+                        if cell_filter and not cell_filter.search(name):
+                            continue
+                        result = run_cell(args, workdir, content, size, keep_alive, concurrency, cache)
+                        verdict, detail = compare(name, result, baseline_cells, thresholds)
+                        failures += verdict == "FAIL"
+                        results[name] = {
+                            "requests_per_sec": round(result["requests_per_sec"], 1),
+                            "p99_us": result["latency_us"]["p99"],
+                            "retry_pct": round(retry_pct(result), 2),
+                        }
+                        print("%-28s %12.1f %10d %8.2f  %s %s" % (name, result["requests_per_sec"],
+                                                                   result["latency_us"]["p99"], retry_pct(result),
+                                                                   verdict, detail))
+                        sys.stdout.flush()
+    finally:
+        shutil.rmtree(workdir, ignore_errors=True)
+
+    if args.update:
+        stored["description"] = stored.get(
+            "description", "httpbench results per benchcheck.py cell; compare only on the recording machine")
+        stored["recorded"] = time.strftime("%Y-%m-%d")
+        stored["machine"] = "%s %s, %d CPUs" % (platform.system(), platform.machine(), os.cpu_count() or 0)
+        stored["duration_s"] = args.duration
+        stored["thresholds"] = thresholds
+        stored.setdefault("cells", {}).update(results)
+        with open(args.baseline, "w") as f:
+            json.dump(stored, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("Baseline written to %s" % args.baseline)
+        return 0
+
+    if failures:
+        print("%d cell(s) regressed" % failures)
+        return 1
+    print("No regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,986 @@
+/* httpbench: HTTP/1.1 load generator for measuring the server.
+
+   Usage: httpbench [options] http://host:port/path
+     -t threads      Worker threads, each running its own epoll loop (2)
+     -c connections  Concurrent connections across all threads (16)
+     -d seconds      Measured duration (10)
+     -w seconds      Warm-up before measuring starts (1)
+     -r rate         Open loop: send this many requests/sec in total on a
+                     fixed schedule, timing each one from when it was due,
+                     so a stalling server cannot hide its queueing delay
+                     (coordinated omission). 0 runs closed loop: each
+                     connection sends as soon as its answer arrives (0)
+     -k 0|1          Keep connections alive between requests (1)
+     -p depth        Requests in flight per connection (pipelining) (1)
+     -f file         Request paths (or URLs on the same host), one per
+                     line, used round-robin instead of the URL's path
+     -H header       Extra request header, may be repeated
+     -T seconds      Count a request as timed out after this long (5)
+     -j              Print the results as one JSON object
+
+   Requests lost when the server closes a reused keep-alive connection
+   before answering are retried on a new connection, as browsers do; any
+   other failure is counted as an error.
+
+   Example, with the server started on the bundled server-content:
+     httpbench -t 4 -c 64 -d 10 http://127.0.0.1:8080/index.html
+     httpbench -c 32 -r 20000 -f paths.txt http://127.0.0.1:8080/ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define MAX_PIPELINE 64
+#define IN_SIZE 65536   /* Read buffer; also bounds one response header block */
+#define OUT_SIZE 16384  /* Unsent request bytes per connection */
+#define HIST_SUB_BITS 6 /* 64 sub-buckets per power of two: under 1.6% error */
+#define HIST_BUCKETS (40 << HIST_SUB_BITS)
+#define SCAN_INTERVAL 0.1 /* Seconds between timeout and reconnect checks */
+
+enum
+{
+    P_HEADERS,
+    P_BODY,
+    P_CHUNK_SIZE,
+    P_CHUNK_DATA,
+    P_CHUNK_CRLF,
+    P_CHUNK_TRAILER,
+    P_UNTIL_CLOSE
+};
+
+typedef struct
+{
+    char *data;
+    size_t len;
+} request_t;
+
+typedef struct
+{
+    int fd;
+    bool connecting;
+    bool reused;   /* A response has completed on this connection */
+    bool got_data; /* Some of the oldest in-flight response has arrived */
+    bool want_out; /* Registered for EPOLLOUT */
+    int in_flight;
+    int head;                         /* Oldest in-flight slot */
+    double started[MAX_PIPELINE];     /* When each in-flight request was due */
+    size_t request_of[MAX_PIPELINE]; /* Which request each slot sent */
+    size_t next_request;
+    double next_due; /* Open loop: schedule of this connection's next request */
+    double retry_at; /* After a failed connect: when to try again */
+    double last_activity;
+
+    char out[OUT_SIZE];
+    size_t out_len, out_off;
+
+    char in[IN_SIZE];
+    size_t in_len;
+    int parse;
+    long long body_left;
+    bool close_after;
+    int status;
+} conn_t;
+
+typedef struct
+{
+    unsigned long completed;
+    unsigned long status_2xx_3xx;
+    unsigned long status_other;
+    unsigned long connect_errors;
+    unsigned long read_errors;
+    unsigned long timeouts;
+    unsigned long retries;
+    unsigned long long bytes;
+    double latency_sum_us;
+    uint64_t latency_min_us;
+    uint64_t latency_max_us;
+    uint64_t hist[HIST_BUCKETS];
+} stats_t;
+
+typedef struct
+{
+    pthread_t thread;
+    int epoll_fd;
+    int timer_fd; /* Absolute deadlines: epoll_wait's milliseconds are too coarse for a schedule */
+    double armed; /* Deadline timer_fd is set for */
+    conn_t *conns;
+    int conn_count;
+    int first_conn; /* Global index of conns[0], for staggering the schedule */
+    double next_due; /* Open loop: earliest time a connection has a request due */
+    stats_t stats;
+} worker_t;
+
+static struct
+{
+    struct addrinfo *addr;
+    request_t *requests;
+    size_t request_count;
+    int threads;
+    int connections;
+    double duration;
+    double warmup;
+    double rate;
+    bool keep_alive;
+    int pipeline;
+    double timeout;
+    bool json;
+    const char *url;
+
+    double start;         /* Load begins */
+    double measure_start; /* Warm-up ends */
+    double end;
+} bench = {
+    .threads = 2,
+    .connections = 16,
+    .duration = 10,
+    .warmup = 1,
+    .keep_alive = true,
+    .pipeline = 1,
+    .timeout = 5,
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Log-linear bucket: exact below 128us, then 64 buckets per power of two */
+static int hist_index(uint64_t us)
+{
+    if (us < (2u << HIST_SUB_BITS))
+        return (int)us;
+    int msb = 63 - __builtin_clzll(us);
+    int shift = msb - HIST_SUB_BITS;
+    int index = ((shift + 1) << HIST_SUB_BITS) + (int)((us >> shift) - (1u << HIST_SUB_BITS));
+    return index < HIST_BUCKETS ? index : HIST_BUCKETS - 1;
+}
+
+static uint64_t hist_value(int index)
+{
+    if (index < (2 << HIST_SUB_BITS))
+        return (uint64_t)index;
+    int shift = (index >> HIST_SUB_BITS) - 1;
+    uint64_t sub = (uint64_t)(index & ((1 << HIST_SUB_BITS) - 1)) + (1u << HIST_SUB_BITS);
+    return sub << shift;
+}
+
+static uint64_t hist_percentile(const stats_t *s, double percentile)
+{
+    if (s->completed == 0)
+        return 0;
+    uint64_t target = (uint64_t)(s->completed * percentile / 100.0 + 0.5);
+    if (target == 0)
+        target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += s->hist[i];
+        if (seen >= target)
+            return hist_value(i);
+    }
+    return s->latency_max_us;
+}
+
+/* ---- Connection handling ---- */
+
+static void set_events(worker_t *w, conn_t *c, bool want_out)
+{
+    struct epoll_event ev = {.events = EPOLLIN | (want_out ? EPOLLOUT : 0), .data.ptr = c};
+    epoll_ctl(w->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_out = want_out;
+}
+
+static void reset_parser(conn_t *c)
+{
+    c->in_len = 0;
+    c->parse = P_HEADERS;
+    c->body_left = 0;
+    c->close_after = false;
+    c->got_data = false;
+}
+
+/* Queue a request's bytes; false if the output buffer is full */
+static bool queue_request(conn_t *c, size_t request)
+{
+    const request_t *r = &bench.requests[request];
+    if (c->out_len + r->len > OUT_SIZE)
+        return false;
+    memcpy(c->out + c->out_len, r->data, r->len);
+    c->out_len += r->len;
+    return true;
+}
+
+static int flush_output(worker_t *w, conn_t *c)
+{
+    while (c->out_off < c->out_len)
+    {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            c->out_off += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno == EAGAIN)
+        {
+            if (!c->want_out)
+                set_events(w, c, true);
+            return 0;
+        }
+        return -1;
+    }
+    c->out_off = c->out_len = 0;
+    if (c->want_out)
+        set_events(w, c, false);
+    return 0;
+}
+
+static void open_connection(worker_t *w, conn_t *c, double now)
+{
+    c->fd = socket(bench.addr->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0)
+    {
+        w->stats.connect_errors++;
+        c->retry_at = now + SCAN_INTERVAL;
+        return;
+    }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(c->fd, bench.addr->ai_addr, bench.addr->ai_addrlen) != 0 && errno != EINPROGRESS)
+    {
+        close(c->fd);
+        c->fd = -1;
+        w->stats.connect_errors++;
+        c->retry_at = now + SCAN_INTERVAL;
+        return;
+    }
+
+    c->connecting = true;
+    c->reused = false;
+    c->out_len = c->out_off = 0;
+    c->last_activity = now;
+    reset_parser(c);
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT, .data.ptr = c};
+    epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, c->fd, &ev);
+    c->want_out = true;
+}
+
+static void close_connection(conn_t *c)
+{
+    if (c->fd >= 0)
+        close(c->fd);
+    c->fd = -1;
+    c->connecting = false;
+}
+
+/* Forget the in-flight requests of a failed connection, as errors */
+static void drop_in_flight(conn_t *c, unsigned long *counter)
+{
+    *counter += (unsigned long)c->in_flight;
+    c->in_flight = 0;
+    c->head = 0;
+}
+
+/* Start a request due at the given time. Its bytes go out now if the
+   connection is up, or once the connect completes. */
+static bool issue_request(conn_t *c, double due)
+{
+    if (c->in_flight == bench.pipeline)
+        return false;
+    size_t request = c->next_request;
+    if (c->fd >= 0 && !c->connecting && !queue_request(c, request))
+        return false;
+
+    int slot = (c->head + c->in_flight) % MAX_PIPELINE;
+    c->started[slot] = due;
+    c->request_of[slot] = request;
+    c->in_flight++;
+    c->next_request = (request + 1) % bench.request_count;
+    return true;
+}
+
+/* Send what this connection may: everything the schedule says is due
+   (open loop), or enough to fill the pipeline (closed loop) */
+static void send_due(worker_t *w, conn_t *c, double now)
+{
+    if (now >= bench.end)
+        return;
+    if (c->fd < 0)
+    {
+        if (now < c->retry_at)
+            return;
+        open_connection(w, c, now);
+        if (c->fd < 0)
+            return;
+    }
+
+    size_t queued = c->out_len;
+    if (bench.rate > 0)
+    {
+        double interval = bench.connections / bench.rate;
+        while (c->next_due <= now && issue_request(c, c->next_due))
+            c->next_due += interval;
+        if (c->in_flight < bench.pipeline && c->next_due < w->next_due)
+            w->next_due = c->next_due;
+    }
+    else
+    {
+        while (issue_request(c, now))
+            ;
+    }
+
+    if (!c->connecting && c->out_len > queued && flush_output(w, c) != 0)
+    {
+        close_connection(c);
+        drop_in_flight(c, &w->stats.read_errors);
+    }
+}
+
+static void record_response(worker_t *w, conn_t *c, double now)
+{
+    double started = c->started[c->head];
+    c->head = (c->head + 1) % MAX_PIPELINE;
+    c->in_flight--;
+    c->reused = true;
+    c->got_data = false;
+
+    if (now < bench.measure_start || now > bench.end)
+        return;
+
+    stats_t *s = &w->stats;
+    uint64_t us = (uint64_t)((now - started) * 1e6);
+    s->completed++;
+    if (c->status >= 200 && c->status < 400)
+        s->status_2xx_3xx++;
+    else
+        s->status_other++;
+    s->latency_sum_us += (double)us;
+    if (s->completed == 1 || us < s->latency_min_us)
+        s->latency_min_us = us;
+    if (us > s->latency_max_us)
+        s->latency_max_us = us;
+    s->hist[hist_index(us)]++;
+}
+
+static void consume(conn_t *c, size_t n)
+{
+    memmove(c->in, c->in + n, c->in_len - n);
+    c->in_len -= n;
+}
+
+static const char *find_header(const char *headers, size_t len, const char *name)
+{
+    size_t name_len = strlen(name);
+    for (const char *p = headers; p + name_len + 2 <= headers + len; p++)
+    {
+        if (p[0] == '\r' && p[1] == '\n' && strncasecmp(p + 2, name, name_len) == 0)
+            return p + 2 + name_len;
+    }
+    return NULL;
+}
+
+/* Parse as many complete responses as the buffer holds. Returns 1 if the
+   connection should be closed after the last one, -1 on a protocol error. */
+static int parse_responses(worker_t *w, conn_t *c, double now)
+{
+    for (;;)
+    {
+        switch (c->parse)
+        {
+        case P_HEADERS:
+        {
+            char *end = memmem(c->in, c->in_len, "\r\n\r\n", 4);
+            if (!end)
+                return c->in_len == IN_SIZE ? -1 : 0;
+            if (c->in_flight == 0 || sscanf(c->in, "HTTP/1.%*d %d", &c->status) != 1)
+                return -1;
+
+            size_t header_len = (size_t)(end - c->in) + 4;
+            const char *length = find_header(c->in, header_len, "content-length:");
+            const char *encoding = find_header(c->in, header_len, "transfer-encoding:");
+            const char *connection = find_header(c->in, header_len, "connection:");
+            while (connection && *connection == ' ')
+                connection++;
+            c->close_after = connection && strncasecmp(connection, "close", 5) == 0;
+
+            if (encoding && strstr(encoding, "chunked") && strstr(encoding, "chunked") < end)
+                c->parse = P_CHUNK_SIZE;
+            else if (length)
+            {
+                c->body_left = strtoll(length, NULL, 10);
+                c->parse = P_BODY;
+            }
+            else if (c->status == 204 || c->status == 304 || c->status / 100 == 1)
+            {
+                c->body_left = 0;
+                c->parse = P_BODY;
+            }
+            else
+                c->parse = P_UNTIL_CLOSE;
+            consume(c, header_len);
+            break;
+        }
+        case P_BODY:
+        case P_CHUNK_DATA:
+        case P_CHUNK_CRLF:
+        {
+            size_t take = c->body_left < (long long)c->in_len ? (size_t)c->body_left : c->in_len;
+            consume(c, take);
+            c->body_left -= (long long)take;
+            if (c->body_left > 0)
+                return 0;
+            if (c->parse == P_CHUNK_DATA)
+            {
+                c->parse = P_CHUNK_CRLF;
+                c->body_left = 2;
+                break;
+            }
+            if (c->parse == P_CHUNK_CRLF)
+            {
+                c->parse = P_CHUNK_SIZE;
+                break;
+            }
+            c->parse = P_HEADERS;
+            record_response(w, c, now);
+            if (c->close_after)
+                return 1;
+            break;
+        }
+        case P_CHUNK_SIZE:
+        {
+            char *eol = memmem(c->in, c->in_len, "\r\n", 2);
+            if (!eol)
+                return c->in_len == IN_SIZE ? -1 : 0;
+            long long size = strtoll(c->in, NULL, 16);
+            consume(c, (size_t)(eol - c->in) + 2);
+            if (size < 0)
+                return -1;
+            c->body_left = size;
+            c->parse = size == 0 ? P_CHUNK_TRAILER : P_CHUNK_DATA;
+            break;
+        }
+        case P_CHUNK_TRAILER:
+        {
+            char *eol = memmem(c->in, c->in_len, "\r\n", 2);
+            if (!eol)
+                return c->in_len == IN_SIZE ? -1 : 0;
+            bool last = eol == c->in;
+            consume(c, (size_t)(eol - c->in) + 2);
+            if (last)
+            {
+                c->parse = P_HEADERS;
+                record_response(w, c, now);
+                if (c->close_after)
+                    return 1;
+            }
+            break;
+        }
+        case P_UNTIL_CLOSE:
+            c->in_len = 0;
+            return 0;
+        }
+    }
+}
+
+/* The connection ended (or failed). Requests the server never started
+   answering on a reused connection are retried; the rest are errors. */
+static void connection_lost(worker_t *w, conn_t *c, bool eof, double now)
+{
+    if (eof && c->parse == P_UNTIL_CLOSE && c->in_flight > 0)
+    {
+        c->parse = P_HEADERS;
+        record_response(w, c, now);
+    }
+
+    bool retry = c->in_flight > 0 && c->reused && !c->got_data && c->parse == P_HEADERS && c->in_len == 0;
+    close_connection(c);
+    if (retry)
+        w->stats.retries += (unsigned long)c->in_flight;
+    else
+        drop_in_flight(c, &w->stats.read_errors);
+    send_due(w, c, now);
+}
+
+/* A response completed and the connection is to be closed: keep any
+   pipelined requests for the next connection */
+static void reconnect(worker_t *w, conn_t *c, double now)
+{
+    if (c->in_flight > 0)
+        w->stats.retries += (unsigned long)c->in_flight;
+    close_connection(c);
+    send_due(w, c, now);
+}
+
+static void on_connected(worker_t *w, conn_t *c, double now)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0)
+    {
+        close_connection(c);
+        w->stats.connect_errors++;
+        drop_in_flight(c, &w->stats.read_errors);
+        c->retry_at = now + SCAN_INTERVAL;
+        return;
+    }
+    c->connecting = false;
+
+    /* Requests issued while connecting (or kept for a retry) go out now */
+    for (int i = 0; i < c->in_flight; i++)
+        queue_request(c, c->request_of[(c->head + i) % MAX_PIPELINE]);
+    if (flush_output(w, c) != 0)
+    {
+        connection_lost(w, c, false, now);
+        return;
+    }
+    send_due(w, c, now);
+}
+
+static void on_readable(worker_t *w, conn_t *c, double now)
+{
+    for (;;)
+    {
+        ssize_t n = recv(c->fd, c->in + c->in_len, IN_SIZE - c->in_len, 0);
+        if (n > 0)
+        {
+            now = now_seconds();
+            c->in_len += (size_t)n;
+            c->got_data = true;
+            c->last_activity = now;
+            if (now >= bench.measure_start && now <= bench.end)
+                w->stats.bytes += (unsigned long long)n;
+
+            int ret = parse_responses(w, c, now);
+            if (ret < 0)
+            {
+                connection_lost(w, c, false, now);
+                return;
+            }
+            if (ret > 0 || (!bench.keep_alive && c->in_flight == 0))
+            {
+                reconnect(w, c, now);
+                return;
+            }
+            if (c->in_flight < bench.pipeline)
+                send_due(w, c, now);
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno == EAGAIN)
+            return;
+        connection_lost(w, c, n == 0, now);
+        return;
+    }
+}
+
+/* Pass over the connections: optionally time out stalled requests, then
+   redial failed connections and send whatever has come due. Open loop,
+   this also finds the next time anything is due. */
+static void scan_connections(worker_t *w, double now, bool check_timeouts)
+{
+    w->next_due = bench.end;
+    for (int i = 0; i < w->conn_count; i++)
+    {
+        conn_t *c = &w->conns[i];
+        if (check_timeouts && c->fd >= 0 && c->in_flight > 0 && now - c->last_activity > bench.timeout)
+        {
+            close_connection(c);
+            drop_in_flight(c, &w->stats.timeouts);
+        }
+        send_due(w, c, now);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = arg;
+    struct epoll_event events[256];
+
+    w->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    w->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct epoll_event timer_ev = {.events = EPOLLIN, .data.ptr = NULL};
+    epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, w->timer_fd, &timer_ev);
+    double interval = bench.rate > 0 ? bench.connections / bench.rate : 0;
+    for (int i = 0; i < w->conn_count; i++)
+    {
+        conn_t *c = &w->conns[i];
+        c->fd = -1;
+        /* Stagger the schedule so arrivals are evenly spaced overall */
+        c->next_due = bench.start + interval * (w->first_conn + i) / bench.connections;
+    }
+
+    double next_scan = 0;
+    w->next_due = bench.end;
+    for (;;)
+    {
+        double now = now_seconds();
+        if (now >= bench.end)
+            break;
+        if (now >= next_scan)
+        {
+            scan_connections(w, now, true);
+            next_scan = now + SCAN_INTERVAL;
+        }
+        else if (now >= w->next_due)
+            scan_connections(w, now, false);
+
+        double wake = next_scan < w->next_due ? next_scan : w->next_due;
+        if (wake > bench.end)
+            wake = bench.end;
+        if (wake != w->armed)
+        {
+            /* Same clock as now_seconds(), so the deadline is exact */
+            struct itimerspec its = {0};
+            its.it_value.tv_sec = (time_t)wake;
+            its.it_value.tv_nsec = (long)((wake - (double)(time_t)wake) * 1e9);
+            if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+                its.it_value.tv_nsec = 1;
+            timerfd_settime(w->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+            w->armed = wake;
+        }
+
+        int n = epoll_wait(w->epoll_fd, events, 256, -1);
+        for (int i = 0; i < n; i++)
+        {
+            conn_t *c = events[i].data.ptr;
+            now = now_seconds();
+            if (!c)
+            {
+                uint64_t expirations;
+                if (read(w->timer_fd, &expirations, sizeof(expirations)) < 0)
+                    w->armed = 0; /* Already drained; re-arm next time round */
+                continue;
+            }
+            if (c->fd < 0)
+                continue;
+            if (c->connecting)
+            {
+                if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                    on_connected(w, c, now);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && flush_output(w, c) != 0)
+            {
+                connection_lost(w, c, false, now);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                on_readable(w, c, now);
+        }
+    }
+
+    for (int i = 0; i < w->conn_count; i++)
+        close_connection(&w->conns[i]);
+    close(w->timer_fd);
+    close(w->epoll_fd);
+    return NULL;
+}
+
+/* ---- Setup and reporting ---- */
+
+static int parse_url(const char *url, char *host, size_t host_size, char *port, size_t port_size,
+                     const char **path)
+{
+    if (strncmp(url, "http://", 7) != 0)
+        return -1;
+    const char *p = url + 7;
+    const char *slash = strchr(p, '/');
+    *path = slash ? slash : "/";
+    size_t authority = slash ? (size_t)(slash - p) : strlen(p);
+
+    const char *colon = memchr(p, ':', authority);
+    size_t host_len = colon ? (size_t)(colon - p) : authority;
+    if (host_len == 0 || host_len >= host_size)
+        return -1;
+    memcpy(host, p, host_len);
+    host[host_len] = '\0';
+
+    const char *port_start = colon ? colon + 1 : "80";
+    size_t port_len = colon ? authority - host_len - 1 : 2;
+    if (port_len == 0 || port_len >= port_size)
+        return -1;
+    memcpy(port, port_start, port_len);
+    port[port_len] = '\0';
+    return 0;
+}
+
+static int add_request(const char *path, const char *host, const char *extra, size_t *capacity)
+{
+    if (bench.request_count == *capacity)
+    {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        request_t *grown = realloc(bench.requests, *capacity * sizeof(*grown));
+        if (!grown)
+            return -1;
+        bench.requests = grown;
+    }
+
+    request_t *r = &bench.requests[bench.request_count];
+    int len = asprintf(&r->data,
+                       "GET %s HTTP/1.1\r\n"
+                       "Host: %s\r\n"
+                       "%s"
+                       "Connection: %s\r\n"
+                       "\r\n",
+                       path, host, extra, bench.keep_alive ? "keep-alive" : "close");
+    if (len < 0)
+        return -1;
+    r->len = (size_t)len;
+    bench.request_count++;
+    return 0;
+}
+
+static int load_request_file(const char *file, const char *host, const char *extra, size_t *capacity)
+{
+    FILE *f = fopen(file, "r");
+    if (!f)
+    {
+        perror(file);
+        return -1;
+    }
+
+    char line[4096];
+    while (fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        const char *path = line;
+        if (strncmp(line, "http://", 7) == 0)
+        {
+            const char *slash = strchr(line + 7, '/');
+            path = slash ? slash : "/";
+        }
+        if (add_request(path, host, extra, capacity) != 0)
+        {
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static void merge_stats(stats_t *total, const stats_t *s)
+{
+    if (s->completed > 0 && (total->completed == 0 || s->latency_min_us < total->latency_min_us))
+        total->latency_min_us = s->latency_min_us;
+    if (s->latency_max_us > total->latency_max_us)
+        total->latency_max_us = s->latency_max_us;
+    total->completed += s->completed;
+    total->status_2xx_3xx += s->status_2xx_3xx;
+    total->status_other += s->status_other;
+    total->connect_errors += s->connect_errors;
+    total->read_errors += s->read_errors;
+    total->timeouts += s->timeouts;
+    total->retries += s->retries;
+    total->bytes += s->bytes;
+    total->latency_sum_us += s->latency_sum_us;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+        total->hist[i] += s->hist[i];
+}
+
+static void report(const stats_t *s)
+{
+    double rps = s->completed / bench.duration;
+    double mbps = s->bytes / bench.duration / (1024.0 * 1024.0);
+    double mean = s->completed ? s->latency_sum_us / s->completed : 0;
+    uint64_t p50 = hist_percentile(s, 50), p90 = hist_percentile(s, 90);
+    uint64_t p99 = hist_percentile(s, 99), p999 = hist_percentile(s, 99.9);
+
+    if (bench.json)
+    {
+        printf("{\"url\":\"%s\",\"threads\":%d,\"connections\":%d,\"rate\":%.0f,\"keep_alive\":%s,"
+               "\"pipeline\":%d,\"duration_s\":%.1f,\"requests\":%lu,\"requests_per_sec\":%.1f,"
+               "\"mb_per_sec\":%.2f,\"non_2xx_3xx\":%lu,\"connect_errors\":%lu,\"read_errors\":%lu,"
+               "\"timeouts\":%lu,\"retries\":%lu,\"latency_us\":{\"min\":%llu,\"mean\":%.1f,\"p50\":%llu,"
+               "\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}\n",
+               bench.url, bench.threads, bench.connections, bench.rate, bench.keep_alive ? "true" : "false",
+               bench.pipeline, bench.duration, s->completed, rps, mbps, s->status_other, s->connect_errors,
+               s->read_errors, s->timeouts, s->retries, (unsigned long long)s->latency_min_us, mean,
+               (unsigned long long)p50, (unsigned long long)p90, (unsigned long long)p99,
+               (unsigned long long)p999, (unsigned long long)s->latency_max_us);
+        return;
+    }
+
+    printf("%.0fs @ %s (%zu path%s)\n", bench.duration, bench.url, bench.request_count,
+           bench.request_count == 1 ? "" : "s");
+    printf("  %d threads, %d connections, %s, %s, pipeline %d\n", bench.threads, bench.connections,
+           bench.keep_alive ? "keep-alive" : "close", bench.rate > 0 ? "open loop" : "closed loop",
+           bench.pipeline);
+    if (bench.rate > 0)
+        printf("  target rate %.0f req/s (latency from scheduled send time)\n", bench.rate);
+    printf("  requests   %lu (%.1f/s), %.2f MB/s\n", s->completed, rps, mbps);
+    printf("  latency us min %llu  mean %.1f  p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+           (unsigned long long)s->latency_min_us, mean, (unsigned long long)p50, (unsigned long long)p90,
+           (unsigned long long)p99, (unsigned long long)p999, (unsigned long long)s->latency_max_us);
+    printf("  errors     %lu non-2xx/3xx, %lu connect, %lu read, %lu timeout; %lu retried\n", s->status_other,
+           s->connect_errors, s->read_errors, s->timeouts, s->retries);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-t threads] [-c connections] [-d seconds] [-w seconds] [-r rate]\n"
+            "          [-k 0|1] [-p depth] [-f paths-file] [-H header]... [-T seconds] [-j]\n"
+            "          http://host:port/path\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *paths_file = NULL;
+    char extra[2048] = "";
+    size_t extra_len = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:c:d:w:r:k:p:f:H:T:j")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            bench.threads = atoi(optarg);
+            break;
+        case 'c':
+            bench.connections = atoi(optarg);
+            break;
+        case 'd':
+            bench.duration = atof(optarg);
+            break;
+        case 'w':
+            bench.warmup = atof(optarg);
+            break;
+        case 'r':
+            bench.rate = atof(optarg);
+            break;
+        case 'k':
+            bench.keep_alive = atoi(optarg) != 0;
+            break;
+        case 'p':
+            bench.pipeline = atoi(optarg);
+            break;
+        case 'f':
+            paths_file = optarg;
+            break;
+        case 'H':
+        {
+            int n = snprintf(extra + extra_len, sizeof(extra) - extra_len, "%s\r\n", optarg);
+            if (n < 0 || (size_t)n >= sizeof(extra) - extra_len)
+            {
+                fprintf(stderr, "Too many extra headers\n");
+                return 1;
+            }
+            extra_len += (size_t)n;
+            break;
+        }
+        case 'T':
+            bench.timeout = atof(optarg);
+            break;
+        case 'j':
+            bench.json = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1 || bench.threads < 1 || bench.connections < 1 || bench.duration <= 0 ||
+        bench.warmup < 0 || bench.rate < 0 || bench.pipeline < 1 || bench.pipeline > MAX_PIPELINE ||
+        bench.timeout <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!bench.keep_alive)
+        bench.pipeline = 1; /* One request per connection */
+    if (bench.threads > bench.connections)
+        bench.threads = bench.connections;
+    bench.url = argv[optind];
+
+    char host[256], port[16];
+    const char *path;
+    if (parse_url(bench.url, host, sizeof(host), port, sizeof(port), &path) != 0)
+    {
+        fprintf(stderr, "Expected a URL of the form http://host[:port]/path\n");
+        return 1;
+    }
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    int gai = getaddrinfo(host, port, &hints, &bench.addr);
+    if (gai != 0)
+    {
+        fprintf(stderr, "%s: %s\n", host, gai_strerror(gai));
+        return 1;
+    }
+
+    size_t capacity = 0;
+    if (paths_file ? load_request_file(paths_file, host, extra, &capacity) != 0
+                   : add_request(path, host, extra, &capacity) != 0)
+        return 1;
+    if (bench.request_count == 0)
+    {
+        fprintf(stderr, "%s: no request paths\n", paths_file);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    worker_t *workers = calloc((size_t)bench.threads, sizeof(*workers));
+    conn_t *conns = calloc((size_t)bench.connections, sizeof(*conns));
+    if (!workers || !conns)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    bench.start = now_seconds();
+    bench.measure_start = bench.start + bench.warmup;
+    bench.end = bench.measure_start + bench.duration;
+
+    int next_conn = 0;
+    for (int i = 0; i < bench.threads; i++)
+    {
+        worker_t *w = &workers[i];
+        w->conn_count = bench.connections / bench.threads + (i < bench.connections % bench.threads);
+        w->first_conn = next_conn;
+        w->conns = &conns[next_conn];
+        next_conn += w->conn_count;
+        pthread_create(&w->thread, NULL, worker_main, w);
+    }
+
+    stats_t *total = calloc(1, sizeof(*total));
+    for (int i = 0; i < bench.threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        merge_stats(total, &workers[i].stats);
+    }
+    report(total);
+
+    free(total);
+    free(conns);
+    free(workers);
+    for (size_t i = 0; i < bench.request_count; i++)
+        free(bench.requests[i].data);
+    free(bench.requests);
+    freeaddrinfo(bench.addr);
+    return 0;
+}
@@ -0,0 +1,304 @@
+/* microbench: hot-path micro-benchmarks, reported as JSON.
+
+   Usage: microbench [-t seconds] [-r runs] [filter]
+
+   Each benchmark is calibrated to run for about the given time (default
+   0.2s), repeated runs times (default 5), and reported as the median
+   ns/op together with heap allocations/op. Allocations are counted by
+   wrapping malloc, calloc, realloc and strdup at link time, so they
+   cover the server code called here but not allocations made inside
+   libc itself. Only benchmarks whose name contains filter are run.
+
+   The JSON goes to stdout, one object for the whole suite, so runs from
+   different releases can be compared:
+     microbench > before.json */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "compat.h"
+#include "client.h"
+#include "mime.h"
+#include "whitelist.h"
+
+/* ---- Allocation counting (-Wl,--wrap=...) ---- */
+
+static atomic_ulong allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+
+void *__wrap_malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_strdup(s);
+}
+
+/* Results feed this so the compiler cannot drop the work */
+static volatile uintptr_t sink;
+
+/* ---- Benchmarks ---- */
+
+static void bench_url_decode(uint64_t iterations)
+{
+    static const char encoded[] = "/assets/fonts/Open%20Sans%20Bold%2Bitalic.woff2";
+    char path[sizeof(encoded)];
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        memcpy(path, encoded, sizeof(encoded));
+        sink += (uintptr_t)url_decode(path) + (unsigned char)path[20];
+    }
+}
+
+static void bench_get_mime_type(uint64_t iterations)
+{
+    static const char *paths[] = {
+        "/index.html", "/assets/app.3f2a9c1b.js", "/css/site.CSS", "/img/hero.webp",
+        "/video/intro.mp4", "/fonts/a.woff2", "/README", "/data/export.unknownext",
+    };
+    for (uint64_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)get_mime_type(paths[i & 7]);
+}
+
+static const char range_request[] =
+    "GET /video/intro.mp4 HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: */*\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Range: bytes=0-1023,4096-8191,-500\r\n"
+    "If-Modified-Since: Wed, 21 Oct 2015 07:28:00 GMT\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static void bench_parse_range_header(uint64_t iterations)
+{
+    byte_range_t ranges[MAX_BYTE_RANGES];
+    for (uint64_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)parse_range_header(range_request, 10 * 1024 * 1024, ranges, MAX_BYTE_RANGES) +
+                (uintptr_t)ranges[0].end;
+}
+
+static void bench_get_if_modified_since(uint64_t iterations)
+{
+    time_t t = 0;
+    for (uint64_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)get_if_modified_since(range_request, &t) + (uintptr_t)t;
+}
+
+static const char *whitelist_ips[] = {
+    "10.0.0.1", "10.0.0.2", "192.168.0.0/16", "172.16.0.0/12",
+    "203.0.113.7", "198.51.100.0/24", "127.0.0.1", "100.64.0.0/10",
+};
+
+static void bench_is_ip_whitelisted(uint64_t iterations)
+{
+    /* Matches the last entry, so every entry is tried */
+    for (uint64_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)is_ip_whitelisted("100.96.12.34", whitelist_ips, 8);
+}
+
+static const char *whitelist_files[] = {
+    "/index.html", "/about.html", "/assets/*", "/css/*",
+    "/js/*", "/img/*", "/favicon.ico", "/downloads/*",
+};
+
+static void bench_is_file_whitelisted(uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)is_file_whitelisted("/downloads/release-1.2.3.tar.gz", whitelist_files, 8);
+}
+
+#define CACHE_BENCH_PATHS 64 /* Twice CACHE_MAX_ENTRIES: inserts keep evicting */
+static char cache_paths[CACHE_BENCH_PATHS][32];
+static char cache_data[4096];
+
+static void setup_cache(void)
+{
+    static bool ready;
+    if (ready)
+        return;
+    ready = true;
+
+    cache_init();
+    for (int i = 0; i < CACHE_BENCH_PATHS; i++)
+        snprintf(cache_paths[i], sizeof(cache_paths[i]), "/srv/www/file-%02d.css", i);
+    memset(cache_data, 'x', sizeof(cache_data));
+}
+
+static void bench_cache_get(uint64_t iterations)
+{
+    setup_cache();
+    for (int i = 0; i < 16; i++)
+    {
+        cache_entry_t *entry = cache_get(cache_paths[i], 1);
+        if (!entry)
+            entry = cache_put(cache_paths[i], cache_data, sizeof(cache_data), NULL, 0, "text/css", 1);
+        cache_release(entry);
+    }
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        cache_entry_t *entry = cache_get(cache_paths[i & 15], 1);
+        sink += (uintptr_t)entry;
+        cache_release(entry);
+    }
+}
+
+static void bench_cache_put(uint64_t iterations)
+{
+    setup_cache();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        cache_entry_t *entry = cache_put(cache_paths[i % CACHE_BENCH_PATHS], cache_data, sizeof(cache_data),
+                                         NULL, 0, "text/css", (time_t)(i + 1));
+        sink += (uintptr_t)entry;
+        cache_release(entry);
+    }
+}
+
+static void bench_format_200_headers(uint64_t iterations)
+{
+    response_headers_t h = {0};
+    h.mime = "text/css; charset=utf-8";
+    h.length = 48213;
+    h.keep_alive = true;
+    h.content_encoding = "gzip";
+    h.vary_encoding = true;
+    h.etag = "\"1a2b3c-bc55-17f0c2a9d4e1b000\"";
+    h.last_modified = 1445412480;
+    h.cache_control = "public, max-age=31536000, immutable";
+
+    char header[768];
+    for (uint64_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)format_200_headers(header, sizeof(header), &h) + (unsigned char)header[40];
+}
+
+typedef struct
+{
+    const char *name;
+    void (*run)(uint64_t iterations);
+} bench_t;
+
+static const bench_t benches[] = {
+    {"url_decode", bench_url_decode},
+    {"get_mime_type", bench_get_mime_type},
+    {"parse_range_header", bench_parse_range_header},
+    {"get_if_modified_since", bench_get_if_modified_since},
+    {"is_ip_whitelisted", bench_is_ip_whitelisted},
+    {"is_file_whitelisted", bench_is_file_whitelisted},
+    {"cache_get", bench_cache_get},
+    {"cache_put", bench_cache_put},
+    {"format_200_headers", bench_format_200_headers},
+};
+
+/* ---- Driver ---- */
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    double target = 0.2;
+    int runs = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:r:")) != -1)
+    {
+        if (opt == 't')
+            target = atof(optarg);
+        else if (opt == 'r')
+            runs = atoi(optarg);
+        else
+        {
+            fprintf(stderr, "Usage: %s [-t seconds] [-r runs] [filter]\n", argv[0]);
+            return 1;
+        }
+    }
+    const char *filter = optind < argc ? argv[optind] : NULL;
+    if (target <= 0 || runs < 1 || runs > 100)
+    {
+        fprintf(stderr, "Usage: %s [-t seconds] [-r runs] [filter]\n", argv[0]);
+        return 1;
+    }
+
+    printf("{\"suite\":\"microbench\",\"runs\":%d,\"benchmarks\":[", runs);
+    bool first = true;
+    for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++)
+    {
+        const bench_t *bench = &benches[b];
+        if (filter && !strstr(bench->name, filter))
+            continue;
+
+        /* Calibrate: grow the count until one run takes a tenth of the target */
+        uint64_t iterations = 1000;
+        for (;;)
+        {
+            double t0 = now_seconds();
+            bench->run(iterations);
+            double elapsed = now_seconds() - t0;
+            if (elapsed >= target / 10 || iterations >= (1ull << 40))
+            {
+                double scaled = elapsed > 0 ? iterations * (target / elapsed) : iterations * 10.0;
+                iterations = scaled > 1000 ? (uint64_t)scaled : 1000;
+                break;
+            }
+            iterations *= 10;
+        }
+
+        double ns_per_op[100];
+        unsigned long allocs = 0;
+        for (int r = 0; r < runs; r++)
+        {
+            unsigned long before = atomic_load(&allocations);
+            double t0 = now_seconds();
+            bench->run(iterations);
+            ns_per_op[r] = (now_seconds() - t0) * 1e9 / (double)iterations;
+            allocs += atomic_load(&allocations) - before;
+        }
+        qsort(ns_per_op, (size_t)runs, sizeof(double), compare_doubles);
+
+        printf("%s\n  {\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"min_ns_per_op\":%.2f,"
+               "\"allocs_per_op\":%.3f}",
+               first ? "" : ",", bench->name, (unsigned long long)iterations, ns_per_op[runs / 2],
+               ns_per_op[0], (double)allocs / ((double)iterations * runs));
+        fflush(stdout);
+        first = false;
+    }
+    printf("\n]}\n");
+    return 0;
+}
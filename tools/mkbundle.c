@@ -0,0 +1,284 @@
+/* mkbundle: pack a content directory into a bundle the server can mmap.
+
+   Usage: mkbundle <content-directory> <output-bundle>
+
+   The bundle is written next to the output path and renamed into place,
+   so a running server configured with "content-bundle" switches to it
+   atomically. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "bundle.h"
+#include "gzip.h"
+#include "mime.h"
+
+typedef struct
+{
+    char *request_path; /* "/css/site.css" */
+    char *file_path;
+    struct stat st;
+} source_t;
+
+typedef struct
+{
+    source_t *items;
+    int count;
+    int capacity;
+} source_list_t;
+
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+} strings_t;
+
+static void die(const char *msg, const char *detail)
+{
+    fprintf(stderr, "mkbundle: %s%s%s\n", msg, detail ? ": " : "", detail ? detail : "");
+    exit(1);
+}
+
+static void add_source(source_list_t *list, const char *request_path, const char *file_path, const struct stat *st)
+{
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->items = realloc(list->items, list->capacity * sizeof(source_t));
+        if (!list->items)
+            die("out of memory", NULL);
+    }
+    source_t *s = &list->items[list->count++];
+    s->request_path = strdup(request_path);
+    s->file_path = strdup(file_path);
+    s->st = *st;
+    if (!s->request_path || !s->file_path)
+        die("out of memory", NULL);
+}
+
+/* Collect regular files below dir; hidden files and directories are skipped */
+static void walk(source_list_t *list, const char *dir, const char *request_prefix)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+        die("cannot open directory", dir);
+
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        if (ent->d_name[0] == '.')
+            continue;
+
+        char file_path[4096], request_path[4096];
+        struct stat st;
+        if (snprintf(file_path, sizeof(file_path), "%s/%s", dir, ent->d_name) >= (int)sizeof(file_path) ||
+            snprintf(request_path, sizeof(request_path), "%s/%s", request_prefix, ent->d_name) >= (int)sizeof(request_path) ||
+            stat(file_path, &st) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+            walk(list, file_path, request_path);
+        else if (S_ISREG(st.st_mode))
+            add_source(list, request_path, file_path, &st);
+    }
+    closedir(d);
+}
+
+static int compare_sources(const void *a, const void *b)
+{
+    return strcmp(((const source_t *)a)->request_path, ((const source_t *)b)->request_path);
+}
+
+/* Binary search the sorted list (used to pair .gz sidecars with originals) */
+static source_t *find_source(source_list_t *list, const char *request_path)
+{
+    int lo = 0, hi = list->count;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(request_path, list->items[mid].request_path);
+        if (cmp == 0)
+            return &list->items[mid];
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return NULL;
+}
+
+static uint32_t add_string(strings_t *strings, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    if (strings->size + len > strings->capacity)
+    {
+        strings->capacity = (strings->size + len) * 2;
+        strings->data = realloc(strings->data, strings->capacity);
+        if (!strings->data)
+            die("out of memory", NULL);
+    }
+    uint32_t offset = (uint32_t)strings->size;
+    memcpy(strings->data + strings->size, s, len);
+    strings->size += len;
+    return offset;
+}
+
+static char *read_file(const char *path, size_t size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        die("cannot open", path);
+    char *data = malloc(size ? size : 1);
+    if (!data || fread(data, 1, size, f) != size)
+        die("cannot read", path);
+    fclose(f);
+    return data;
+}
+
+/* Pad the output with zeros to the next BUNDLE_ALIGN boundary */
+static uint64_t align_output(FILE *out)
+{
+    static const char zeros[BUNDLE_ALIGN];
+    long pos = ftell(out);
+    long pad = (BUNDLE_ALIGN - pos % BUNDLE_ALIGN) % BUNDLE_ALIGN;
+    if (pad > 0 && fwrite(zeros, 1, pad, out) != (size_t)pad)
+        die("write failed", NULL);
+    return (uint64_t)(pos + pad);
+}
+
+static uint64_t write_payload(FILE *out, const char *data, size_t size)
+{
+    uint64_t offset = align_output(out);
+    if (size > 0 && fwrite(data, 1, size, out) != size)
+        die("write failed", NULL);
+    return offset;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <content-directory> <output-bundle>\n", argv[0]);
+        return 2;
+    }
+
+    source_list_t sources = {0};
+    walk(&sources, argv[1], "");
+    qsort(sources.items, sources.count, sizeof(source_t), compare_sources);
+
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", argv[2]) >= (int)sizeof(tmp_path))
+        die("output path too long", NULL);
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out)
+        die("cannot create", tmp_path);
+
+    bundle_header_t header = {0};
+    if (fwrite(&header, sizeof(header), 1, out) != 1)
+        die("write failed", NULL);
+
+    bundle_entry_t *entries = calloc(sources.count ? sources.count : 1, sizeof(bundle_entry_t));
+    strings_t strings = {0};
+    uint32_t count = 0;
+    size_t raw_total = 0, gzip_total = 0;
+
+    for (int i = 0; i < sources.count; i++)
+    {
+        source_t *src = &sources.items[i];
+        size_t len = strlen(src->request_path);
+
+        /* A .gz whose original is bundled becomes that original's gzip variant */
+        if (len > 3 && strcmp(src->request_path + len - 3, ".gz") == 0)
+        {
+            char original[4096];
+            snprintf(original, sizeof(original), "%.*s", (int)(len - 3), src->request_path);
+            if (find_source(&sources, original))
+                continue;
+        }
+
+        size_t size = (size_t)src->st.st_size;
+        char *data = read_file(src->file_path, size);
+        const char *mime = get_mime_type(src->request_path);
+
+        /* Prefer a fresh precompressed sidecar, as the server does */
+        char sidecar_path[4096];
+        snprintf(sidecar_path, sizeof(sidecar_path), "%s.gz", src->request_path);
+        source_t *sidecar = find_source(&sources, sidecar_path);
+        char *gz = NULL;
+        size_t gz_size = 0;
+        if (sidecar && sidecar->st.st_mtime >= src->st.st_mtime)
+        {
+            gz_size = (size_t)sidecar->st.st_size;
+            gz = read_file(sidecar->file_path, gz_size);
+        }
+        else if (size > 0 && is_compressible_mime(mime))
+        {
+            gz = gzip_compress(data, size, &gz_size);
+            if (gz && gz_size >= size)
+            {
+                gzip_free(gz);
+                gz = NULL;
+                gz_size = 0;
+            }
+        }
+
+        /* Strong validator: content checksum plus length */
+        char etag[48];
+        snprintf(etag, sizeof(etag), "\"%08lx-%zx\"", crc32(0L, (const Bytef *)data, (uInt)size), size);
+
+        bundle_entry_t *e = &entries[count++];
+        e->path = add_string(&strings, src->request_path);
+        e->mime = add_string(&strings, mime);
+        e->etag = add_string(&strings, etag);
+        e->mtime = (int64_t)src->st.st_mtime;
+        e->data_offset = write_payload(out, data, size);
+        e->data_size = size;
+        if (gz)
+        {
+            e->gzip_offset = write_payload(out, gz, gz_size);
+            e->gzip_size = gz_size;
+        }
+
+        raw_total += size;
+        gzip_total += gz_size;
+        free(gz);
+        free(data);
+    }
+
+    header.index_offset = align_output(out);
+    if (count > 0 && fwrite(entries, sizeof(bundle_entry_t), count, out) != count)
+        die("write failed", NULL);
+    header.strings_offset = (uint64_t)ftell(out);
+    header.strings_size = strings.size;
+    if (strings.size > 0 && fwrite(strings.data, 1, strings.size, out) != strings.size)
+        die("write failed", NULL);
+
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.entry_count = count;
+    header.total_size = (uint64_t)ftell(out);
+    if (fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1 || fclose(out) != 0)
+        die("write failed", tmp_path);
+
+    if (rename(tmp_path, argv[2]) != 0)
+        die("cannot rename into place", argv[2]);
+
+    printf("mkbundle: %u files, %zu bytes raw, %zu bytes gzip, %" PRIu64 " bytes total -> %s\n",
+           count, raw_total, gzip_total, header.total_size, argv[2]);
+
+    for (int i = 0; i < sources.count; i++)
+    {
+        free(sources.items[i].request_path);
+        free(sources.items[i].file_path);
+    }
+    free(sources.items);
+    free(entries);
+    free(strings.data);
+    return 0;
+}
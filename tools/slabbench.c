@@ -0,0 +1,187 @@
+/* slabbench: connection-state churn through the slab allocator vs malloc.
+
+   Usage: slabbench [connections] [workers] [rate]
+
+   One thread plays the acceptor: it allocates a connection object, fills
+   it and hands it to a worker, which frees it - the same cross-thread
+   pattern the server has. Each allocator is run flat out (throughput,
+   ns per connection) and then paced at rate connections/sec (default
+   50000), timing every alloc and free to show what each costs at that
+   churn, when caches are cold between connections. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "compat.h"
+#include "slab.h"
+#include "threadpool.h"
+
+#define RING_SIZE 1024 /* Per-worker hand-off ring (power of two) */
+
+typedef struct
+{
+    work_item_t *slots[RING_SIZE];
+    _Atomic size_t head; /* Next slot the worker reads */
+    _Atomic size_t tail; /* Next slot the acceptor writes */
+    _Atomic bool done;
+} ring_t;
+
+typedef struct
+{
+    ring_t ring;
+    slab_t *slab; /* NULL: use malloc/free */
+    bool timed;
+    double free_ns;
+    unsigned long checksum;
+    pthread_t thread;
+} bench_worker_t;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void *worker_main(void *arg)
+{
+    bench_worker_t *w = arg;
+    ring_t *ring = &w->ring;
+
+    for (;;)
+    {
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        if (head == atomic_load_explicit(&ring->tail, memory_order_acquire))
+        {
+            if (atomic_load(&ring->done) && head == atomic_load(&ring->tail))
+                break;
+            sched_yield();
+            continue;
+        }
+
+        work_item_t *conn = ring->slots[head & (RING_SIZE - 1)];
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+        /* "Serve" it: touch the state, then close */
+        w->checksum += (unsigned long)conn->client_fd + (unsigned long)conn->request_count;
+        double t0 = w->timed ? now_seconds() : 0;
+        if (w->slab)
+            slab_free(w->slab, conn);
+        else
+            free(conn);
+        if (w->timed)
+            w->free_ns += (now_seconds() - t0) * 1e9;
+    }
+    return NULL;
+}
+
+typedef struct
+{
+    double elapsed;  /* Wall seconds */
+    double alloc_ns; /* Mean per alloc (paced runs only) */
+    double free_ns;  /* Mean per free (paced runs only) */
+} result_t;
+
+/* Run one allocator; rate 0 means as fast as possible */
+static result_t run(slab_t *slab, long connections, int workers, long rate)
+{
+    bench_worker_t *pool = calloc(workers, sizeof(bench_worker_t));
+    for (int i = 0; i < workers; i++)
+    {
+        pool[i].slab = slab;
+        pool[i].timed = rate > 0;
+        pthread_create(&pool[i].thread, NULL, worker_main, &pool[i]);
+    }
+
+    result_t result = {0};
+    double start = now_seconds();
+    for (long n = 0; n < connections; n++)
+    {
+        /* Pace in batches of 100 so the clock is not read per connection */
+        if (rate > 0 && n % 100 == 0)
+        {
+            double due = start + (double)n / rate;
+            while (now_seconds() < due)
+                sched_yield();
+        }
+
+        double t0 = rate > 0 ? now_seconds() : 0;
+        work_item_t *conn = slab ? slab_alloc(slab) : malloc(sizeof(work_item_t));
+        if (rate > 0)
+            result.alloc_ns += (now_seconds() - t0) * 1e9;
+        if (!conn)
+        {
+            fprintf(stderr, "allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        memset(conn, 0, sizeof(*conn));
+        conn->client_fd = (int)(n & 0xffff);
+        conn->request_count = 1;
+
+        ring_t *ring = &pool[n % workers].ring;
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        while (tail - atomic_load_explicit(&ring->head, memory_order_acquire) >= RING_SIZE)
+            sched_yield();
+        ring->slots[tail & (RING_SIZE - 1)] = conn;
+        atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    }
+
+    for (int i = 0; i < workers; i++)
+        atomic_store(&pool[i].ring.done, true);
+    for (int i = 0; i < workers; i++)
+        pthread_join(pool[i].thread, NULL);
+
+    result.elapsed = now_seconds() - start;
+    for (int i = 0; i < workers; i++)
+        result.free_ns += pool[i].free_ns;
+    result.alloc_ns /= connections;
+    result.free_ns /= connections;
+    free(pool);
+    return result;
+}
+
+static void report(const char *name, long connections, long rate, result_t r)
+{
+    if (rate == 0)
+        printf("%-6s flat out   : %9.0f conn/s  %6.1f ns/conn\n", name, connections / r.elapsed,
+               r.elapsed * 1e9 / connections);
+    else
+        printf("%-6s at %ld/s : %9.0f conn/s  alloc %6.1f ns  free %6.1f ns\n", name, rate,
+               connections / r.elapsed, r.alloc_ns, r.free_ns);
+}
+
+int main(int argc, char *argv[])
+{
+    long connections = argc > 1 ? atol(argv[1]) : 2000000;
+    int workers = argc > 2 ? atoi(argv[2]) : 4;
+    long rate = argc > 3 ? atol(argv[3]) : 50000;
+    if (connections <= 0 || workers <= 0 || rate < 0)
+    {
+        fprintf(stderr, "Usage: %s [connections] [workers] [rate]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%ld connections, %d workers, %zu-byte connection state\n", connections, workers,
+           sizeof(work_item_t));
+
+    slab_t *slab = slab_create(sizeof(work_item_t), 256);
+    report("slab", connections, 0, run(slab, connections, workers, 0));
+    report("malloc", connections, 0, run(NULL, connections, workers, 0));
+
+    if (rate > 0)
+    {
+        /* Two seconds of churn at the target rate */
+        long paced = rate * 2;
+        report("slab", paced, rate, run(slab, paced, workers, rate));
+        report("malloc", paced, rate, run(NULL, paced, workers, rate));
+    }
+
+    slab_destroy(slab);
+    return EXIT_SUCCESS;
+}